@@ -0,0 +1,69 @@
+#!/bin/bash
+set -euo pipefail
+
+# Socket load on an emulated machine: starts victus-hpwmi-emu and the
+# backend on a scratch directory, then runs victus-bench with 1, 10 and 100
+# connections. Run by `meson test --benchmark`.
+#
+#   bench-socket-load.sh <victus-hpwmi-emu> <victus-backend> <victus-bench> [duration_s] [mix]
+
+if [ "$#" -lt 3 ]; then
+    echo "Usage: $0 <victus-hpwmi-emu> <victus-backend> <victus-bench> [duration_s] [mix]" >&2
+    exit 2
+fi
+
+emulator="$1"
+backend="$2"
+bench="$3"
+duration="${4:-5}"
+mix="${5:-get}"
+log_prefix="[bench-socket-load]"
+
+root="$(mktemp -d /tmp/victus-load.XXXXXX)"
+emulator_pid=""
+backend_pid=""
+cleanup() {
+    [ -n "$backend_pid" ] && kill "$backend_pid" 2>/dev/null || true
+    [ -n "$emulator_pid" ] && kill "$emulator_pid" 2>/dev/null || true
+    wait 2>/dev/null || true
+    rm -rf "$root"
+}
+trap cleanup EXIT
+
+"$emulator" "$root" --cpu-load 40 >"$root/emulator.log" 2>&1 &
+emulator_pid=$!
+for _ in $(seq 50); do
+    [ -f "$root/emulator/stats" ] && break
+    sleep 0.1
+done
+
+VICTUS_FS_ROOT="$root" VICTUS_RUN_DIR="$root" "$backend" >"$root/backend.log" 2>&1 &
+backend_pid=$!
+
+socket="$root/victus_backend.sock"
+for _ in $(seq 100); do
+    [ -S "$socket" ] && break
+    if ! kill -0 "$backend_pid" 2>/dev/null; then
+        echo "$log_prefix backend exited:" >&2
+        cat "$root/backend.log" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+if [ ! -S "$socket" ]; then
+    echo "$log_prefix backend socket did not appear" >&2
+    exit 1
+fi
+
+# bind() creates the socket file just before listen()
+sleep 0.5
+
+for connections in 1 10 100; do
+    "$bench" --socket "$socket" --connections "$connections" --duration "$duration" --mix "$mix"
+done
+
+if ! kill -0 "$backend_pid" 2>/dev/null; then
+    echo "$log_prefix backend died under load:" >&2
+    tail -20 "$root/backend.log" >&2
+    exit 1
+fi
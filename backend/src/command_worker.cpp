@@ -0,0 +1,80 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "command_worker.hpp"
+#include "commands.hpp"
+
+static std::mutex worker_mutex;
+static std::condition_variable worker_cv;
+static std::deque<CommandJob> pending_jobs;
+static std::vector<CommandJob> completed_jobs;
+static int worker_event_fd = -1;
+
+static void command_worker()
+{
+    while (true) {
+        CommandJob job;
+        {
+            std::unique_lock<std::mutex> lock(worker_mutex);
+            worker_cv.wait(lock, [] { return !pending_jobs.empty(); });
+            job = std::move(pending_jobs.front());
+            pending_jobs.pop_front();
+        }
+
+        job.response = job.action ? job.action() : handle_command(job.command);
+
+        {
+            std::lock_guard<std::mutex> lock(worker_mutex);
+            completed_jobs.push_back(std::move(job));
+        }
+        uint64_t one = 1;
+        ssize_t ignored = write(worker_event_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void start_command_worker()
+{
+    static std::once_flag worker_once;
+    std::call_once(worker_once, []() {
+        worker_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (worker_event_fd < 0) {
+            std::cerr << "command worker: eventfd failed, running all commands inline: " << strerror(errno) << std::endl;
+            return;
+        }
+        std::thread(command_worker).detach();
+    });
+}
+
+int command_worker_event_fd()
+{
+    return worker_event_fd;
+}
+
+void submit_command(CommandJob job)
+{
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        pending_jobs.push_back(std::move(job));
+    }
+    worker_cv.notify_one();
+}
+
+std::vector<CommandJob> take_completed_commands()
+{
+    uint64_t count;
+    while (read(worker_event_fd, &count, sizeof(count)) > 0) {
+    }
+
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    std::vector<CommandJob> done;
+    done.swap(completed_jobs);
+    return done;
+}
@@ -0,0 +1,32 @@
+#ifndef COMMAND_WORKER_HPP
+#define COMMAND_WORKER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A command that is run off the event loop thread
+struct CommandJob {
+    int fd = -1;
+    uint64_t connection_id = 0; // tells a reused fd apart
+    bool tagged = false;
+    uint32_t request_id = 0;
+    std::string command;
+    // Run instead of command when set; for work the backend queues itself
+    // (fd -1), so it is ordered with client mutations
+    std::function<std::string()> action;
+    std::string response; // filled in by the worker
+};
+
+// Starts the worker thread. Slow commands are run one at a time in
+// submission order, so mutations from different clients never interleave.
+void start_command_worker();
+
+// Becomes readable (eventfd counter) whenever jobs have completed
+int command_worker_event_fd();
+
+void submit_command(CommandJob job);
+std::vector<CommandJob> take_completed_commands();
+
+#endif // COMMAND_WORKER_HPP
@@ -0,0 +1,219 @@
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <array>
+#include <cctype>
+
+#include "commands.hpp"
+#include "fan.hpp"
+#include "telemetry.hpp"
+#include "config.hpp"
+#include "metrics.hpp"
+
+static std::string trim(const std::string &input)
+{
+    size_t start = input.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = input.find_last_not_of(" \t\r\n");
+    return input.substr(start, end - start + 1);
+}
+
+static std::string normalize_mode(std::string mode)
+{
+    for (char &ch : mode) {
+        if (ch == '-' || ch == ' ') {
+            ch = '_';
+        } else {
+            ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+        }
+    }
+    return mode;
+}
+
+static const char *const kUnknownCommand = "ERROR: Unknown command";
+
+// Every command dispatch_command() answers, with its CMD_<COMMAND> histogram
+struct CommandLatency {
+    const char *command;
+    LatencyHistogram *latency;
+};
+
+static CommandLatency command_latency_entry(const char *command)
+{
+    return {command, &metrics_histogram(std::string("CMD_") + command)};
+}
+
+// Looked up once, so a dispatch records without building the name or
+// locking the registry. Unknown commands share one histogram so clients
+// cannot grow the registry.
+static LatencyHistogram &command_latency(const std::string &command)
+{
+    static const std::array<CommandLatency, 16> known = {
+        command_latency_entry("GET_FAN_SPEED"),
+        command_latency_entry("SET_FAN_SPEED"),
+        command_latency_entry("SET_FAN_MODE"),
+        command_latency_entry("GET_FAN_MODE"),
+        command_latency_entry("GET_CPU_TEMP"),
+        command_latency_entry("GET_ALL_TEMPS"),
+        command_latency_entry("GET_THERMAL"),
+        command_latency_entry("GET_STATUS"),
+        command_latency_entry("GET_FAN_QUEUE"),
+        command_latency_entry("GET_LOOP_TIMING"),
+        command_latency_entry("GET_CONTROLLER"),
+        command_latency_entry("GET_CONFIG"),
+        command_latency_entry("RELOAD_CONFIG"),
+        command_latency_entry("METRICS"),
+        command_latency_entry("SET_SAMPLE_INTERVAL"),
+        command_latency_entry("SET_FAN_PROFILE"),
+    };
+    static LatencyHistogram &unknown = metrics_histogram("CMD_UNKNOWN");
+    for (const auto &entry : known) {
+        if (command == entry.command) {
+            return *entry.latency;
+        }
+    }
+    return unknown;
+}
+
+static std::string dispatch_command(const std::string &command, std::stringstream &ss)
+{
+	std::string response;
+
+	if (command == "GET_FAN_SPEED")
+	{
+        std::string fan_num;
+        ss >> fan_num;
+		response = get_fan_speed(fan_num);
+	}
+	else if (command == "SET_FAN_SPEED")
+	{
+		std::string fan_num;
+        std::string speed;
+        ss >> fan_num >> speed;
+        if (!fan_num.empty() && !speed.empty()) {
+		    response = set_fan_speed(fan_num, speed, true, true); // true = allow triggering fan_mode_trigger
+        } else {
+            response = "ERROR: Invalid SET_FAN_SPEED command format";
+        }
+	}
+	else if (command == "SET_FAN_MODE")
+	{
+		std::string remainder;
+        std::getline(ss, remainder);
+        remainder = trim(remainder);
+        if (remainder.empty()) {
+            response = "ERROR: Invalid SET_FAN_MODE command format";
+        } else {
+            std::string mode = normalize_mode(remainder);
+		    response = set_fan_mode(mode);
+            if (response == "OK") {
+		        fan_mode_trigger(mode);
+		        request_telemetry_sample();
+            }
+        }
+	}
+	else if (command == "GET_FAN_MODE")
+	{
+		response = get_fan_mode();
+	}
+	else if (command == "GET_CPU_TEMP")
+	{
+		response = get_cpu_temp();
+	}
+	else if (command == "GET_ALL_TEMPS")
+	{
+		response = get_all_temps();
+	}
+	else if (command == "GET_THERMAL")
+	{
+		response = get_thermal();
+	}
+	else if (command == "GET_STATUS")
+	{
+		response = get_status();
+	}
+	else if (command == "GET_FAN_QUEUE")
+	{
+		response = get_fan_queue();
+	}
+	else if (command == "GET_LOOP_TIMING")
+	{
+		response = get_loop_timing();
+	}
+	else if (command == "GET_CONTROLLER")
+	{
+		response = get_controller_stats();
+	}
+	else if (command == "GET_CONFIG")
+	{
+		response = format_backend_config();
+	}
+	else if (command == "RELOAD_CONFIG")
+	{
+		response = reload_backend_config();
+		if (response == "OK") {
+			apply_backend_config();
+		}
+	}
+	else if (command == "METRICS")
+	{
+		std::string action;
+		ss >> action;
+		if (action.empty()) {
+			response = format_metrics();
+		} else if (action == "RESET") {
+			reset_metrics();
+			response = "OK";
+		} else {
+			response = "ERROR: Invalid METRICS command format";
+		}
+	}
+	else if (command == "SET_SAMPLE_INTERVAL")
+	{
+		long interval_ms = 0;
+		if (ss >> interval_ms) {
+			response = set_telemetry_interval(std::chrono::milliseconds(interval_ms));
+		} else {
+			response = "ERROR: Invalid SET_SAMPLE_INTERVAL command format";
+		}
+	}
+	else if (command == "SET_FAN_PROFILE")
+	{
+		std::string remainder;
+		std::getline(ss, remainder);
+		remainder = trim(remainder);
+		if (remainder.empty()) {
+			response = "ERROR: Invalid SET_FAN_PROFILE command format";
+		} else {
+			response = set_fan_profile(remainder);
+			if (response == "OK") {
+				request_telemetry_sample();
+			}
+		}
+	}
+	else
+		response = kUnknownCommand;
+
+	return response;
+}
+
+std::string handle_command(const std::string &command_str)
+{
+    std::stringstream ss(command_str);
+    std::string command;
+    ss >> command;
+
+    auto start = std::chrono::steady_clock::now();
+    std::string response = dispatch_command(command, ss);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    command_latency(command).record(elapsed);
+    return response;
+}
+
+bool is_slow_command(const std::string &command_str)
+{
+    return trim(command_str).rfind("SET_", 0) == 0;
+}
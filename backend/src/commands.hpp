@@ -0,0 +1,13 @@
+#ifndef COMMANDS_HPP
+#define COMMANDS_HPP
+
+#include <string>
+
+// Runs one text command from a client and returns the response payload
+std::string handle_command(const std::string &command_str);
+
+// True for commands that write to the hardware or wait on it (SET_*);
+// the server runs these on the command worker instead of the event loop
+bool is_slow_command(const std::string &command_str);
+
+#endif // COMMANDS_HPP
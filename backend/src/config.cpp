@@ -0,0 +1,137 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "config.hpp"
+
+static std::mutex config_mutex;
+static std::shared_ptr<const BackendConfig> current_config;
+static uint64_t config_reloads = 0;
+static uint64_t config_errors = 0;
+static std::string config_last_error;
+static int inotify_fd = -1;
+
+std::string reload_backend_config()
+{
+    auto config = default_backend_config();
+    if (access(CONFIG_PATH, F_OK) == 0) {
+        std::ifstream file(CONFIG_PATH);
+        auto result = file ? parse_backend_config(file, *config)
+                           : "ERROR: Unable to open " CONFIG_PATH ": " + std::string(strerror(errno));
+        if (result != "OK") {
+            std::cerr << "config: " << result.substr(7) << ", keeping the current configuration" << std::endl;
+            std::lock_guard<std::mutex> lock(config_mutex);
+            ++config_errors;
+            config_last_error = result.substr(7);
+            return result;
+        }
+        config->from_file = true;
+        std::cout << "config: loaded " CONFIG_PATH << std::endl;
+    } else {
+        std::cout << "config: " CONFIG_PATH " not found, using built-in defaults" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(config_mutex);
+    current_config = std::move(config);
+    ++config_reloads;
+    return "OK";
+}
+
+void start_config_watcher()
+{
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        std::cerr << "config: inotify unavailable, no hot reload: " << strerror(errno) << std::endl;
+    } else if (inotify_add_watch(inotify_fd, CONFIG_DIR, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        // Editors replace the file by renaming, so the directory is watched
+        std::cerr << "config: cannot watch " CONFIG_DIR ", no hot reload: " << strerror(errno) << std::endl;
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+
+    reload_backend_config();
+}
+
+int config_watch_fd()
+{
+    return inotify_fd;
+}
+
+bool handle_config_events()
+{
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed = false;
+    while (true) {
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        for (ssize_t offset = 0; offset < length;) {
+            auto *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+            if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && strcmp(event->name, CONFIG_FILE_NAME) == 0)) {
+                changed = true;
+            }
+            offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+        }
+    }
+    return changed && reload_backend_config() == "OK";
+}
+
+std::shared_ptr<const BackendConfig> backend_config()
+{
+    std::lock_guard<std::mutex> lock(config_mutex);
+    if (!current_config) {
+        current_config = default_backend_config();
+    }
+    return current_config;
+}
+
+std::string format_backend_config()
+{
+    auto config = backend_config();
+    uint64_t reloads, errors;
+    std::string last_error;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex);
+        reloads = config_reloads;
+        errors = config_errors;
+        last_error = config_last_error;
+    }
+
+    std::ostringstream out;
+    out << "FILE:" << (config->from_file ? CONFIG_PATH : "-")
+        << "|WATCHING:" << (inotify_fd >= 0 ? 1 : 0)
+        << "|TICK_MS:" << config->control_tick.count()
+        << "|REAPPLY_S:" << config->control_reapply.count()
+        << "|HYSTERESIS_C:" << config->control_hysteresis_c
+        << "|FAN_GAP_S:" << config->fan_apply_gap.count()
+        << "|MODE_ASSERT_S:" << config->mode_assert_interval.count()
+        << "|BETTER_AUTO_ASSERT_S:" << config->better_auto_mode_assert_interval.count()
+        << "|CONTROLLER:" << controller_name(config->controller)
+        << "|PID_TARGET_C:" << config->pid.target_c
+        << "|PID_KP:" << config->pid.kp
+        << "|PID_KI:" << config->pid.ki
+        << "|PID_KD:" << config->pid.kd
+        << "|PID_KFF:" << config->pid.kff
+        << "|DEADBAND_RPM:" << config->shaper.deadband_rpm
+        << "|SLEW_UP_RPM_S:" << config->shaper.slew_up_rpm_per_s
+        << "|SLEW_DOWN_RPM_S:" << config->shaper.slew_down_rpm_per_s
+        << "|DWELL_S:" << config->shaper.dwell.count()
+        << "|ZERO_DWELL_S:" << config->shaper.zero_dwell.count()
+        << "|CPU_FILTER:" << config->temp_filters[0].median_window << "," << config->temp_filters[0].max_rate_c_per_s
+        << "," << config->temp_filters[0].ema_alpha
+        << "|GPU_FILTER:" << config->temp_filters[1].median_window << "," << config->temp_filters[1].max_rate_c_per_s
+        << "," << config->temp_filters[1].ema_alpha
+        << "|METRICS_LISTEN:" << config->metrics_listen
+        << "|FAN1_CURVE:" << (config->custom_curve[0] ? "FILE" : "BUILTIN")
+        << "|FAN2_CURVE:" << (config->custom_curve[1] ? "FILE" : "BUILTIN")
+        << "|RELOADS:" << reloads
+        << "|ERRORS:" << errors
+        << "|LAST_ERROR:" << (last_error.empty() ? "-" : last_error);
+    return out.str();
+}
@@ -0,0 +1,86 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "fan_controller.hpp"
+#include "fan_curve.hpp"
+#include "fan_scheduler.hpp"
+#include "output_shaper.hpp"
+#include "sensor_filter.hpp"
+
+#define CONFIG_DIR "/etc/victus-control"
+#define CONFIG_FILE_NAME "backend.conf"
+#define CONFIG_PATH CONFIG_DIR "/" CONFIG_FILE_NAME
+
+// Compiled-in defaults, used for every key the config file leaves out
+static constexpr std::chrono::milliseconds kDefaultControlTick{2000};
+static constexpr std::chrono::seconds kDefaultControlReapply{90};
+static constexpr double kDefaultControlHysteresis = 1.0;
+static constexpr std::chrono::seconds kDefaultModeAssertInterval{90};
+static constexpr std::chrono::seconds kDefaultBetterAutoModeAssertInterval{80};
+
+// Curves and loop tunables. A published config is never modified; a reload
+// builds a new one and swaps the pointer.
+struct BackendConfig {
+    // BETTER_AUTO curves (also PROFILE until a profile is uploaded)
+    std::shared_ptr<const FanCurvePair> better_auto_curves;
+    std::array<bool, 2> custom_curve = {false, false};
+    std::chrono::milliseconds control_tick = kDefaultControlTick;
+    std::chrono::seconds control_reapply = kDefaultControlReapply;
+    double control_hysteresis_c = kDefaultControlHysteresis; // temperature change that triggers a write
+    std::chrono::seconds fan_apply_gap = kFanApplyGap;
+    std::chrono::seconds mode_assert_interval = kDefaultModeAssertInterval;
+    std::chrono::seconds better_auto_mode_assert_interval = kDefaultBetterAutoModeAssertInterval;
+    ControllerKind controller = ControllerKind::Curve; // drives BETTER_AUTO
+    PidTuning pid;
+    ShaperLimits shaper; // between the controller and the fan writes
+    std::array<SensorFilterConfig, 2> temp_filters; // CPU, GPU
+    std::string metrics_listen = "off"; // OpenMetrics listener, see parse_metrics_listen()
+    bool from_file = false; // false: all defaults, the file does not exist
+};
+
+// Where the OpenMetrics listener binds (metrics_listen in backend.conf)
+struct MetricsListenAddress {
+    bool unix_socket = false;
+    std::string path;      // unix socket path
+    bool ipv6 = false;     // ::1 instead of 127.0.0.1
+    uint16_t port = 0;
+};
+
+// "off", "unix:/abs/path", "<port>", "127.0.0.1:<port>", "localhost:<port>"
+// or "[::1]:<port>"; anything that is not loopback is rejected. False on
+// invalid values; "off" gives true with port 0 and no path.
+bool parse_metrics_listen(const std::string &value, MetricsListenAddress &address);
+
+// Compiled-in defaults with the built-in BETTER_AUTO curves
+std::shared_ptr<BackendConfig> default_backend_config();
+
+// "key = value" lines, '#' starts a comment, applied on top of config. Any
+// invalid line rejects the whole file: "OK" or the first error.
+std::string parse_backend_config(std::istream &in, BackendConfig &config);
+
+// Loads CONFIG_PATH and starts watching CONFIG_DIR with inotify
+void start_config_watcher();
+
+// inotify descriptor for the server's epoll loop, -1 when not watching
+int config_watch_fd();
+
+// Drains pending inotify events and reloads when the config file was
+// written, replaced or removed. True when a new config was published.
+bool handle_config_events();
+
+// Re-reads the file; "OK" or the first error (the current config stays)
+std::string reload_backend_config();
+
+std::shared_ptr<const BackendConfig> backend_config();
+
+// "SOURCE:..|TICK_MS:..|..." for GET_CONFIG
+std::string format_backend_config();
+
+#endif // CONFIG_HPP
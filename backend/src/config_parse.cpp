@@ -0,0 +1,225 @@
+#include <charconv>
+#include <cmath>
+#include <exception>
+#include <sys/un.h>
+
+#include "config.hpp"
+#include "fan_profile_config.hpp"
+
+// Parsing half of the config: no global state and no I/O of its own, so
+// tools like victus-replay can load a backend.conf without the backend
+
+static_assert(curve_temps_increasing(FAN1_BETTER_AUTO_PROFILE), "FAN1_BETTER_AUTO_PROFILE temperatures must be ascending");
+static_assert(curve_temps_increasing(FAN2_BETTER_AUTO_PROFILE), "FAN2_BETTER_AUTO_PROFILE temperatures must be ascending");
+static_assert(curve_temps_in_range(FAN1_BETTER_AUTO_PROFILE), "FAN1_BETTER_AUTO_PROFILE temperatures must be within 30-100");
+static_assert(curve_temps_in_range(FAN2_BETTER_AUTO_PROFILE), "FAN2_BETTER_AUTO_PROFILE temperatures must be within 30-100");
+static_assert(curve_rpms_in_range(FAN1_BETTER_AUTO_PROFILE, MIN_RPM_NONZERO, FAN1_MAX_RPM),
+              "FAN1_BETTER_AUTO_PROFILE RPMs must be 0 or MIN_RPM_NONZERO..FAN1_MAX_RPM");
+static_assert(curve_rpms_in_range(FAN2_BETTER_AUTO_PROFILE, MIN_RPM_NONZERO, FAN2_MAX_RPM),
+              "FAN2_BETTER_AUTO_PROFILE RPMs must be 0 or MIN_RPM_NONZERO..FAN2_MAX_RPM");
+
+// Built-in curves as lookup tables, generated by the compiler
+static constexpr FanCurveTable kFan1BetterAutoTable = compile_curve_table(FAN1_BETTER_AUTO_PROFILE);
+static constexpr FanCurveTable kFan2BetterAutoTable = compile_curve_table(FAN2_BETTER_AUTO_PROFILE);
+
+static bool parse_port(const std::string &text, uint16_t &port)
+{
+    unsigned value = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || result.ec != std::errc() || result.ptr != text.data() + text.size() || value == 0 ||
+        value > 65535) {
+        return false;
+    }
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+bool parse_metrics_listen(const std::string &value, MetricsListenAddress &address)
+{
+    address = MetricsListenAddress();
+    if (value == "off") {
+        return true;
+    }
+    if (value.rfind("unix:", 0) == 0) {
+        address.unix_socket = true;
+        address.path = value.substr(5);
+        return address.path.size() > 1 && address.path[0] == '/' &&
+               address.path.size() < sizeof(sockaddr_un::sun_path);
+    }
+
+    size_t colon = value.rfind(':');
+    if (colon == std::string::npos) {
+        return parse_port(value, address.port);
+    }
+    std::string host = value.substr(0, colon);
+    if (host == "[::1]") {
+        address.ipv6 = true;
+    } else if (host != "127.0.0.1" && host != "localhost") {
+        return false;
+    }
+    return parse_port(value.substr(colon + 1), address.port);
+}
+
+std::shared_ptr<BackendConfig> default_backend_config()
+{
+    static const auto builtin = std::make_shared<const FanCurvePair>(
+        FanCurvePair{FanCurve(kFan1BetterAutoTable), FanCurve(kFan2BetterAutoTable)});
+    auto config = std::make_shared<BackendConfig>();
+    config->better_auto_curves = builtin;
+    return config;
+}
+
+static std::string trim(const std::string &input)
+{
+    size_t start = input.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = input.find_last_not_of(" \t\r\n");
+    return input.substr(start, end - start + 1);
+}
+
+// The whole value must be a number within min..max
+static bool parse_number(const std::string &value, double min, double max, double &out)
+{
+    try {
+        size_t end = 0;
+        double parsed = std::stod(value, &end);
+        if (end != value.size() || !std::isfinite(parsed) || parsed < min || parsed > max) {
+            return false;
+        }
+        out = parsed;
+        return true;
+    } catch (const std::exception &) {
+        return false;
+    }
+}
+
+static bool parse_whole_number(const std::string &value, long min, long max, long &out)
+{
+    double parsed = 0;
+    if (!parse_number(value, min, max, parsed) || parsed != std::floor(parsed)) {
+        return false;
+    }
+    out = static_cast<long>(parsed);
+    return true;
+}
+
+static std::string apply_setting(BackendConfig &config, std::array<std::vector<FanCurvePoint>, 2> &curves,
+                                 const std::string &key, const std::string &value)
+{
+    long number = 0;
+    auto invalid = [&](const std::string &range) {
+        return "ERROR: Invalid " + key + " " + value + " (valid range: " + range + ")";
+    };
+
+    if (key == "control_tick_ms") {
+        if (!parse_whole_number(value, 250, 60000, number)) return invalid("250-60000");
+        config.control_tick = std::chrono::milliseconds(number);
+    } else if (key == "control_reapply_sec") {
+        if (!parse_whole_number(value, 10, 3600, number)) return invalid("10-3600");
+        config.control_reapply = std::chrono::seconds(number);
+    } else if (key == "control_hysteresis_c") {
+        if (!parse_number(value, 0.0, 10.0, config.control_hysteresis_c)) return invalid("0-10");
+    } else if (key == "fan_apply_gap_sec") {
+        if (!parse_whole_number(value, 0, 60, number)) return invalid("0-60");
+        config.fan_apply_gap = std::chrono::seconds(number);
+    } else if (key == "mode_assert_sec") {
+        if (!parse_whole_number(value, 10, 600, number)) return invalid("10-600");
+        config.mode_assert_interval = std::chrono::seconds(number);
+    } else if (key == "better_auto_mode_assert_sec") {
+        if (!parse_whole_number(value, 10, 600, number)) return invalid("10-600");
+        config.better_auto_mode_assert_interval = std::chrono::seconds(number);
+    } else if (key == "controller") {
+        auto kind = parse_controller_kind(value);
+        if (!kind) return "ERROR: Invalid controller " + value + " (curve or pid)";
+        config.controller = *kind;
+    } else if (key == "pid_target_c") {
+        if (!parse_number(value, 40.0, 95.0, config.pid.target_c)) return invalid("40-95");
+    } else if (key == "pid_kp") {
+        if (!parse_number(value, 0.0, 1.0, config.pid.kp)) return invalid("0-1");
+    } else if (key == "pid_ki") {
+        if (!parse_number(value, 0.0, 0.1, config.pid.ki)) return invalid("0-0.1");
+    } else if (key == "pid_kd") {
+        if (!parse_number(value, 0.0, 10.0, config.pid.kd)) return invalid("0-10");
+    } else if (key == "pid_kff") {
+        if (!parse_number(value, 0.0, 10.0, config.pid.kff)) return invalid("0-10");
+    } else if (key == "output_deadband_rpm") {
+        if (!parse_whole_number(value, 0, 2000, number)) return invalid("0-2000");
+        config.shaper.deadband_rpm = static_cast<int>(number);
+    } else if (key == "output_slew_up_rpm_s") {
+        if (!parse_number(value, 0.0, 10000.0, config.shaper.slew_up_rpm_per_s)) return invalid("0-10000");
+    } else if (key == "output_slew_down_rpm_s") {
+        if (!parse_number(value, 0.0, 10000.0, config.shaper.slew_down_rpm_per_s)) return invalid("0-10000");
+    } else if (key == "output_dwell_sec") {
+        if (!parse_whole_number(value, 0, 600, number)) return invalid("0-600");
+        config.shaper.dwell = std::chrono::seconds(number);
+    } else if (key == "output_zero_dwell_sec") {
+        if (!parse_whole_number(value, 0, 3600, number)) return invalid("0-3600");
+        config.shaper.zero_dwell = std::chrono::seconds(number);
+    } else if (key.rfind("cpu_filter_", 0) == 0 || key.rfind("gpu_filter_", 0) == 0) {
+        SensorFilterConfig &filter = config.temp_filters[key[0] == 'c' ? 0 : 1];
+        std::string stage = key.substr(11);
+        if (stage == "median") {
+            if (!parse_whole_number(value, 1, kMaxMedianWindow, number)) return invalid("1-" + std::to_string(kMaxMedianWindow));
+            filter.median_window = static_cast<size_t>(number);
+        } else if (stage == "max_rate_c_s") {
+            if (!parse_number(value, 0.0, 100.0, filter.max_rate_c_per_s)) return invalid("0-100");
+        } else if (stage == "ema_alpha") {
+            if (!parse_number(value, 0.01, 1.0, filter.ema_alpha)) return invalid("0.01-1");
+        } else {
+            return "ERROR: Unknown key " + key;
+        }
+    } else if (key == "metrics_listen") {
+        MetricsListenAddress address;
+        if (!parse_metrics_listen(value, address)) {
+            return "ERROR: Invalid metrics_listen " + value + " (off, unix:/path or a loopback [host:]port)";
+        }
+        config.metrics_listen = value;
+    } else if (key == "fan1_curve" || key == "fan2_curve") {
+        size_t index = (key == "fan1_curve") ? 0 : 1;
+        auto result = parse_curve_points(value, index == 0 ? FAN1_MAX_RPM : FAN2_MAX_RPM, curves[index]);
+        if (result != "OK") {
+            return "ERROR: " + key + ": " + result.substr(7);
+        }
+        config.custom_curve[index] = true;
+    } else {
+        return "ERROR: Unknown key " + key;
+    }
+    return "OK";
+}
+
+std::string parse_backend_config(std::istream &in, BackendConfig &config)
+{
+    std::array<std::vector<FanCurvePoint>, 2> curves;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        ++line_number;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+
+        size_t eq_pos = line.find('=');
+        if (eq_pos == std::string::npos) {
+            return "ERROR: Line " + std::to_string(line_number) + ": expected key = value";
+        }
+        auto result = apply_setting(config, curves, trim(line.substr(0, eq_pos)), trim(line.substr(eq_pos + 1)));
+        if (result != "OK") {
+            return "ERROR: Line " + std::to_string(line_number) + ": " + result.substr(7);
+        }
+    }
+    if (in.bad()) {
+        return "ERROR: Unable to read the configuration";
+    }
+
+    // A curve the file leaves out stays the built-in one
+    if (config.custom_curve[0] || config.custom_curve[1]) {
+        const FanCurvePair &builtin = *config.better_auto_curves;
+        config.better_auto_curves = std::make_shared<const FanCurvePair>(FanCurvePair{
+            config.custom_curve[0] ? FanCurve(std::move(curves[0])) : builtin[0],
+            config.custom_curve[1] ? FanCurve(std::move(curves[1])) : builtin[1]});
+    }
+    return "OK";
+}
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+
+#include "control_loop.hpp"
+#include "fan_profile_config.hpp"
+
+static constexpr int kControlMinRpm = MIN_RPM_NONZERO;
+
+static double get_hottest_temperature(const ThermalSnapshot &snapshot, double previous_temp)
+{
+    double hottest = 0.0;
+    bool have_temp = false;
+
+    if (snapshot.cpu_temp_c) {
+        hottest = std::max(hottest, *snapshot.cpu_temp_c);
+        have_temp = true;
+    }
+    if (snapshot.gpu_temp_c) {
+        hottest = std::max(hottest, *snapshot.gpu_temp_c);
+        have_temp = true;
+    }
+
+    return have_temp ? hottest : previous_temp;
+}
+
+ControlLoop::ControlLoop(ControlClock &loop_clock, SensorSource &sensor_source, FanSink &fan_sink)
+    : clock(loop_clock), sensors(sensor_source), fans(fan_sink)
+{
+}
+
+void ControlLoop::reset()
+{
+    curve_current_temp = 50.0;
+    curve_last_apply = std::chrono::steady_clock::time_point::min();
+    pid_controller.reset();
+    pid_last_apply = std::chrono::steady_clock::time_point::min();
+    for (auto &shaper : fan_shapers) {
+        shaper.reset();
+    }
+    for (auto &shaper : shadow_shapers) {
+        shaper.reset();
+    }
+}
+
+// Both controllers run on every tick, each with its own write decision; the
+// selected one drives the fans, the other one only advances in shadow
+ControlTick ControlLoop::tick(const BackendConfig &config, const FanCurvePair *curves, bool pid_allowed, bool forced)
+{
+    ControlTick tick;
+    tick.thermal = sensors.sample();
+    tick.now = clock.now();
+    tick.forced = forced;
+    double sensor_temp = get_hottest_temperature(tick.thermal, curve_current_temp);
+    tick.temp_c = sensor_temp;
+    auto now = tick.now;
+
+    // Curve: only apply if temperature changed significantly, the curves
+    // changed or on the reapply timeout
+    bool curve_write = forced ||
+                       (std::abs(sensor_temp - curve_current_temp) >= config.control_hysteresis_c) ||
+                       (curve_last_apply == std::chrono::steady_clock::time_point::min()) ||
+                       (now - curve_last_apply >= config.control_reapply);
+    if (curves) {
+        tick.curve_rpms = {(*curves)[0].rpm_at(sensor_temp), (*curves)[1].rpm_at(sensor_temp)};
+    } else {
+        curve_write = false;
+    }
+
+    // PID: apply when the quantized output moved
+    pid_controller.set_tuning(config.pid);
+    tick.pid_output = pid_controller.update(sensor_temp, now);
+    tick.pid_rpms = {pid_output_rpm(tick.pid_output, kControlMinRpm, fans.max_rpm(0)),
+                     pid_output_rpm(tick.pid_output, kControlMinRpm, fans.max_rpm(1))};
+    bool pid_write = forced || tick.pid_rpms != pid_last_rpms ||
+                     (pid_last_apply == std::chrono::steady_clock::time_point::min()) ||
+                     (now - pid_last_apply >= config.control_reapply);
+    tick.would_write = {curve_write, pid_write};
+
+    tick.active = (pid_allowed && config.controller == ControllerKind::Pid) ? ControllerKind::Pid
+                                                                              : ControllerKind::Curve;
+
+    // The shadow controller's state advances as if it had written
+    if (curve_write) {
+        curve_current_temp = sensor_temp;
+        curve_last_apply = now;
+    }
+    if (pid_write) {
+        pid_last_rpms = tick.pid_rpms;
+        pid_last_apply = now;
+    }
+
+    // The shapers decide what actually gets written: deadband, slew limits,
+    // dwell and no rewrites of the same target
+    bool use_pid = (tick.active == ControllerKind::Pid);
+    tick.targets = use_pid ? tick.pid_rpms : tick.curve_rpms;
+    for (size_t i = 0; i < fan_shapers.size(); ++i) {
+        fan_shapers[i].set_limits(config.shaper);
+        if (use_pid ? pid_write : curve_write) {
+            fan_shapers[i].set_target(tick.targets[i], forced);
+        }
+        tick.writes[i] = fan_shapers[i].step(now, kControlMinRpm);
+    }
+
+    // The shadow controller's targets go through shapers of their own, so
+    // its write count compares with the active one's. They start over when
+    // the controllers swap.
+    if (tick.active != shadow_shapers_behind) {
+        for (auto &shaper : shadow_shapers) {
+            shaper.reset();
+        }
+        shadow_shapers_behind = tick.active;
+    }
+    const auto &shadow_targets = use_pid ? tick.curve_rpms : tick.pid_rpms;
+    for (size_t i = 0; i < shadow_shapers.size(); ++i) {
+        shadow_shapers[i].set_limits(config.shaper);
+        if (use_pid ? curve_write : pid_write) {
+            shadow_shapers[i].set_target(shadow_targets[i], forced);
+        }
+        if (shadow_shapers[i].step(now, kControlMinRpm)) {
+            ++tick.shadow_writes;
+        }
+    }
+
+    for (size_t i = 0; i < tick.writes.size(); ++i) {
+        if (tick.writes[i]) {
+            tick.write_results[i] = fans.write(i, *tick.writes[i]);
+        }
+    }
+    return tick;
+}
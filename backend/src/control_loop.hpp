@@ -0,0 +1,96 @@
+#ifndef CONTROL_LOOP_HPP
+#define CONTROL_LOOP_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+
+#include "config.hpp"
+#include "fan_controller.hpp"
+#include "fan_curve.hpp"
+#include "output_shaper.hpp"
+#include "thermal.hpp"
+
+// Where the control loop takes its time and temperatures from and where its
+// fan targets go. The backend uses the steady clock, the telemetry snapshot
+// and the fan scheduler; victus-replay a virtual clock, a recorded trace and
+// a counting sink.
+class ControlClock
+{
+public:
+    virtual ~ControlClock() = default;
+    virtual std::chrono::steady_clock::time_point now() = 0;
+};
+
+class SensorSource
+{
+public:
+    virtual ~SensorSource() = default;
+    // Filtered and raw temperatures at the clock's current time
+    virtual ThermalSnapshot sample() = 0;
+};
+
+class FanSink
+{
+public:
+    virtual ~FanSink() = default;
+    virtual int max_rpm(size_t index) = 0;
+    // "OK" or an error; need not wait for the hardware
+    virtual std::string write(size_t index, int rpm) = 0;
+};
+
+// Everything one tick looked at and decided
+struct ControlTick {
+    std::chrono::steady_clock::time_point now;
+    ThermalSnapshot thermal;
+    double temp_c = 0.0; // hottest filtered temperature, what the controllers acted on
+    ControllerKind active = ControllerKind::Curve;
+    bool forced = false;
+    std::array<bool, 2> would_write = {false, false}; // curve, PID
+    std::array<int, 2> curve_rpms = {0, 0};
+    std::array<int, 2> pid_rpms = {0, 0};
+    double pid_output = 0.0;
+    std::array<int, 2> targets = {0, 0};       // of the active controller
+    std::array<std::optional<int>, 2> writes;  // what the shapers let through to the sink
+    int shadow_writes = 0; // fans the other controller's own shapers would have written
+    std::array<std::string, 2> write_results;  // of the sink, for writes only
+};
+
+// One BETTER_AUTO/PROFILE control loop: the curve and PID controllers side
+// by side and a shaper per fan, plus a set of shapers for the controller in
+// shadow. Not thread-safe; the owner runs every tick on one thread.
+class ControlLoop
+{
+public:
+    ControlLoop(ControlClock &loop_clock, SensorSource &sensor_source, FanSink &fan_sink);
+
+    // Starts over as if the loop was just started; the next tick writes
+    void reset();
+
+    // One step. curves nullptr disables the curve controller; pid_allowed
+    // lets config.controller select PID. forced (new curves or config)
+    // writes even when nothing changed.
+    ControlTick tick(const BackendConfig &config, const FanCurvePair *curves, bool pid_allowed, bool forced);
+
+    const PidController &pid() const { return pid_controller; }
+    const ShaperStats &shaper_stats(size_t index) const { return fan_shapers[index].stats(); }
+
+private:
+    ControlClock &clock;
+    SensorSource &sensors;
+    FanSink &fans;
+
+    double curve_current_temp = 50.0;
+    std::chrono::steady_clock::time_point curve_last_apply = std::chrono::steady_clock::time_point::min();
+    PidController pid_controller;
+    std::array<int, 2> pid_last_rpms = {0, 0};
+    std::chrono::steady_clock::time_point pid_last_apply = std::chrono::steady_clock::time_point::min();
+    std::array<OutputShaper, 2> fan_shapers;
+    // Never write; they count what the shadow controller would have written
+    std::array<OutputShaper, 2> shadow_shapers;
+    ControllerKind shadow_shapers_behind = ControllerKind::Curve; // active controller they ran behind
+};
+
+#endif // CONTROL_LOOP_HPP
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "control_trace.hpp"
+
+static constexpr size_t kTraceFileSize = sizeof(TraceHeader) + size_t(kTraceCapacity) * sizeof(TraceRecord);
+
+// Set once by open_control_trace() before any thread records
+static TraceHeader *trace_header = nullptr;
+static TraceRecord *trace_records = nullptr;
+
+static bool header_matches(const TraceHeader &header)
+{
+    return header.magic == kTraceMagic && header.version == kTraceVersion &&
+           header.record_size == sizeof(TraceRecord) && header.capacity == kTraceCapacity &&
+           header.header_size == sizeof(TraceHeader);
+}
+
+void open_control_trace(const char *path)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        std::cerr << "Control trace disabled, unable to open " << path << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    struct stat st;
+    bool reuse = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == kTraceFileSize;
+    if (!reuse && (ftruncate(fd, 0) < 0 || ftruncate(fd, kTraceFileSize) < 0)) {
+        std::cerr << "Control trace disabled, unable to size " << path << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return;
+    }
+
+    void *mapping = mmap(nullptr, kTraceFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Control trace disabled, mmap failed: " << strerror(errno) << std::endl;
+        return;
+    }
+
+    auto *header = static_cast<TraceHeader *>(mapping);
+    if (!reuse || !header_matches(*header)) {
+        std::memset(mapping, 0, kTraceFileSize);
+        header->magic = kTraceMagic;
+        header->version = kTraceVersion;
+        header->record_size = sizeof(TraceRecord);
+        header->capacity = kTraceCapacity;
+        header->header_size = sizeof(TraceHeader);
+    }
+    trace_header = header;
+    trace_records = reinterpret_cast<TraceRecord *>(static_cast<char *>(mapping) + sizeof(TraceHeader));
+    std::cout << "Control trace: " << path << " (" << std::atomic_ref<uint64_t>(header->next).load() << " records so far)"
+              << std::endl;
+}
+
+// A slot's sequence is zeroed before and set after the payload is copied,
+// so a reader can tell a complete record from one being overwritten
+void trace_record(TraceRecord record)
+{
+    if (!trace_header) {
+        return;
+    }
+
+    uint64_t sequence = std::atomic_ref<uint64_t>(trace_header->next).fetch_add(1, std::memory_order_relaxed);
+    TraceRecord &slot = trace_records[sequence % kTraceCapacity];
+    std::atomic_ref<uint64_t> slot_sequence(slot.sequence);
+    slot_sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(reinterpret_cast<char *>(&slot) + sizeof(slot.sequence),
+                reinterpret_cast<const char *>(&record) + sizeof(record.sequence),
+                sizeof(TraceRecord) - sizeof(record.sequence));
+    slot_sequence.store(sequence + 1, std::memory_order_release);
+}
+
+TraceRecord make_trace_record(TraceKind kind)
+{
+    TraceRecord record;
+    std::memset(&record, 0, sizeof(record));
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    record.time_us = static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+    record.kind = kind;
+    record.cpu_raw_c = record.cpu_c = record.gpu_raw_c = record.gpu_c = NAN;
+    record.control_c = record.pid_output = NAN;
+    for (size_t i = 0; i < 2; ++i) {
+        record.curve_rpm[i] = record.pid_rpm[i] = record.applied_rpm[i] = -1;
+    }
+    return record;
+}
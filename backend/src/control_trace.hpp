@@ -0,0 +1,73 @@
+#ifndef CONTROL_TRACE_HPP
+#define CONTROL_TRACE_HPP
+
+#include <cstdint>
+
+#define CONTROL_TRACE_FILE "control-trace.bin"
+#define CONTROL_TRACE_PATH "/run/victus-control/" CONTROL_TRACE_FILE
+
+// Ring file layout, shared with victus-trace. Native endianness; the file
+// never leaves the machine.
+static constexpr uint32_t kTraceMagic = 0x52544356; // "VCTR"
+static constexpr uint16_t kTraceVersion = 1;
+static constexpr uint32_t kTraceCapacity = 16384;   // ~9 h of ticks at 2 s
+
+struct TraceHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t capacity;
+    uint32_t header_size;
+    uint64_t next; // sequence of the next record; updated atomically
+    uint8_t reserved[40];
+};
+static_assert(sizeof(TraceHeader) == 64, "TraceHeader layout is part of the file format");
+
+enum TraceKind : uint8_t {
+    kTraceTick = 1,  // one control loop tick
+    kTraceWrite = 2, // one fan target write by the fan scheduler
+};
+
+enum TraceFlag : uint8_t {
+    kTraceForced = 1u << 0,     // tick: forced apply (mode or config change)
+    kTraceCurveWrite = 1u << 1, // tick: curve controller wanted a write
+    kTracePidWrite = 1u << 2,   // tick: PID controller wanted a write
+    kTraceFallback = 1u << 3,   // write: went through set-fan-speed.sh
+};
+
+// Temperatures are NaN and RPMs -1 when not available / not applicable
+struct TraceRecord {
+    uint64_t sequence; // 1-based; 0 marks a slot being written or never used
+    int64_t time_us;   // CLOCK_REALTIME
+    uint8_t kind;      // TraceKind
+    uint8_t controller; // ControllerKind driving the fans (ticks)
+    uint8_t flags;     // TraceFlag bits
+    uint8_t fan;       // 0/1 (writes)
+    float cpu_raw_c;
+    float cpu_c;       // after the sensor filter
+    float gpu_raw_c;
+    float gpu_c;
+    float control_c;   // temperature the controllers acted on
+    float pid_output;  // 0..1
+    int16_t curve_rpm[2];
+    int16_t pid_rpm[2];
+    int16_t applied_rpm[2]; // ticks: queued by the shaper; writes: written
+    uint32_t latency_us;    // writes: hardware write time; ticks: tick time
+    int8_t result;          // 0 OK, -1 failed
+    uint8_t reserved[3];
+};
+static_assert(sizeof(TraceRecord) == 64, "TraceRecord layout is part of the file format");
+
+// Maps the ring file, continuing the existing one when its header matches
+// so a restart after a crash keeps the records that led up to it. Tracing
+// is a no-op when this fails.
+void open_control_trace(const char *path = CONTROL_TRACE_PATH);
+
+// Copies one record into the ring; sequence is filled in. Safe to call from
+// any thread.
+void trace_record(TraceRecord record);
+
+// Record with every optional field set to "not available" and the time set
+TraceRecord make_trace_record(TraceKind kind);
+
+#endif // CONTROL_TRACE_HPP
@@ -4,7 +4,6 @@
 #include <sstream>
 #include <sys/un.h>
 #include <sys/wait.h>
-#include <thread>
 #include <chrono>
 #include <atomic>
 #include <mutex>
@@ -13,389 +12,92 @@
 #include <cctype>
 #include <array>
 #include <vector>
+#include <memory>
 #include <set>
 #include <cstring>
 #include <cerrno>
 #include <algorithm>
 #include <exception>
 #include <cmath>
-#include <sensors/sensors.h>
-#include <sensors/error.h>
 
 #include "fan.hpp"
 #include "util.hpp"
+#include "hwmon_io.hpp"
+#include "thermal.hpp"
+#include "telemetry.hpp"
 #include "fan_profile_config.hpp"
+#include "fan_scheduler.hpp"
+#include "fan_curve.hpp"
+#include "task_scheduler.hpp"
+#include "config.hpp"
+#include "fan_controller.hpp"
+#include "output_shaper.hpp"
+#include "metrics.hpp"
+#include "control_trace.hpp"
+#include "control_loop.hpp"
 
-static std::atomic<int> fan_thread_generation(0);
 static std::atomic<bool> is_reapplying(false);
 static std::mutex fan_state_mutex;
 static std::optional<std::string> last_fan1_speed;
 static std::optional<std::string> last_fan2_speed;
+static std::array<std::optional<int>, 2> applied_fan_target;
 static std::mutex mode_mutex;
 static std::string requested_mode = "AUTO";
-static std::atomic<bool> fan_mode_requires_root(false);
-
-static std::atomic<bool> better_auto_running(false);
-static std::thread better_auto_thread;
-static std::chrono::steady_clock::time_point better_auto_last_manual_assert;
-
-static std::once_flag cpu_sensor_once;
-static std::once_flag gpu_sensor_once;
-static std::once_flag gpu_usage_once;
-static std::optional<std::string> cpu_temp_path;
-static std::optional<std::string> gpu_temp_path;
-static std::optional<std::string> gpu_busy_path;
-static std::atomic<bool> cpu_sensor_warned(false);
-static std::atomic<bool> gpu_sensor_warned(false);
-static std::atomic<bool> gpu_usage_warned(false);
-
-// Cache for last read CPU temperature
-static std::mutex cpu_temp_cache_mutex;
-static std::optional<double> last_cpu_temp_c;
-
-struct CpuSampleTimes {
-    unsigned long long idle;
-    unsigned long long total;
-};
-static std::mutex cpu_usage_mutex;
-static std::optional<CpuSampleTimes> previous_cpu_times;
+// Held for a whole mode change (stop loop, write pwm1_enable, start loop,
+// requested_mode), so two callers cannot interleave and leave a control
+// task nobody holds a handle to
+static std::mutex mode_transition_mutex;
+
+// Curve control loop, runs for BETTER_AUTO (built-in curves) and PROFILE
+// (uploaded curves)
+static std::atomic<bool> curve_control_running(false);
+static std::mutex curve_mutex;
+static TaskHandle curve_control_task = 0;
+static std::string curve_control_log_prefix;
+static std::chrono::milliseconds curve_control_period{0};
+// nullptr: the BETTER_AUTO curves of the current config
+static std::shared_ptr<const FanCurvePair> active_curves;
+static std::shared_ptr<const FanCurvePair> profile_curves; // last SET_FAN_PROFILE
+static std::atomic<bool> curve_force_apply(false);
+// Only touched by the scheduler thread while running
+static std::chrono::steady_clock::time_point controller_last_tick;
+
+// Curve and PID side by side, see get_controller_stats()
+static std::mutex controller_stats_mutex;
+static std::array<ControllerStats, 2> controller_stats;
+static ControllerKind controller_active = ControllerKind::Curve;
+// Copy of the PID state for the command thread
+static std::array<int, 2> pid_rpms_now = {0, 0};
+static double pid_output_now = 0.0;
+static double pid_integral_now = 0.0;
+static double pid_slope_now = 0.0;
+static std::array<ShaperStats, 2> shaper_stats_now;
+
+static constexpr int kBetterAutoMinRpm = MIN_RPM_NONZERO;
+static constexpr std::array<int, 2> kBetterAutoMaxFallback = {FAN1_MAX_RPM, FAN2_MAX_RPM};
 
-static constexpr int kBetterAutoMinRpm = 1500;
-static constexpr std::array<int, 2> kBetterAutoMaxFallback = {5800, 6100};
 static constexpr int kBetterAutoSteps = 8;
-static constexpr std::chrono::seconds kBetterAutoTick{2};
-static constexpr std::chrono::seconds kBetterAutoReapply{90};
 static constexpr int kBetterAutoCooldownLevel = 5;
 static constexpr std::chrono::seconds kBetterAutoCooldown{90};
-static constexpr std::chrono::seconds kFanApplyGap{10};
-
-static std::array<std::once_flag, 2> fan_max_once;
-static std::array<int, 2> fan_max_cache = kBetterAutoMaxFallback;
-static std::mutex fan_apply_mutex;
-static std::array<std::chrono::steady_clock::time_point, 2> fan_last_apply = {
-    std::chrono::steady_clock::time_point::min(),
-    std::chrono::steady_clock::time_point::min()
-};
-
-struct ThermalSnapshot {
-    std::optional<double> cpu_temp_c;
-    std::optional<double> gpu_temp_c;
-    std::optional<double> cpu_usage_pct;
-    std::optional<double> gpu_usage_pct;
-};
-
-static std::string to_lower_copy(const std::string &input)
-{
-    std::string lowered = input;
-    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) {
-        return static_cast<char>(std::tolower(c));
-    });
-    return lowered;
-}
-
-static std::optional<std::string> find_thermal_zone_by_type(const std::vector<std::string> &hints)
-{
-    DIR *dir = opendir("/sys/class/thermal");
-    if (!dir) {
-        return std::nullopt;
-    }
-
-    std::optional<std::string> fallback;
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != nullptr)
-    {
-        if (std::strncmp(entry->d_name, "thermal_zone", 12) != 0) {
-            continue;
-        }
-
-        std::string base_path = std::string("/sys/class/thermal/") + entry->d_name;
-        std::ifstream type_file(base_path + "/type");
-        if (!type_file) {
-            continue;
-        }
-
-        std::string sensor_type;
-        std::getline(type_file, sensor_type);
-        std::string lowered = to_lower_copy(sensor_type);
 
-        if (!fallback) {
-            fallback = base_path + "/temp";
-        }
-
-        for (const auto &hint : hints) {
-            if (lowered.find(hint) != std::string::npos) {
-                closedir(dir);
-                return base_path + "/temp";
-            }
-        }
-    }
-
-    closedir(dir);
-    return fallback;
-}
-
-static std::optional<std::string> find_hwmon_temp_sensor(const std::vector<std::string> &name_hints,
-                                                         const std::vector<std::string> &label_hints)
-{
-    DIR *dir = opendir("/sys/class/hwmon");
-    if (!dir) {
-        return std::nullopt;
-    }
-
-    std::optional<std::string> fallback;
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != nullptr)
-    {
-        if (std::strncmp(entry->d_name, "hwmon", 5) != 0) {
-            continue;
-        }
+// Periodic mode re-assert, see fan_mode_trigger()
+static std::mutex mode_assert_mutex;
+static TaskHandle mode_assert_task = 0;
+static bool mode_assert_better_auto = false;
+static std::chrono::seconds mode_assert_period{0};
 
-        std::string base_path = std::string("/sys/class/hwmon/") + entry->d_name;
-        std::string name_path = base_path + "/name";
-        std::ifstream name_file(name_path);
-        std::string name_value;
-        if (name_file) {
-            std::getline(name_file, name_value);
-        }
-        std::string lowered_name = to_lower_copy(name_value);
+// How long stop_curve_control() took to stop a running control loop
+static std::mutex loop_latency_mutex;
+static std::chrono::microseconds curve_stop_last{0};
+static std::chrono::microseconds curve_stop_max{0};
 
-        bool name_matches = false;
-        for (const auto &hint : name_hints) {
-            if (!hint.empty() && lowered_name.find(hint) != std::string::npos) {
-                name_matches = true;
-                break;
-            }
-        }
-
-        DIR *inner = opendir(base_path.c_str());
-        if (!inner) {
-            continue;
-        }
-
-        std::vector<std::string> input_candidates;
-        struct dirent *inner_entry;
-        while ((inner_entry = readdir(inner)) != nullptr)
-        {
-            std::string file_name = inner_entry->d_name;
-            if (file_name.rfind("temp", 0) != 0) {
-                continue;
-            }
-            if (file_name.find("_input") == std::string::npos) {
-                continue;
-            }
-
-            std::string input_path = base_path + "/" + file_name;
-            input_candidates.push_back(input_path);
-
-            std::string prefix = file_name.substr(0, file_name.find("_input"));
-            std::string label_path = base_path + "/" + prefix + "_label";
-
-            std::ifstream label_file(label_path);
-            if (label_file) {
-                std::string label_value;
-                std::getline(label_file, label_value);
-                std::string lowered_label = to_lower_copy(label_value);
-
-                for (const auto &hint : label_hints) {
-                    if (!hint.empty() && lowered_label.find(hint) != std::string::npos) {
-                        closedir(inner);
-                        closedir(dir);
-                        return input_path;
-                    }
-                }
-            }
-        }
-        closedir(inner);
-
-        if (name_matches && !input_candidates.empty()) {
-            closedir(dir);
-            return input_candidates.front();
-        }
-
-        if (!fallback && !input_candidates.empty()) {
-            fallback = input_candidates.front();
-        }
-    }
-
-    closedir(dir);
-    return fallback;
-}
-
-static std::optional<std::string> locate_cpu_temp_sensor()
-{
-    std::call_once(cpu_sensor_once, []() {
-        const std::vector<std::string> hwmon_name_hints = {"k10temp", "coretemp", "zenpower", "cpu", "package", "soc"};
-        const std::vector<std::string> hwmon_label_hints = {"cpu", "package", "soc"};
-        cpu_temp_path = find_hwmon_temp_sensor(hwmon_name_hints, hwmon_label_hints);
-
-        if (!cpu_temp_path) {
-            const std::vector<std::string> zone_hints = {"x86_pkg", "tctl", "cpu", "soc"};
-            cpu_temp_path = find_thermal_zone_by_type(zone_hints);
-        }
-
-        if (!cpu_temp_path && !cpu_sensor_warned.exchange(true)) {
-            std::cerr << "better-auto: CPU thermal sensor not found; automatic mode will use default fan steps" << std::endl;
-        }
-    });
-    return cpu_temp_path;
-}
-
-static std::optional<std::string> locate_gpu_temp_sensor()
-{
-    std::call_once(gpu_sensor_once, []() {
-        const std::vector<std::string> hwmon_name_hints = {"amdgpu", "radeon", "nvidia", "gpu"};
-        const std::vector<std::string> hwmon_label_hints = {"edge", "gpu", "junction", "hotspot"};
-        gpu_temp_path = find_hwmon_temp_sensor(hwmon_name_hints, hwmon_label_hints);
-
-        if (!gpu_temp_path) {
-            const std::vector<std::string> zone_hints = {"gpu", "amdgpu", "nvidia"};
-            gpu_temp_path = find_thermal_zone_by_type(zone_hints);
-        }
-
-        if (!gpu_temp_path && !gpu_sensor_warned.exchange(true)) {
-            std::cerr << "better-auto: GPU thermal sensor not found; automatic mode will rely on CPU temperature" << std::endl;
-        }
-    });
-    return gpu_temp_path;
-}
-
-static std::optional<std::string> locate_gpu_busy_file()
-{
-    std::call_once(gpu_usage_once, []() {
-        DIR *dir = opendir("/sys/class/drm");
-        if (!dir) {
-            if (!gpu_usage_warned.exchange(true)) {
-                std::cerr << "better-auto: /sys/class/drm unavailable; GPU usage tracking disabled" << std::endl;
-            }
-            return;
-        }
-
-        struct dirent *entry;
-        while ((entry = readdir(dir)) != nullptr)
-        {
-            if (std::strncmp(entry->d_name, "card", 4) != 0) {
-                continue;
-            }
-
-            std::string candidate = std::string("/sys/class/drm/") + entry->d_name + "/device/gpu_busy_percent";
-            std::ifstream test(candidate);
-            if (test)
-            {
-                gpu_busy_path = candidate;
-                break;
-            }
-        }
-
-        closedir(dir);
-        if (!gpu_busy_path && !gpu_usage_warned.exchange(true)) {
-            std::cerr << "better-auto: GPU usage source not found; automatic mode will use temperature only" << std::endl;
-        }
-    });
-    return gpu_busy_path;
-}
-
-static std::optional<double> read_temperature_celsius(const std::optional<std::string> &path)
-{
-    if (!path) {
-        return std::nullopt;
-    }
-
-    std::ifstream file(*path);
-    if (!file) {
-        return std::nullopt;
-    }
-
-    long value = 0;
-    file >> value;
-    if (file.fail()) {
-        return std::nullopt;
-    }
-
-    return static_cast<double>(value) / 1000.0;
-}
-
-static std::optional<double> read_cpu_usage_pct()
-{
-    std::ifstream stat_file("/proc/stat");
-    if (!stat_file) {
-        return std::nullopt;
-    }
-
-    std::string line;
-    std::getline(stat_file, line);
-    std::istringstream iss(line);
-
-    std::string label;
-    unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
-    iss >> label >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
-    if (label != "cpu") {
-        return std::nullopt;
-    }
-
-    unsigned long long idle_all = idle + iowait;
-    unsigned long long non_idle = user + nice + system + irq + softirq + steal;
-    unsigned long long total = idle_all + non_idle;
-
-    std::lock_guard<std::mutex> lock(cpu_usage_mutex);
-    if (!previous_cpu_times) {
-        previous_cpu_times = CpuSampleTimes{idle_all, total};
-        return std::nullopt; // need a baseline before reporting usage
-    }
-
-    unsigned long long total_diff = total - previous_cpu_times->total;
-    unsigned long long idle_diff = idle_all - previous_cpu_times->idle;
-    previous_cpu_times = CpuSampleTimes{idle_all, total};
-
-    if (total_diff == 0) {
-        return std::nullopt;
-    }
-
-    double usage = static_cast<double>(total_diff - idle_diff) / static_cast<double>(total_diff);
-    return usage * 100.0;
-}
-
-static std::optional<double> read_gpu_usage_pct()
-{
-    auto path = locate_gpu_busy_file();
-    if (!path) {
-        return std::nullopt;
-    }
-
-    std::ifstream file(*path);
-    if (!file) {
-        return std::nullopt;
-    }
-
-    double value = 0.0;
-    file >> value;
-    if (file.fail()) {
-        return std::nullopt;
-    }
-
-    return value;
-}
-
-static ThermalSnapshot collect_snapshot()
-{
-    ThermalSnapshot snapshot;
-    snapshot.cpu_temp_c = read_temperature_celsius(locate_cpu_temp_sensor());
-    snapshot.gpu_temp_c = read_temperature_celsius(locate_gpu_temp_sensor());
-    snapshot.cpu_usage_pct = read_cpu_usage_pct();
-    snapshot.gpu_usage_pct = read_gpu_usage_pct();
-    
-    // Cache CPU temperature for get_cpu_temp()
-    if (snapshot.cpu_temp_c) {
-        std::lock_guard<std::mutex> lock(cpu_temp_cache_mutex);
-        last_cpu_temp_c = snapshot.cpu_temp_c;
-    }
-    
-    return snapshot;
-}
+static std::array<std::once_flag, 2> fan_max_once;
+static std::array<int, 2> fan_max_cache = kBetterAutoMaxFallback;
 
 static int fan_max_for_index(size_t index)
 {
     std::call_once(fan_max_once[index], [index]() {
-        std::string hwmon_path = find_hwmon_directory("/sys/devices/platform/hp-wmi/hwmon");
+        std::string hwmon_path = hwmon_directory();
         if (!hwmon_path.empty()) {
             std::string path = hwmon_path + "/fan" + std::to_string(index + 1) + "_max";
             std::ifstream file(path);
@@ -433,41 +135,10 @@ static int level_from_thresholds(double value, const std::array<double, 7> &thre
     return std::clamp(level, 1, kBetterAutoSteps);
 }
 
-static int rpm_for_temperature_for_fan(double temp_c, size_t fan_index)
-{
-    // Select the appropriate profile based on fan index
-    const auto &profile = (fan_index == 0) ? FAN1_BETTER_AUTO_PROFILE : FAN2_BETTER_AUTO_PROFILE;
-    
-    // Handle temperature below lowest profile point
-    if (temp_c <= profile[0].first) {
-        return profile[0].second;
-    }
-    
-    // Handle temperature above highest profile point
-    if (temp_c >= profile[profile.size() - 1].first) {
-        return profile[profile.size() - 1].second;
-    }
-    
-    // Find the two profile points that bracket the current temperature
-    for (size_t i = 0; i < profile.size() - 1; ++i) {
-        if (temp_c >= profile[i].first && temp_c <= profile[i + 1].first) {
-            // Linear interpolation between the two points
-            double temp_diff = profile[i + 1].first - profile[i].first;
-            double rpm_diff = profile[i + 1].second - profile[i].second;
-            double ratio = (temp_c - profile[i].first) / temp_diff;
-            int interpolated_rpm = profile[i].second + static_cast<int>(ratio * rpm_diff);
-            return interpolated_rpm;
-        }
-    }
-    
-    // Fallback (should not reach here)
-    return profile[profile.size() - 1].second;
-}
-
 static int rpm_for_level_for_fan(int level, size_t fan_index)
 {
     // This function is kept for compatibility but now unused
-    // RPM is determined directly from temperature via rpm_for_temperature_for_fan
+    // RPM is determined directly from temperature via the fan curves
     level = std::clamp(level, 1, kBetterAutoSteps);
     int max_rpm = fan_max_for_index(fan_index);
     if (kBetterAutoSteps <= 1) {
@@ -486,28 +157,6 @@ static std::array<int, 2> rpm_for_level(int level)
     return {rpm_for_level_for_fan(level, 0), rpm_for_level_for_fan(level, 1)};
 }
 
-static std::array<int, 2> rpm_for_temperature(double temp_c)
-{
-    return {rpm_for_temperature_for_fan(temp_c, 0), rpm_for_temperature_for_fan(temp_c, 1)};
-}
-
-static double get_hottest_temperature(const ThermalSnapshot &snapshot, double previous_temp)
-{
-    double hottest = 0.0;
-    bool have_temp = false;
-    
-    if (snapshot.cpu_temp_c) {
-        hottest = std::max(hottest, *snapshot.cpu_temp_c);
-        have_temp = true;
-    }
-    if (snapshot.gpu_temp_c) {
-        hottest = std::max(hottest, *snapshot.gpu_temp_c);
-        have_temp = true;
-    }
-    
-    return have_temp ? hottest : previous_temp;
-}
-
 static int level_from_snapshot(const ThermalSnapshot &snapshot, int previous_level)
 {
     const std::array<double, 7> temp_thresholds = {45.0, 55.0, 65.0, 70.0, 75.0, 80.0, 84.0};
@@ -550,9 +199,7 @@ static int level_from_snapshot(const ThermalSnapshot &snapshot, int previous_lev
     return target_level;
 }
 
-static void stop_better_auto();
-static std::string start_better_auto();
-static void better_auto_worker();
+static void stop_curve_control();
 
 static bool encode_pwm_mode(const std::string &mode, std::string &encoded)
 {
@@ -568,7 +215,7 @@ static bool encode_pwm_mode(const std::string &mode, std::string &encoded)
 		encoded = "0";
 		return true;
 	}
-	if (mode == "BETTER_AUTO") {
+	if (mode == "BETTER_AUTO" || mode == "PROFILE") {
 		encoded = "1";
 		return true;
 	}
@@ -578,13 +225,20 @@ static bool encode_pwm_mode(const std::string &mode, std::string &encoded)
 
 static std::string apply_fan_mode_with_sudo(const std::string &mode)
 {
+	static LatencyHistogram &script_latency = metrics_histogram("SCRIPT_SET_FAN_MODE");
+	static MetricCounter &script_errors = metrics_counter("SCRIPT_ERRORS");
 	std::string command = "sudo /usr/bin/set-fan-mode.sh " + mode;
-	int result = system(command.c_str());
+	int result;
+	{
+		ScopedLatency timer(script_latency);
+		result = system(command.c_str());
+	}
 
 	if (result == 0) {
 		return "OK";
 	}
 
+	script_errors.add();
 	if (result == -1) {
 		std::cerr << "set-fan-mode.sh invocation failed: " << strerror(errno) << std::endl;
 		return "ERROR: Unable to set fan mode";
@@ -601,167 +255,253 @@ static std::string apply_fan_mode_with_sudo(const std::string &mode)
 
 static std::string write_hw_fan_mode(const std::string &mode)
 {
-	std::string hwmon_path = find_hwmon_directory("/sys/devices/platform/hp-wmi/hwmon");
+	std::string encoded_mode;
+	if (!encode_pwm_mode(mode, encoded_mode)) {
+		return "ERROR: Invalid fan mode: " + mode;
+	}
 
-	if (!hwmon_path.empty())
-	{
-		bool use_sudo = fan_mode_requires_root.load(std::memory_order_acquire);
-		std::string encoded_mode;
-		if (!encode_pwm_mode(mode, encoded_mode)) {
-			return "ERROR: Invalid fan mode: " + mode;
-		}
+	// Cached descriptor (direct or from victus-fan-broker), script as last resort
+	auto result = hwmon_write_pwm_enable(encoded_mode);
+	if (result == "OK") {
+		return result;
+	}
+	if (result == "ERROR: Hwmon directory not found") {
+		return result;
+	}
 
-		if (!use_sudo) {
-			std::string control_path = hwmon_path + "/pwm1_enable";
-			errno = 0;
-			std::ofstream fan_ctrl(control_path);
-
-			if (fan_ctrl) {
-				fan_ctrl << encoded_mode;
-				fan_ctrl.flush();
-				if (!fan_ctrl.fail()) {
-					return "OK";
-				}
-
-				int write_errno = errno;
-				std::cerr << "Failed to write fan mode via sysfs: " << strerror(write_errno) << std::endl;
-				if (write_errno != EACCES && write_errno != EPERM) {
-					return "ERROR: Failed to write fan mode";
-				}
-				fan_mode_requires_root.store(true, std::memory_order_release);
-				use_sudo = true;
-			} else {
-				int open_errno = errno;
-				std::cerr << "Failed to open fan mode control (" << control_path << "): " << strerror(open_errno) << std::endl;
-				if (open_errno != EACCES && open_errno != EPERM) {
-					return "ERROR: Unable to set fan mode";
-				}
-				fan_mode_requires_root.store(true, std::memory_order_release);
-				use_sudo = true;
-			}
-		}
+	std::cerr << "Cached fan mode write failed (" << result << "), falling back to set-fan-mode.sh" << std::endl;
+	return apply_fan_mode_with_sudo(mode);
+}
 
-		if (use_sudo) {
-			return apply_fan_mode_with_sudo(mode);
-		}
+static std::string apply_fan_speed_with_sudo(const std::string &fan_num, const std::string &speed)
+{
+	// The script must be in a location like /usr/bin
+	static LatencyHistogram &script_latency = metrics_histogram("SCRIPT_SET_FAN_SPEED");
+	static MetricCounter &script_errors = metrics_counter("SCRIPT_ERRORS");
+	std::string command = "sudo /usr/bin/set-fan-speed.sh " + fan_num + " " + speed;
+	int result;
+	{
+		ScopedLatency timer(script_latency);
+		result = system(command.c_str());
+	}
 
-		return "ERROR: Unable to set fan mode";
+	if (result == 0) {
+		return "OK";
 	}
+	script_errors.add();
 
-	return "ERROR: Hwmon directory not found";
+	std::cerr << "Failed to execute set-fan-speed.sh for fan " << fan_num << ". Exit code: " << WEXITSTATUS(result) << std::endl;
+	return "ERROR: Failed to set fan speed";
 }
 
-static void better_auto_worker()
+// Runs on the fan scheduler thread
+static std::string write_fan_target(size_t index, int rpm)
 {
-    std::cout << "better-auto: control loop started" << std::endl;
-    double current_temp = 50.0;
-    auto last_apply = std::chrono::steady_clock::time_point::min();
-    better_auto_last_manual_assert = std::chrono::steady_clock::time_point::min();
-
-    while (better_auto_running.load(std::memory_order_acquire)) {
-        ThermalSnapshot snapshot = collect_snapshot();
-        double sensor_temp = get_hottest_temperature(snapshot, current_temp);
-        auto now = std::chrono::steady_clock::now();
-
-        bool need_mode_refresh = (better_auto_last_manual_assert == std::chrono::steady_clock::time_point::min()) ||
-                                 (now - better_auto_last_manual_assert >= std::chrono::seconds(80));
-        if (need_mode_refresh) {
-            auto refresh_result = write_hw_fan_mode("MANUAL");
-            if (refresh_result != "OK") {
-                std::cerr << "better-auto: failed to keep manual mode active: " << refresh_result << std::endl;
-            }
-            better_auto_last_manual_assert = now;
-        }
+	TraceRecord trace = make_trace_record(kTraceWrite);
+	auto start = std::chrono::steady_clock::now();
+	auto result = hwmon_write_fan_target(index, rpm);
+	if (result != "OK" && result != "ERROR: Hwmon directory not found") {
+		std::cerr << "Cached fan target write failed (" << result << "), falling back to set-fan-speed.sh" << std::endl;
+		result = apply_fan_speed_with_sudo(std::to_string(index + 1), std::to_string(rpm));
+		trace.flags |= kTraceFallback;
+	}
+	trace.fan = static_cast<uint8_t>(index);
+	trace.applied_rpm[index] = static_cast<int16_t>(rpm);
+	trace.latency_us = static_cast<uint32_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	trace.result = (result == "OK") ? 0 : -1;
+	trace_record(trace);
+	if (result == "OK") {
+		std::lock_guard<std::mutex> lock(fan_state_mutex);
+		applied_fan_target[index] = rpm;
+	}
+	return result;
+}
 
-        // Only apply if temperature changed significantly or reapply timeout
-        bool need_apply = (std::abs(sensor_temp - current_temp) >= 1.0) ||
-                          (last_apply == std::chrono::steady_clock::time_point::min()) ||
-                          (now - last_apply >= kBetterAutoReapply);
+// The backend's side of the control loop: steady clock, the telemetry
+// snapshot, and targets queued on the fan scheduler
+class SteadyControlClock : public ControlClock
+{
+public:
+    std::chrono::steady_clock::time_point now() override { return std::chrono::steady_clock::now(); }
+};
 
-        if (need_apply) {
-            auto rpms = rpm_for_temperature(sensor_temp);
-            std::string rpm_str_fan1 = std::to_string(rpms[0]);
-            std::string rpm_str_fan2 = std::to_string(rpms[1]);
+class TelemetrySensorSource : public SensorSource
+{
+public:
+    ThermalSnapshot sample() override { return latest_telemetry()->thermal; }
+};
 
-            std::cout << "better-auto: setting RPM at " << sensor_temp << "°C -> Fan1: " << rpms[0] << " RPM, Fan2: " << rpms[1] << " RPM" << std::endl;
+class SchedulerFanSink : public FanSink
+{
+public:
+    int max_rpm(size_t index) override { return fan_max_for_index(index); }
+    std::string write(size_t index, int rpm) override
+    {
+        return set_fan_speed(std::to_string(index + 1), std::to_string(rpm), false, true);
+    }
+};
 
-            auto result1 = set_fan_speed("1", rpm_str_fan1, false, true);
-            if (result1 != "OK") {
-                std::cerr << "better-auto: failed to set fan 1 speed: " << result1 << std::endl;
-            }
+static SteadyControlClock control_clock;
+static TelemetrySensorSource control_sensors;
+static SchedulerFanSink control_fans;
+// Only touched by the scheduler thread while running
+static ControlLoop control_loop(control_clock, control_sensors, control_fans);
 
-            const int gap_seconds = static_cast<int>(kFanApplyGap.count());
-            for (int i = 0; i < gap_seconds; ++i) {
-                if (!better_auto_running.load(std::memory_order_acquire)) {
-                    break;
-                }
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-            }
+static void record_controller_tick(const ControlTick &tick, double target_c)
+{
+    std::chrono::milliseconds elapsed{0};
+    if (controller_last_tick != std::chrono::steady_clock::time_point::min()) {
+        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(tick.now - controller_last_tick);
+    }
+    controller_last_tick = tick.now;
+
+    const PidController &pid = control_loop.pid();
+    std::lock_guard<std::mutex> lock(controller_stats_mutex);
+    controller_active = tick.active;
+    pid_rpms_now = tick.pid_rpms;
+    pid_output_now = pid.output();
+    pid_integral_now = pid.integral();
+    pid_slope_now = pid.slope();
+    // Fans written after the shapers; the shadow controller's through its own
+    uint64_t active_writes = 0;
+    for (const auto &rpm : tick.writes) {
+        active_writes += rpm ? 1 : 0;
+    }
+    for (size_t i = 0; i < controller_stats.size(); ++i) {
+        ControllerStats &stats = controller_stats[i];
+        if (static_cast<size_t>(tick.active) == i) {
+            stats.active_time += elapsed;
+            stats.writes += active_writes;
+            stats.peak_overshoot_c = std::max(stats.peak_overshoot_c, tick.temp_c - target_c);
+        } else {
+            stats.shadow_time += elapsed;
+            stats.shadow_writes += static_cast<uint64_t>(tick.shadow_writes);
+        }
+    }
+}
 
-            if (!better_auto_running.load(std::memory_order_acquire)) {
-                break;
-            }
+// One control step, every control_tick of the config on the task scheduler.
+// The config is read once per tick, so a reload takes effect on the next one.
+// ControlLoop runs both controllers, the selected one (PID only in
+// BETTER_AUTO) drives the fans; this records stats, the trace and the log.
+static void curve_control_tick(const std::string &log_prefix, bool pid_allowed)
+{
+    static LatencyHistogram &tick_latency = metrics_histogram("CONTROL_TICK");
+    ScopedLatency timer(tick_latency);
+    auto tick_start = std::chrono::steady_clock::now();
 
-            auto result2 = set_fan_speed("2", rpm_str_fan2, false, true);
-            if (result2 != "OK") {
-                std::cerr << "better-auto: failed to set fan 2 speed: " << result2 << std::endl;
-            }
+    auto config = backend_config();
+    std::shared_ptr<const FanCurvePair> curves;
+    {
+        std::lock_guard<std::mutex> lock(curve_mutex);
+        curves = active_curves ? active_curves : config->better_auto_curves;
+    }
 
-            current_temp = sensor_temp;
-            last_apply = now;
+    bool forced = curve_force_apply.exchange(false, std::memory_order_acq_rel);
+    ControlTick tick = control_loop.tick(*config, curves.get(), pid_allowed, forced);
+    record_controller_tick(tick, config->pid.target_c);
+    {
+        static MetricCounter &shaper_writes = metrics_counter("SHAPER_WRITES");
+        static MetricCounter &shaper_avoided = metrics_counter("SHAPER_WRITES_AVOIDED");
+        std::lock_guard<std::mutex> lock(controller_stats_mutex);
+        for (size_t i = 0; i < shaper_stats_now.size(); ++i) {
+            const ShaperStats &now_stats = control_loop.shaper_stats(i);
+            shaper_writes.add(now_stats.writes - shaper_stats_now[i].writes);
+            shaper_avoided.add(now_stats.avoided() - shaper_stats_now[i].avoided());
+            shaper_stats_now[i] = now_stats;
         }
+    }
 
-        const int tick_seconds = static_cast<int>(kBetterAutoTick.count());
-        for (int i = 0; i < tick_seconds; ++i) {
-            if (!better_auto_running.load(std::memory_order_acquire)) {
-                break;
-            }
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+    const ThermalSnapshot &snapshot = tick.thermal;
+    TraceRecord trace = make_trace_record(kTraceTick);
+    trace.controller = static_cast<uint8_t>(tick.active);
+    trace.flags = static_cast<uint8_t>((forced ? kTraceForced : 0) | (tick.would_write[0] ? kTraceCurveWrite : 0) |
+                                       (tick.would_write[1] ? kTracePidWrite : 0));
+    trace.cpu_raw_c = static_cast<float>(snapshot.cpu_temp_raw_c.value_or(NAN));
+    trace.cpu_c = static_cast<float>(snapshot.cpu_temp_c.value_or(NAN));
+    trace.gpu_raw_c = static_cast<float>(snapshot.gpu_temp_raw_c.value_or(NAN));
+    trace.gpu_c = static_cast<float>(snapshot.gpu_temp_c.value_or(NAN));
+    trace.control_c = static_cast<float>(tick.temp_c);
+    trace.pid_output = static_cast<float>(tick.pid_output);
+    for (size_t i = 0; i < 2; ++i) {
+        trace.curve_rpm[i] = static_cast<int16_t>(tick.curve_rpms[i]);
+        trace.pid_rpm[i] = static_cast<int16_t>(tick.pid_rpms[i]);
+    }
+
+    bool use_pid = (tick.active == ControllerKind::Pid);
+    for (size_t i = 0; i < tick.writes.size(); ++i) {
+        if (!tick.writes[i]) {
+            continue;
+        }
+        int rpm = *tick.writes[i];
+        trace.applied_rpm[i] = static_cast<int16_t>(rpm);
+        std::string fan_num = std::to_string(i + 1);
+        std::cout << log_prefix << (use_pid ? " (pid)" : "") << ": setting RPM at " << tick.temp_c << "°C -> Fan" << fan_num << ": " << rpm << " RPM" << (rpm != tick.targets[i] ? " (target " + std::to_string(tick.targets[i]) + ")" : "") << std::endl;
+        if (tick.write_results[i] != "OK") {
+            std::cerr << log_prefix << ": failed to set fan " << fan_num << " speed: " << tick.write_results[i] << std::endl;
+            trace.result = -1;
         }
     }
 
-    std::cout << "better-auto: control loop stopped" << std::endl;
+    trace.latency_us = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tick_start).count());
+    trace_record(trace);
 }
 
-static void stop_better_auto()
+static void stop_curve_control()
 {
-    if (better_auto_running.exchange(false, std::memory_order_acq_rel)) {
-        if (better_auto_thread.joinable()) {
-            better_auto_thread.join();
-        }
-    } else if (better_auto_thread.joinable()) {
-        better_auto_thread.join();
+    curve_control_running.store(false, std::memory_order_release);
+    TaskHandle task;
+    std::string log_prefix;
+    {
+        std::lock_guard<std::mutex> lock(curve_mutex);
+        task = curve_control_task;
+        curve_control_task = 0;
+        log_prefix = curve_control_log_prefix;
     }
-    better_auto_thread = std::thread();
+    if (task == 0) {
+        return;
+    }
+
+    // Waits for a tick that is running right now (it takes curve_mutex)
+    auto stop_start = std::chrono::steady_clock::now();
+    cancel_task(task);
+    std::cout << log_prefix << ": control loop stopped" << std::endl;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stop_start);
+    std::lock_guard<std::mutex> lock(loop_latency_mutex);
+    curve_stop_last = elapsed;
+    curve_stop_max = std::max(curve_stop_max, elapsed);
 }
 
-static std::string start_better_auto()
+// Replaces any running control loop. name is the task name ("BETTER_AUTO",
+// "PROFILE"), log_prefix tags its log lines; nullptr curves follow the
+// config's BETTER_AUTO curves.
+static std::string start_curve_control(const std::string &name, const std::string &log_prefix,
+                                       std::shared_ptr<const FanCurvePair> curves)
 {
-    stop_better_auto();
+    stop_curve_control();
 
     auto result = write_hw_fan_mode("MANUAL");
     if (result != "OK") {
         return result;
     }
 
-    {
-        std::lock_guard<std::mutex> lock(cpu_usage_mutex);
-        previous_cpu_times.reset();
-    }
-
-    better_auto_running.store(true, std::memory_order_release);
-    try {
-        better_auto_thread = std::thread(better_auto_worker);
-    } catch (const std::exception &ex) {
-        better_auto_running.store(false, std::memory_order_release);
-        std::cerr << "better-auto: failed to start worker thread: " << ex.what() << std::endl;
-        return "ERROR: Unable to start better auto control thread";
-    } catch (...) {
-        better_auto_running.store(false, std::memory_order_release);
-        std::cerr << "better-auto: failed to start worker thread (unknown error)" << std::endl;
-        return "ERROR: Unable to start better auto control thread";
-    }
-
+    control_loop.reset();
+    controller_last_tick = std::chrono::steady_clock::time_point::min();
+    curve_force_apply.store(false, std::memory_order_release);
+    curve_control_running.store(true, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(curve_mutex);
+    active_curves = std::move(curves);
+    curve_control_log_prefix = log_prefix;
+    curve_control_period = backend_config()->control_tick;
+    bool pid_allowed = (name == "BETTER_AUTO");
+    curve_control_task = schedule_periodic_task(name, curve_control_period, [log_prefix, pid_allowed]() {
+        curve_control_tick(log_prefix, pid_allowed);
+    });
+    std::cout << log_prefix << ": control loop started" << std::endl;
     return "OK";
 }
 
@@ -780,7 +520,7 @@ void reapply_fan_settings() {
         fan2_speed = last_fan2_speed;
     }
 
-    std::string current_mode = get_fan_mode();
+    std::string current_mode = read_fan_mode();
     if (current_mode == "MANUAL" && (fan1_speed || fan2_speed)) {
         std::ostringstream log_message;
         log_message << "Re-applying manual fan settings";
@@ -814,35 +554,92 @@ void reapply_fan_settings() {
     is_reapplying.store(false, std::memory_order_release);
 }
 
+static void assert_fan_mode(const std::string &mode)
+{
+    // Reapply the fan mode directly via hwmon
+    auto result = write_hw_fan_mode(mode);
+    if (result != "OK") {
+        std::cerr << "fan_mode_trigger: failed to assert mode " << mode << ": " << result << std::endl;
+    }
+
+    // Reapply fan settings if in manual mode
+    if (mode == "MANUAL") {
+        reapply_fan_settings();
+    }
+}
+
 // call set_fan_mode every 90 seconds so that the mode doesn't revert back (weird hp behaviour)
-// also re-applies manual fan speed
+// also re-applies manual fan speed. BETTER_AUTO keeps pwm1_enable at manual
+// every 80 seconds; set_fan_mode() has just written it, so that starts later.
+// A single task on the scheduler, replaced on every call.
 void fan_mode_trigger(const std::string mode) {
-    fan_thread_generation++;
-	if (mode == "AUTO" || mode == "BETTER_AUTO") return;
-
-    std::thread([mode, gen = fan_thread_generation.load()]() {
-        while (fan_thread_generation == gen) {
-            // Reapply the fan mode directly via hwmon
-            auto result = write_hw_fan_mode(mode);
-            if (result != "OK") {
-                std::cerr << "fan_mode_trigger: failed to assert mode " << mode << ": " << result << std::endl;
-            }
+    std::lock_guard<std::mutex> lock(mode_assert_mutex);
+    cancel_task(mode_assert_task);
+    mode_assert_task = 0;
+
+    if (mode == "AUTO") return;
+    auto config = backend_config();
+    mode_assert_better_auto = (mode == "BETTER_AUTO");
+    if (mode_assert_better_auto) {
+        mode_assert_period = config->better_auto_mode_assert_interval;
+        mode_assert_task = schedule_periodic_task("MODE_ASSERT", mode_assert_period,
+                                                  []() { assert_fan_mode("MANUAL"); }, mode_assert_period);
+        return;
+    }
+    mode_assert_period = config->mode_assert_interval;
+    mode_assert_task = schedule_periodic_task("MODE_ASSERT", mode_assert_period, [mode]() { assert_fan_mode(mode); });
+}
 
-            // Reapply fan settings if in manual mode
-            if (mode == "MANUAL") {
-                reapply_fan_settings();
-            }
+// Brings the running loops in line with a newly loaded config. Curves,
+// hysteresis and reapply time are read on every tick anyway; a changed
+// period restarts the task's grid with a tick right away, so no tick is
+// lost in the switch.
+void apply_backend_config()
+{
+    auto config = backend_config();
+    set_fan_apply_gap(config->fan_apply_gap);
 
-            // Wait for the interval (90 seconds)
-            for (int i = 0; i < 90; ++i) {
-                if (fan_thread_generation != gen) return;
-                std::this_thread::sleep_for(std::chrono::seconds(1));
+    {
+        std::lock_guard<std::mutex> lock(curve_mutex);
+        if (curve_control_task != 0) {
+            curve_force_apply.store(true, std::memory_order_release);
+            if (curve_control_period != config->control_tick) {
+                curve_control_period = config->control_tick;
+                reschedule_task(curve_control_task, curve_control_period);
+            } else {
+                run_task_now(curve_control_task);
             }
         }
-    }).detach();
+    }
+
+    std::lock_guard<std::mutex> lock(mode_assert_mutex);
+    auto period = mode_assert_better_auto ? config->better_auto_mode_assert_interval : config->mode_assert_interval;
+    if (mode_assert_task != 0 && period != mode_assert_period) {
+        mode_assert_period = period;
+        reschedule_task(mode_assert_task, mode_assert_period);
+    }
 }
 
 std::string get_fan_mode()
+{
+	auto snapshot = latest_telemetry();
+	{
+		std::lock_guard<std::mutex> lock(mode_mutex);
+		if (requested_mode == "BETTER_AUTO" || requested_mode == "PROFILE") {
+			return with_sample_timestamp(requested_mode, *snapshot);
+		}
+	}
+
+	if (snapshot->fan_mode.empty()) {
+		return "ERROR: Unable to read fan mode";
+	}
+	if (snapshot->fan_mode.rfind("ERROR", 0) == 0) {
+		return snapshot->fan_mode;
+	}
+	return with_sample_timestamp(snapshot->fan_mode, *snapshot);
+}
+
+std::string read_fan_mode()
 {
 	{
 		std::lock_guard<std::mutex> lock(mode_mutex);
@@ -851,12 +648,19 @@ std::string get_fan_mode()
 		}
 	}
 
-	std::string hwmon_path = find_hwmon_directory("/sys/devices/platform/hp-wmi/hwmon");
+	std::string hwmon_path = hwmon_directory();
 
 	if (!hwmon_path.empty())
 	{
 		std::string pwm_path = hwmon_path + "/pwm1_enable";
 		std::ifstream fan_ctrl(pwm_path);
+		if (!fan_ctrl && errno == ENOENT)
+		{
+			// Cached directory vanished (driver reloaded), rescan once
+			invalidate_hwmon_directory();
+			hwmon_path = hwmon_directory();
+			fan_ctrl.open(hwmon_path + "/pwm1_enable");
+		}
 
 		if (fan_ctrl)
 		{
@@ -890,133 +694,197 @@ std::string get_fan_mode()
 
 std::string get_cpu_temp()
 {
-	// Initialize sensors library (safe to call multiple times)
-	static std::once_flag sensors_init_flag;
-	std::call_once(sensors_init_flag, []() {
-		sensors_init(nullptr);
-	});
-
-	// Try to read CPU package temperature from libsensors
-	const sensors_chip_name *chip;
-	int chip_nr = 0;
-
-	while ((chip = sensors_get_detected_chips(nullptr, &chip_nr)) != nullptr) {
-		const sensors_feature *feature;
-		int feature_nr = 0;
-
-		while ((feature = sensors_get_features(chip, &feature_nr)) != nullptr) {
-			// Look for package temperature (coretemp is common for Intel CPUs)
-			if (feature->type == SENSORS_FEATURE_TEMP) {
-				const sensors_subfeature *subfeature;
-				int subfeature_nr = 0;
-
-				while ((subfeature = sensors_get_all_subfeatures(chip, feature, &subfeature_nr)) != nullptr) {
-					if (subfeature->type == SENSORS_SUBFEATURE_TEMP_INPUT) {
-						double temp_val;
-						if (sensors_get_value(chip, subfeature->number, &temp_val) == 0) {
-							if (temp_val >= 0 && temp_val <= 150) {
-								std::lock_guard<std::mutex> lock(cpu_temp_cache_mutex);
-								last_cpu_temp_c = temp_val;
-								return std::to_string(static_cast<int>(temp_val));
-							}
-						}
-					}
-				}
-			}
-		}
-	}
+	auto snapshot = latest_telemetry();
 
-	// Fallback to cached temperature
-	std::lock_guard<std::mutex> lock(cpu_temp_cache_mutex);
-	if (last_cpu_temp_c) {
-		return std::to_string(static_cast<int>(*last_cpu_temp_c));
+	if (snapshot->cpu_temp) {
+		return with_sample_timestamp(std::to_string(*snapshot->cpu_temp), *snapshot);
 	}
-	return "N/A";
+	// Fall back to the thermal zone / hwmon sensor used by BETTER_AUTO
+	if (snapshot->thermal.cpu_temp_c) {
+		return with_sample_timestamp(std::to_string(static_cast<int>(*snapshot->thermal.cpu_temp_c)), *snapshot);
+	}
+	return with_sample_timestamp("N/A", *snapshot);
 }
 
 std::string get_all_temps()
 {
-	// Initialize sensors library (safe to call multiple times)
-	static std::once_flag sensors_init_flag;
-	std::call_once(sensors_init_flag, []() {
-		sensors_init(nullptr);
-	});
-
-	// Get CPU temperatures from libsensors
-	// Returns: "PKG:48|CORES:40,39,43,45,43,45,45,45,45,45|NVME:37,36"
-	std::string pkg_temp;
-	std::string cores_temp;
-	std::string nvme_temps;
-	std::set<uintptr_t> nvme_chips_read;
-
-	const sensors_chip_name *chip;
-	int chip_nr = 0;
-	
-	while ((chip = sensors_get_detected_chips(nullptr, &chip_nr)) != nullptr) {
-		const char *prefix = chip->prefix;
-		if (!prefix) continue;
-
-		const sensors_feature *feature;
-		int feature_nr = 0;
-
-		while ((feature = sensors_get_features(chip, &feature_nr)) != nullptr) {
-			if (feature->type == SENSORS_FEATURE_TEMP) {
-				const bool is_coretemp = (prefix[0] == 'c' && prefix[1] == 'o' && prefix[2] == 'r' && prefix[3] == 'e');
-				const bool is_nvme = (prefix[0] == 'n' && prefix[1] == 'v' && prefix[2] == 'm' && prefix[3] == 'e');
-
-				if (is_nvme && nvme_chips_read.count((uintptr_t)chip) > 0) {
-					continue;
-				}
-
-				const sensors_subfeature *subfeature;
-				int subfeature_nr = 0;
-
-				while ((subfeature = sensors_get_all_subfeatures(chip, feature, &subfeature_nr)) != nullptr) {
-					if (subfeature->type == SENSORS_SUBFEATURE_TEMP_INPUT) {
-						double temp_val;
-						if (sensors_get_value(chip, subfeature->number, &temp_val) == 0 && temp_val >= 0 && temp_val <= 150) {
-							int temp_int = static_cast<int>(temp_val);
-
-							if (is_coretemp) {
-								if (feature_nr == 1 && pkg_temp.empty()) {
-									pkg_temp = std::to_string(temp_int);
-								} else if (feature_nr > 1) {
-									if (!cores_temp.empty()) cores_temp += ",";
-									cores_temp += std::to_string(temp_int);
-								}
-							} else if (is_nvme) {
-								if (!nvme_temps.empty()) nvme_temps += ",";
-								nvme_temps += std::to_string(temp_int);
-								nvme_chips_read.insert((uintptr_t)chip);
-								break;
-							}
-						}
-					}
-				}
-			}
+	return format_all_temps(*latest_telemetry());
+}
+
+std::string format_all_temps(const TelemetrySnapshot &snapshot)
+{
+	// Returns: "PKG:48|CORES:40,39,43,45,43,45,45,45,45,45|NVME:37,36|TS:1700000000000"
+	auto join = [](const std::vector<int> &values) {
+		std::string joined;
+		for (int value : values) {
+			if (!joined.empty()) joined += ",";
+			joined += std::to_string(value);
 		}
-	}
+		return joined;
+	};
 
-	// Build result string with labels
 	std::string result;
-	if (!pkg_temp.empty()) {
-		result += "PKG:" + pkg_temp;
+	if (snapshot.pkg_temp) {
+		result += "PKG:" + std::to_string(*snapshot.pkg_temp);
 	}
-	if (!cores_temp.empty()) {
+	if (!snapshot.core_temps.empty()) {
 		if (!result.empty()) result += "|";
-		result += "CORES:" + cores_temp;
+		result += "CORES:" + join(snapshot.core_temps);
 	}
-	if (!nvme_temps.empty()) {
+	if (!snapshot.nvme_temps.empty()) {
 		if (!result.empty()) result += "|";
-		result += "NVME:" + nvme_temps;
+		result += "NVME:" + join(snapshot.nvme_temps);
 	}
 
-	std::cout << "DEBUG: get_all_temps() returning: " << (result.empty() ? "N/A" : result) << std::endl;
-	return result.empty() ? "N/A" : result;
+	return with_sample_timestamp(result.empty() ? "N/A" : result, snapshot);
 }
 
+// What the control loop sees, raw and filtered:
+// "CPU:71.0|CPU_RAW:80.0|GPU:55.0|GPU_RAW:55.0|CPU_USAGE:12.5|GPU_USAGE:3.0|TS:1700000000000"
+std::string get_thermal()
+{
+	auto snapshot = latest_telemetry();
+	const ThermalSnapshot &thermal = snapshot->thermal;
 
-std::string set_fan_mode(const std::string &mode)
+	auto format = [](const std::optional<double> &value) {
+		if (!value) {
+			return std::string("N/A");
+		}
+		std::ostringstream out;
+		out.setf(std::ios::fixed);
+		out.precision(1);
+		out << *value;
+		return out.str();
+	};
+
+	std::string result = "CPU:" + format(thermal.cpu_temp_c) +
+	                     "|CPU_RAW:" + format(thermal.cpu_temp_raw_c) +
+	                     "|GPU:" + format(thermal.gpu_temp_c) +
+	                     "|GPU_RAW:" + format(thermal.gpu_temp_raw_c) +
+	                     "|CPU_USAGE:" + format(thermal.cpu_usage_pct) +
+	                     "|GPU_USAGE:" + format(thermal.gpu_usage_pct);
+	return with_sample_timestamp(result, *snapshot);
+}
+
+// Everything the fan page shows, from one snapshot:
+// "V1|TS:<ms>|MODE:AUTO|FAN1:2300|FAN2:2400|CPU:48|PKG:48|CORES:40,39|NVME:37"
+// Clients must ignore sections they don't know; incompatible changes bump
+// the version.
+std::string get_status()
+{
+	auto snapshot = latest_telemetry();
+
+	std::string result = "V1|TS:" + std::to_string(snapshot->timestamp_ms);
+	for (const auto &section : telemetry_sections(*snapshot, kFieldAll)) {
+		result += "|" + section.first + ":" + section.second;
+	}
+	return result;
+}
+
+// Pending fan targets and scheduler counters
+std::string get_fan_queue()
+{
+	return format_fan_scheduler_stats();
+}
+
+// Tick jitter of the control loops and how long a mode switch waited for
+// the BETTER_AUTO/PROFILE loop to stop
+std::string get_loop_timing()
+{
+	std::chrono::microseconds stop_last, stop_max;
+	{
+		std::lock_guard<std::mutex> lock(loop_latency_mutex);
+		stop_last = curve_stop_last;
+		stop_max = curve_stop_max;
+	}
+	return format_loop_timer_stats("BETTER_AUTO", task_stats("BETTER_AUTO")) + "|" +
+	       format_loop_timer_stats("PROFILE", task_stats("PROFILE")) + "|" +
+	       format_loop_timer_stats("MODE_ASSERT", task_stats("MODE_ASSERT")) + "|" +
+	       format_loop_timer_stats("SAMPLE", task_stats("SAMPLE")) +
+	       "|TASKS:" + std::to_string(scheduled_task_count()) +
+	       "|THREADS:" + std::to_string(process_thread_count()) +
+	       "|STOP_LAST_US:" + std::to_string(stop_last.count()) +
+	       "|STOP_MAX_US:" + std::to_string(stop_max.count());
+}
+
+// Which controller drives BETTER_AUTO, the PID state and how often each
+// controller wrote (or would have, in shadow) and how far the temperature
+// went above the PID target while it was driving
+std::string get_controller_stats()
+{
+	auto config = backend_config();
+	std::array<ControllerStats, 2> stats;
+	ControllerKind active;
+	std::array<int, 2> pid_rpms;
+	double pid_output, pid_integral, pid_slope;
+	std::array<ShaperStats, 2> shapers;
+	{
+		std::lock_guard<std::mutex> lock(controller_stats_mutex);
+		stats = controller_stats;
+		active = controller_active;
+		pid_rpms = pid_rpms_now;
+		pid_output = pid_output_now;
+		pid_integral = pid_integral_now;
+		pid_slope = pid_slope_now;
+		shapers = shaper_stats_now;
+	}
+
+	ShaperStats shaped;
+	for (const auto &fan : shapers) {
+		shaped.requests += fan.requests;
+		shaped.writes += fan.writes;
+		shaped.equal += fan.equal;
+		shaped.deadband += fan.deadband;
+		shaped.superseded += fan.superseded;
+		shaped.slew_steps += fan.slew_steps;
+	}
+	auto loop_time = stats[0].active_time + stats[1].active_time;
+	double avoided_per_hour = loop_time.count() > 0
+		? static_cast<double>(shaped.avoided()) * 3600000.0 / static_cast<double>(loop_time.count()) : 0.0;
+
+	std::ostringstream out;
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "ACTIVE:" << controller_name(active)
+	    << "|TARGET_C:" << config->pid.target_c
+	    << "|PID_OUT:" << pid_output
+	    << "|PID_I:" << pid_integral
+	    << "|SLOPE_C_PER_S:" << pid_slope
+	    << "|PID_FAN1:" << pid_rpms[0]
+	    << "|PID_FAN2:" << pid_rpms[1]
+	    << "|" << format_controller_stats("CURVE", stats[0])
+	    << "|" << format_controller_stats("PID", stats[1])
+	    << "|SHAPER_REQUESTS:" << shaped.requests
+	    << "|SHAPER_WRITES:" << shaped.writes
+	    << "|SHAPER_AVOIDED:" << shaped.avoided()
+	    << "|SHAPER_AVOIDED_PER_H:" << avoided_per_hour
+	    << "|SHAPER_EQUAL:" << shaped.equal
+	    << "|SHAPER_DEADBAND:" << shaped.deadband
+	    << "|SHAPER_SUPERSEDED:" << shaped.superseded
+	    << "|SHAPER_SLEW_STEPS:" << shaped.slew_steps;
+	return out.str();
+}
+
+FanControlState fan_control_state()
+{
+	FanControlState state;
+	state.pid_target_c = backend_config()->pid.target_c;
+	{
+		std::lock_guard<std::mutex> lock(fan_state_mutex);
+		state.applied_target = applied_fan_target;
+	}
+	std::lock_guard<std::mutex> lock(controller_stats_mutex);
+	state.active = controller_active;
+	state.pid_output = pid_output_now;
+	state.pid_integral = pid_integral_now;
+	state.pid_slope = pid_slope_now;
+	state.pid_rpms = pid_rpms_now;
+	state.controllers = controller_stats;
+	state.shapers = shaper_stats_now;
+	return state;
+}
+
+static std::string set_fan_mode_locked(const std::string &mode)
 {
     std::string previous_mode;
     {
@@ -1027,7 +895,7 @@ std::string set_fan_mode(const std::string &mode)
     bool entering_profile = (mode == "PROFILE" && previous_mode != "PROFILE");
 
     if (mode == "BETTER_AUTO") {
-        auto result = start_better_auto();
+        auto result = start_curve_control("BETTER_AUTO", "better-auto", nullptr);
         if (result == "OK") {
             std::lock_guard<std::mutex> lock(mode_mutex);
             requested_mode = "BETTER_AUTO";
@@ -1036,9 +904,14 @@ std::string set_fan_mode(const std::string &mode)
     }
 
     if (mode == "PROFILE") {
-        // PROFILE mode uses manual PWM control with profile data
-        stop_better_auto();
-        auto result = write_hw_fan_mode("MANUAL");
+        // Follows the uploaded curves, the BETTER_AUTO ones until a profile
+        // was uploaded
+        std::shared_ptr<const FanCurvePair> curves;
+        {
+            std::lock_guard<std::mutex> lock(curve_mutex);
+            curves = profile_curves;
+        }
+        auto result = start_curve_control("PROFILE", "profile", curves);
         if (result == "OK") {
             std::lock_guard<std::mutex> lock(mode_mutex);
             requested_mode = "PROFILE";
@@ -1051,7 +924,7 @@ std::string set_fan_mode(const std::string &mode)
         return result;
     }
 
-    stop_better_auto();
+    stop_curve_control();
 
     auto result = write_hw_fan_mode(mode);
     if (result == "OK") {
@@ -1066,14 +939,21 @@ std::string set_fan_mode(const std::string &mode)
     return result;
 }
 
+std::string set_fan_mode(const std::string &mode)
+{
+    std::lock_guard<std::mutex> transition_lock(mode_transition_mutex);
+    return set_fan_mode_locked(mode);
+}
+
 std::string ensure_better_auto_mode()
 {
+    std::lock_guard<std::mutex> transition_lock(mode_transition_mutex);
     bool needs_force = false;
     {
         std::lock_guard<std::mutex> lock(mode_mutex);
         if (requested_mode != "BETTER_AUTO") {
             needs_force = true;
-        } else if (!better_auto_running.load(std::memory_order_acquire)) {
+        } else if (!curve_control_running.load(std::memory_order_acquire)) {
             needs_force = true;
         }
     }
@@ -1083,7 +963,7 @@ std::string ensure_better_auto_mode()
     }
 
     std::cout << "Enforcing BETTER_AUTO mode" << std::endl;
-    auto result = set_fan_mode("BETTER_AUTO");
+    auto result = set_fan_mode_locked("BETTER_AUTO");
     if (result == "OK") {
         fan_mode_trigger("BETTER_AUTO");
     }
@@ -1092,174 +972,144 @@ std::string ensure_better_auto_mode()
 
 std::string get_fan_speed(const std::string &fan_num)
 {
-	std::string hwmon_path = find_hwmon_directory("/sys/devices/platform/hp-wmi/hwmon");
-
-	if (!hwmon_path.empty())
+	if (fan_num != "1" && fan_num != "2")
 	{
-		std::ifstream fan_file(hwmon_path + "/fan" + fan_num + "_input");
-
-		if (fan_file)
-		{
-			std::stringstream buffer;
-			buffer << fan_file.rdbuf();
-
-			std::string fan_speed = buffer.str();
-
-			fan_speed.erase(fan_speed.find_last_not_of(" \n\r\t") + 1);
-
-			return fan_speed;
-		}
-		else
-		{
-			std::cerr << "Failed to open fan speed file. Error: " << strerror(errno) << std::endl;
-			return "ERROR: Unable to read fan speed";
-		}
+		return "ERROR: Unable to read fan speed";
 	}
-	else
+	size_t index = (fan_num == "2") ? 1 : 0;
+
+	auto snapshot = latest_telemetry();
+	if (!snapshot->hwmon_found)
 	{
-		std::cerr << "Hwmon directory not found" << std::endl;
 		return "ERROR: Hwmon directory not found";
 	}
+	if (!snapshot->fan_rpm[index])
+	{
+		return "ERROR: Unable to read fan speed";
+	}
+	return with_sample_timestamp(std::to_string(*snapshot->fan_rpm[index]), *snapshot);
 }
 
 std::string set_fan_speed(const std::string &fan_num, const std::string &speed, bool trigger_mode, bool update_cache)
 {
+    if (fan_num != "1" && fan_num != "2") {
+        return "ERROR: Invalid fan number " + fan_num;
+    }
+
     int parsed_speed = 0;
-    bool parsed = false;
     try {
         parsed_speed = std::stoi(speed);
-        parsed = true;
     } catch (const std::exception &) {
-        parsed = false;
+        return "ERROR: Invalid fan speed " + speed;
     }
 
-    if (parsed) {
-        size_t index = (fan_num == "2") ? 1 : 0;
-        int clamped_speed = clamp_to_fan_limits(index, parsed_speed);
-        if (clamped_speed != parsed_speed) {
-            std::cout << "set_fan_speed: clamped fan " << fan_num << " target from " << parsed_speed << " to " << clamped_speed << std::endl;
-        }
-        std::string clamped_str = std::to_string(clamped_speed);
-        if (update_cache) {
-            std::lock_guard<std::mutex> lock(fan_state_mutex);
-            if (fan_num == "1") {
-                last_fan1_speed = clamped_str;
-            } else if (fan_num == "2") {
-                last_fan2_speed = clamped_str;
-            }
-        }
-
-        // Update command string if we parsed successfully
-        std::string command = "sudo /usr/bin/set-fan-speed.sh " + fan_num + " " + clamped_str;
-
-        std::unique_lock<std::mutex> apply_lock(fan_apply_mutex);
-        auto now = std::chrono::steady_clock::now();
-        if (index == 1 && fan_last_apply[0] != std::chrono::steady_clock::time_point::min()) {
-            auto elapsed = now - fan_last_apply[0];
-            if (elapsed < kFanApplyGap) {
-                auto wait_duration = kFanApplyGap - elapsed;
-                apply_lock.unlock();
-                std::this_thread::sleep_for(wait_duration);
-                apply_lock.lock();
-            }
-        }
-
-        int result = system(command.c_str());
-        fan_last_apply[index] = std::chrono::steady_clock::now();
-        apply_lock.unlock();
-
-        if (result == 0)
-        {
-            // Only trigger fan_mode_trigger if requested and not already reapplying
-            if (trigger_mode && !is_reapplying.load(std::memory_order_acquire) && get_fan_mode() == "MANUAL") {
-                fan_mode_trigger("MANUAL");
-            }
-            return "OK";
-        }
-        else
-        {
-            std::cerr << "Failed to execute set-fan-speed.sh for fan " << fan_num << ". Exit code: " << WEXITSTATUS(result) << std::endl;
-            return "ERROR: Failed to set fan speed";
-        }
+    if (hwmon_directory().empty()) {
+        return "ERROR: Hwmon directory not found";
     }
 
-    // If parsing failed, fall back to original behavior without clamping
+    size_t index = (fan_num == "2") ? 1 : 0;
+    int clamped_speed = clamp_to_fan_limits(index, parsed_speed);
+    if (clamped_speed != parsed_speed) {
+        std::cout << "set_fan_speed: clamped fan " << fan_num << " target from " << parsed_speed << " to " << clamped_speed << std::endl;
+    }
     if (update_cache) {
         std::lock_guard<std::mutex> lock(fan_state_mutex);
-        if (fan_num == "1") {
-            last_fan1_speed = speed;
-        } else if (fan_num == "2") {
-            last_fan2_speed = speed;
+        if (index == 0) {
+            last_fan1_speed = std::to_string(clamped_speed);
+        } else {
+            last_fan2_speed = std::to_string(clamped_speed);
         }
     }
 
-    // Construct the command to call the external script with sudo
-    // The script must be in a location like /usr/bin
-    std::string command = "sudo /usr/bin/set-fan-speed.sh " + fan_num + " " + speed;
-
-    int result = system(command.c_str());
+    // Written asynchronously; a newer target for the same fan replaces this
+    // one if it has not been written yet
+    start_fan_scheduler(write_fan_target);
+    submit_fan_target(index, clamped_speed);
 
-    if (result == 0)
-    {
-        // Only trigger fan_mode_trigger if requested and not already reapplying
-        if (trigger_mode && !is_reapplying.load(std::memory_order_acquire) && get_fan_mode() == "MANUAL") {
-            fan_mode_trigger("MANUAL");
-        }
-        return "OK";
-    }
-    else
-    {
-        std::cerr << "Failed to execute set-fan-speed.sh for fan " << fan_num << ". Exit code: " << WEXITSTATUS(result) << std::endl;
-        return "ERROR: Failed to set fan speed";
+    // Only trigger fan_mode_trigger if requested and not already reapplying
+    if (trigger_mode && !is_reapplying.load(std::memory_order_acquire) && read_fan_mode() == "MANUAL") {
+        fan_mode_trigger("MANUAL");
     }
+    return "OK";
 }
 
 std::string set_fan_profile(const std::string &profile_data)
 {
-    // Parse profile_data: "temp1 rpm1 temp2 rpm2 ..."
+    // "temp1 rpm1 temp2 rpm2 ..." for both fans, or separate curves as
+    // "FAN1 temp rpm ... FAN2 temp rpm ..." (a missing fan uses the other's)
     std::istringstream iss(profile_data);
-    std::vector<std::pair<int, int>> profile_points;
-    int temp, rpm;
+    std::array<std::string, 3> section_text; // shared, FAN1, FAN2
+    size_t section = 0;
+    bool have_sections = false;
+    std::string token;
+
+    while (iss >> token) {
+        if (token == "FAN1" || token == "FAN2") {
+            section = (token == "FAN1") ? 1 : 2;
+            have_sections = true;
+            continue;
+        }
+        section_text[section] += token + " ";
+    }
+
+    if (!section_text[0].empty() && have_sections) {
+        return "ERROR: Profile mixes shared and per-fan points";
+    }
 
-    while (iss >> temp >> rpm) {
-        // Validate temperature range (30-100°C)
-        if (temp < 30 || temp > 100) {
-            return "ERROR: Invalid temperature " + std::to_string(temp) + " (valid range: 30-100)";
+    // Same parser and checks as fan1_curve/fan2_curve in backend.conf
+    std::array<std::vector<FanCurvePoint>, 2> fan_points;
+    if (!section_text[0].empty()) {
+        // Shared points are clamped to fan 1's limit when written
+        auto result = parse_curve_points(section_text[0], FAN2_MAX_RPM, fan_points[0]);
+        if (result != "OK") {
+            return result;
         }
-        
-        // Validate RPM: 0 (0 RPM mode) or minimum 1500
-        if (rpm != 0 && rpm < 1500) {
-            return "ERROR: Invalid RPM " + std::to_string(rpm) + " (must be 0 or >= 1500)";
+        fan_points[1] = fan_points[0];
+    } else {
+        for (size_t i = 0; i < fan_points.size(); ++i) {
+            if (section_text[i + 1].empty()) {
+                continue;
+            }
+            auto result = parse_curve_points(section_text[i + 1], i == 0 ? FAN1_MAX_RPM : FAN2_MAX_RPM, fan_points[i]);
+            if (result != "OK") {
+                return "ERROR: FAN" + std::to_string(i + 1) + ": " + result.substr(7);
+            }
+        }
+        if (fan_points[0].empty() && fan_points[1].empty()) {
+            return "ERROR: No valid profile points provided";
         }
-        if (rpm > 6100) {
-            return "ERROR: Invalid RPM " + std::to_string(rpm) + " (maximum is 6100)";
+        if (fan_points[0].empty()) {
+            fan_points[0] = fan_points[1];
+        } else if (fan_points[1].empty()) {
+            fan_points[1] = fan_points[0];
         }
-        
-        profile_points.push_back({temp, rpm});
     }
 
-    if (profile_points.empty()) {
-        return "ERROR: No valid profile points provided";
+    for (size_t i = 0; i < fan_points.size(); ++i) {
+        std::cout << "Profile for fan " << (i + 1) << " set with " << fan_points[i].size() << " points" << std::endl;
+        for (const auto &point : fan_points[i]) {
+            std::cout << "  " << point.first << "°C -> " << point.second << " RPM" << std::endl;
+        }
     }
 
-    // Store profile for manual application
-    std::cout << "Profile set with " << profile_points.size() << " points" << std::endl;
-    for (const auto &point : profile_points) {
-        std::cout << "  " << point.first << "°C -> " << point.second << " RPM" << std::endl;
-    }
+    auto curves = std::make_shared<const FanCurvePair>(FanCurvePair{FanCurve(std::move(fan_points[0])),
+                                                                    FanCurve(std::move(fan_points[1]))});
 
-    // For now, apply the first point as a test
-    if (!profile_points.empty()) {
-        int rpm = profile_points[0].second;
-        // Apply to both fans with the same RPM
-        std::string result1 = set_fan_speed("1", std::to_string(rpm), false, true);
-        if (result1 != "OK") return result1;
-        
-        std::this_thread::sleep_for(std::chrono::seconds(2));
-        
-        std::string result2 = set_fan_speed("2", std::to_string(rpm), false, true);
-        if (result2 != "OK") return result2;
+    std::lock_guard<std::mutex> transition_lock(mode_transition_mutex);
+    std::string mode;
+    {
+        std::lock_guard<std::mutex> lock(mode_mutex);
+        mode = requested_mode;
     }
 
+    // A running PROFILE loop switches to the new curves on its next tick,
+    // which is right now; otherwise they wait for SET_FAN_MODE PROFILE
+    std::lock_guard<std::mutex> lock(curve_mutex);
+    profile_curves = curves;
+    if (mode == "PROFILE" && curve_control_task != 0) {
+        active_curves = curves;
+        curve_force_apply.store(true, std::memory_order_release);
+        run_task_now(curve_control_task);
+    }
     return "OK";
 }
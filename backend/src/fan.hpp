@@ -1,12 +1,47 @@
+#include <array>
+#include <optional>
 #include <string>
 
+#include "fan_controller.hpp"
+#include "output_shaper.hpp"
+
+struct TelemetrySnapshot;
+
+// Copy of the control loop state for the metrics exporter; no hardware I/O
+struct FanControlState {
+    std::array<std::optional<int>, 2> applied_target; // last target written to each fan
+    ControllerKind active = ControllerKind::Curve;
+    double pid_target_c = 0.0;
+    double pid_output = 0.0;
+    double pid_integral = 0.0;
+    double pid_slope = 0.0;
+    std::array<int, 2> pid_rpms = {0, 0};
+    std::array<ControllerStats, 2> controllers; // curve, PID
+    std::array<ShaperStats, 2> shapers;         // per fan
+};
+
 void fan_mode_trigger(const std::string mode);
 std::string set_fan_mode(const std::string &value);
+// From the telemetry snapshot, with "|TS:<ms>"
 std::string get_fan_mode();
+// Reads pwm1_enable; BETTER_AUTO/PROFILE when one of those is requested
+std::string read_fan_mode();
 std::string get_cpu_temp();
 std::string get_all_temps();
+// The GET_ALL_TEMPS reply for a snapshot
+std::string format_all_temps(const TelemetrySnapshot &snapshot);
+std::string get_thermal();
+std::string get_status();
+std::string get_fan_queue();
+std::string get_loop_timing();
+std::string get_controller_stats();
+FanControlState fan_control_state();
 
 std::string get_fan_speed(const std::string &fan_num);
+// Validates and queues the target on the fan scheduler; does not wait for
+// the hardware write
 std::string set_fan_speed(const std::string &fan_num, const std::string &speed, bool trigger_mode = true, bool update_cache = true);
 std::string set_fan_profile(const std::string &profile_data);
 std::string ensure_better_auto_mode();
+// Re-reads backend_config() into the running control loops
+void apply_backend_config();
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <string>
+#include <array>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "fan_broker.hpp"
+#include "util.hpp"
+
+// Privileged half of the fan fd broker. Run by victus-backend as
+// "sudo -n victus-fan-broker" with a unix socket on stdin; it takes no
+// arguments so it can only ever hand out the fixed hp-wmi control files.
+
+static bool send_reply(const FanBrokerReply &reply, const int *fds, size_t fd_count)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<FanBrokerReply *>(&reply);
+    iov.iov_len = sizeof(reply);
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kBrokerFdCount)];
+    std::memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (fd_count > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+        std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fd_count);
+    }
+
+    return sendmsg(STDIN_FILENO, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(reply));
+}
+
+static bool send_error(const std::string &error)
+{
+    FanBrokerReply reply;
+    std::memset(&reply, 0, sizeof(reply));
+    reply.magic = kFanBrokerMagic;
+    reply.fd_count = 0;
+    std::strncpy(reply.error, error.c_str(), sizeof(reply.error) - 1);
+    return send_reply(reply, nullptr, 0);
+}
+
+int main()
+{
+    int sock_type = 0;
+    socklen_t sock_type_len = sizeof(sock_type);
+    if (getsockopt(STDIN_FILENO, SOL_SOCKET, SO_TYPE, &sock_type, &sock_type_len) < 0) {
+        std::cerr << "victus-fan-broker: stdin is not a socket; this helper is started by victus-backend" << std::endl;
+        return 1;
+    }
+
+    std::string hwmon_path = find_hwmon_directory(HP_WMI_HWMON_BASE);
+    if (hwmon_path.empty() || hwmon_path.size() >= sizeof(FanBrokerReply::hwmon_path)) {
+        send_error("Hwmon directory not found");
+        return 3;
+    }
+
+    const std::array<std::string, kBrokerFdCount> names = {"pwm1_enable", "fan1_target", "fan2_target"};
+    std::array<int, kBrokerFdCount> fds;
+    fds.fill(-1);
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        std::string path = hwmon_path + "/" + names[i];
+        fds[i] = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fds[i] < 0) {
+            std::string error = "Unable to open " + names[i] + ": " + strerror(errno);
+            for (int fd : fds) {
+                if (fd >= 0) close(fd);
+            }
+            send_error(error);
+            return 1;
+        }
+    }
+
+    FanBrokerReply reply;
+    std::memset(&reply, 0, sizeof(reply));
+    reply.magic = kFanBrokerMagic;
+    reply.fd_count = kBrokerFdCount;
+    std::strncpy(reply.hwmon_path, hwmon_path.c_str(), sizeof(reply.hwmon_path) - 1);
+
+    bool sent = send_reply(reply, fds.data(), fds.size());
+    for (int fd : fds) {
+        close(fd);
+    }
+
+    if (!sent) {
+        std::cerr << "victus-fan-broker: failed to pass descriptors: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef FAN_BROKER_HPP
+#define FAN_BROKER_HPP
+
+#include <cstdint>
+
+// victus-fan-broker is started through sudo once, opens the hp-wmi control
+// files as root and passes the descriptors back over its stdin (a unix
+// socket) with SCM_RIGHTS. The backend then writes to them directly.
+
+#define FAN_BROKER_PATH "/usr/bin/victus-fan-broker"
+
+static constexpr uint32_t kFanBrokerMagic = 0x56464231; // "VFB1"
+
+// Order of the descriptors attached to the reply
+enum FanBrokerFd : uint32_t {
+    kBrokerPwmEnable = 0,
+    kBrokerFan1Target = 1,
+    kBrokerFan2Target = 2,
+    kBrokerFdCount = 3
+};
+
+struct FanBrokerReply {
+    uint32_t magic;
+    uint32_t fd_count;    // 0 on error, kBrokerFdCount on success
+    char hwmon_path[256]; // hwmon directory the descriptors belong to
+    char error[128];      // set when fd_count is 0
+};
+
+#endif // FAN_BROKER_HPP
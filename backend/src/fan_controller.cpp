@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <sstream>
+
+#include "fan_controller.hpp"
+
+const char *controller_name(ControllerKind kind)
+{
+    return kind == ControllerKind::Pid ? "PID" : "CURVE";
+}
+
+std::optional<ControllerKind> parse_controller_kind(const std::string &name)
+{
+    std::string lower = name;
+    for (char &ch : lower) {
+        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+    if (lower == "curve") {
+        return ControllerKind::Curve;
+    }
+    if (lower == "pid") {
+        return ControllerKind::Pid;
+    }
+    return std::nullopt;
+}
+
+void PidController::reset()
+{
+    history_count = 0;
+    history_next = 0;
+    have_sample = false;
+    last_error = 0.0;
+    integral_term = 0.0;
+    last_output = 0.0;
+    last_slope = 0.0;
+}
+
+double PidController::fit_slope() const
+{
+    if (history_count < 2) {
+        return 0.0;
+    }
+
+    double mean_t = 0.0, mean_temp = 0.0;
+    for (size_t i = 0; i < history_count; ++i) {
+        mean_t += history[i].first;
+        mean_temp += history[i].second;
+    }
+    mean_t /= static_cast<double>(history_count);
+    mean_temp /= static_cast<double>(history_count);
+
+    double covariance = 0.0, variance = 0.0;
+    for (size_t i = 0; i < history_count; ++i) {
+        double dt = history[i].first - mean_t;
+        covariance += dt * (history[i].second - mean_temp);
+        variance += dt * dt;
+    }
+    return variance > 0.0 ? covariance / variance : 0.0;
+}
+
+double PidController::update(double temp_c, std::chrono::steady_clock::time_point now)
+{
+    double dt = 0.0;
+    if (!have_sample) {
+        first_sample = now;
+        have_sample = true;
+    } else {
+        dt = std::chrono::duration<double>(now - last_sample).count();
+    }
+    last_sample = now;
+
+    history[history_next] = {std::chrono::duration<double>(now - first_sample).count(), temp_c};
+    history_next = (history_next + 1) % history.size();
+    history_count = std::min(history_count + 1, history.size());
+    last_slope = fit_slope();
+
+    double error = temp_c - tuning.target_c;
+    double derivative = dt > 0.0 ? (error - last_error) / dt : 0.0;
+    last_error = error;
+
+    double without_integral = tuning.kp * error + tuning.kd * derivative + tuning.kff * last_slope;
+    double integral = std::clamp(integral_term + tuning.ki * error * dt, 0.0, 1.0);
+    double unclamped = without_integral + integral;
+    // Anti-windup: hold the integral while the output is pinned at a limit
+    // and the error pushes further into it
+    if (!((unclamped > 1.0 && error > 0.0) || (unclamped < 0.0 && error < 0.0))) {
+        integral_term = integral;
+    }
+
+    last_output = std::clamp(without_integral + integral_term, 0.0, 1.0);
+    return last_output;
+}
+
+int pid_output_rpm(double output, int min_rpm, int max_rpm)
+{
+    if (max_rpm <= min_rpm) {
+        return max_rpm;
+    }
+    double span = static_cast<double>(max_rpm - min_rpm);
+    int steps = static_cast<int>(std::lround(std::clamp(output, 0.0, 1.0) * span / kPidRpmStep));
+    return std::min(min_rpm + steps * kPidRpmStep, max_rpm);
+}
+
+std::string format_controller_stats(const std::string &prefix, const ControllerStats &stats)
+{
+    auto per_hour = [](uint64_t count, std::chrono::milliseconds time) {
+        return time.count() > 0 ? static_cast<double>(count) * 3600000.0 / static_cast<double>(time.count()) : 0.0;
+    };
+
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(1);
+    out << prefix << "_ACTIVE_S:" << stats.active_time.count() / 1000
+        << "|" << prefix << "_WRITES:" << stats.writes
+        << "|" << prefix << "_WRITES_PER_H:" << per_hour(stats.writes, stats.active_time)
+        << "|" << prefix << "_SHADOW_WRITES_PER_H:" << per_hour(stats.shadow_writes, stats.shadow_time)
+        << "|" << prefix << "_OVERSHOOT_C:" << stats.peak_overshoot_c;
+    return out.str();
+}
@@ -0,0 +1,86 @@
+#ifndef FAN_CONTROLLER_HPP
+#define FAN_CONTROLLER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Which controller drives the fans in BETTER_AUTO; the other one keeps
+// running in shadow so the two can be compared
+enum class ControllerKind { Curve = 0, Pid = 1 };
+
+// "CURVE" / "PID"
+const char *controller_name(ControllerKind kind);
+// "curve" / "pid", any case
+std::optional<ControllerKind> parse_controller_kind(const std::string &name);
+
+// Gains act on the output as a fraction of each fan's range (0: minimum
+// non-zero RPM, 1: maximum), so one set works for both fans
+struct PidTuning {
+    double target_c = 70.0; // hottest temperature to hold
+    double kp = 0.05;       // per °C above target
+    double ki = 0.002;      // per °C·s
+    double kd = 0.0;        // per °C/s change of the error between ticks
+    double kff = 0.15;      // per °C/s of the temperature slope
+};
+
+// Output steps smaller than this are not worth a firmware write
+static constexpr int kPidRpmStep = 100;
+
+// PID on the hottest temperature plus a feed-forward term from its slope,
+// a least-squares fit over the last few samples, so the fans ramp up while
+// the temperature is still climbing instead of after it arrived. The
+// integral only accumulates while the output is not saturated in the
+// direction of the error (anti-windup) and stays within 0..1.
+class PidController
+{
+public:
+    void set_tuning(const PidTuning &new_tuning) { tuning = new_tuning; }
+    void reset();
+
+    // One sample; returns the new output in 0..1
+    double update(double temp_c, std::chrono::steady_clock::time_point now);
+
+    double output() const { return last_output; }
+    double integral() const { return integral_term; }
+    double slope() const { return last_slope; } // °C/s
+
+private:
+    static constexpr size_t kSlopeSamples = 6;
+
+    double fit_slope() const;
+
+    PidTuning tuning;
+    std::array<std::pair<double, double>, kSlopeSamples> history = {}; // {seconds since first sample, °C}
+    size_t history_count = 0;
+    size_t history_next = 0;
+    std::chrono::steady_clock::time_point first_sample;
+    std::chrono::steady_clock::time_point last_sample;
+    bool have_sample = false;
+    double last_error = 0.0;
+    double integral_term = 0.0;
+    double last_output = 0.0;
+    double last_slope = 0.0;
+};
+
+// Output in 0..1 to an RPM within min_rpm..max_rpm, in kPidRpmStep steps
+int pid_output_rpm(double output, int min_rpm, int max_rpm);
+
+// Per controller, split by whether it was driving the fans or in shadow
+struct ControllerStats {
+    std::chrono::milliseconds active_time{0};
+    std::chrono::milliseconds shadow_time{0};
+    // Fan writes after the output shaper; in shadow through a shaper of its
+    // own, so driving and shadow counts compare like for like
+    uint64_t writes = 0;        // while driving
+    uint64_t shadow_writes = 0; // would have been, in shadow
+    double peak_overshoot_c = 0.0; // hottest temperature above the PID target while driving
+};
+
+// "<P>_ACTIVE_S:..|<P>_WRITES:..|<P>_WRITES_PER_H:..|<P>_SHADOW_WRITES_PER_H:..|<P>_OVERSHOOT_C:.."
+std::string format_controller_stats(const std::string &prefix, const ControllerStats &stats);
+
+#endif // FAN_CONTROLLER_HPP
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+
+#include "fan_curve.hpp"
+#include "fan_profile_config.hpp"
+
+FanCurve::FanCurve(std::vector<FanCurvePoint> points) : curve_points(std::move(points))
+{
+    if (!curve_points.empty()) {
+        table = build_curve_table(curve_points);
+    }
+}
+
+int FanCurve::rpm_at(double temp_c) const
+{
+    double offset = std::round((temp_c - kCurveMinTemp) * kCurveStepsPerDegree);
+    if (!(offset > 0)) { // also NaN
+        return table.front();
+    }
+    if (offset >= static_cast<double>(table.size() - 1)) {
+        return table.back();
+    }
+    return table[static_cast<size_t>(offset)];
+}
+
+bool sort_curve_points(std::vector<FanCurvePoint> &points)
+{
+    std::vector<FanCurvePoint> sorted = points;
+    std::sort(sorted.begin(), sorted.end());
+    auto duplicate = std::adjacent_find(sorted.begin(), sorted.end(),
+                                        [](const FanCurvePoint &a, const FanCurvePoint &b) { return a.first == b.first; });
+    if (duplicate != sorted.end()) {
+        return false;
+    }
+    points = std::move(sorted);
+    return true;
+}
+
+std::string check_curve_point(const FanCurvePoint &point, int max_rpm)
+{
+    int temp = point.first;
+    int rpm = point.second;
+
+    // Validate temperature range (30-100°C)
+    if (temp < kCurveMinTemp || temp > kCurveMaxTemp) {
+        return "ERROR: Invalid temperature " + std::to_string(temp) + " (valid range: 30-100)";
+    }
+
+    // Validate RPM: 0 (0 RPM mode) or minimum 1500
+    if (rpm != 0 && rpm < MIN_RPM_NONZERO) {
+        return "ERROR: Invalid RPM " + std::to_string(rpm) + " (must be 0 or >= " + std::to_string(MIN_RPM_NONZERO) + ")";
+    }
+    if (rpm > max_rpm) {
+        return "ERROR: Invalid RPM " + std::to_string(rpm) + " (maximum is " + std::to_string(max_rpm) + ")";
+    }
+    return "OK";
+}
+
+std::string parse_curve_points(const std::string &text, int max_rpm, std::vector<FanCurvePoint> &points)
+{
+    std::istringstream iss(text);
+    std::vector<FanCurvePoint> parsed;
+    std::string temp_token, rpm_token;
+    while (iss >> temp_token) {
+        if (!(iss >> rpm_token)) {
+            return "ERROR: Missing RPM after temperature " + temp_token;
+        }
+
+        FanCurvePoint point;
+        try {
+            size_t temp_end = 0, rpm_end = 0;
+            point = {std::stoi(temp_token, &temp_end), std::stoi(rpm_token, &rpm_end)};
+            if (temp_end != temp_token.size() || rpm_end != rpm_token.size()) {
+                throw std::invalid_argument("trailing characters");
+            }
+        } catch (const std::exception &) {
+            return "ERROR: Invalid curve point " + temp_token + " " + rpm_token;
+        }
+
+        auto result = check_curve_point(point, max_rpm);
+        if (result != "OK") {
+            return result;
+        }
+        parsed.push_back(point);
+    }
+
+    if (parsed.empty()) {
+        return "ERROR: No curve points";
+    }
+    if (!sort_curve_points(parsed)) {
+        return "ERROR: Duplicate temperature in curve";
+    }
+    points = std::move(parsed);
+    return "OK";
+}
@@ -0,0 +1,137 @@
+#ifndef FAN_CURVE_HPP
+#define FAN_CURVE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Range and resolution of a compiled curve; temperatures outside the range
+// get the value at its edge
+static constexpr int kCurveMinTemp = 30;
+static constexpr int kCurveMaxTemp = 100;
+static constexpr int kCurveStepsPerDegree = 10;
+static constexpr size_t kCurveTableSize = (kCurveMaxTemp - kCurveMinTemp) * kCurveStepsPerDegree + 1;
+
+// {temperature_celsius, rpm}, same layout as fan_profile_config.hpp
+using FanCurvePoint = std::pair<int, int>;
+
+// RPM per 0.1 °C step; entry i is for kCurveMinTemp + i / 10 °C
+using FanCurveTable = std::array<uint16_t, kCurveTableSize>;
+
+// RPM at a temperature in tenths of a degree, in integer arithmetic so the
+// same code runs at compile time. Points must be sorted and non-empty.
+// Between points the RPM is interpolated linearly (truncated); a segment
+// that starts or ends at 0 RPM is a step instead (holds the lower point's
+// RPM up to the next point), so 0 RPM mode never produces a speed below the
+// fan's minimum.
+constexpr int curve_rpm_at_decidegree(std::span<const FanCurvePoint> points, int decidegree)
+{
+    if (decidegree <= points.front().first * kCurveStepsPerDegree) {
+        return points.front().second;
+    }
+    for (size_t i = 0; i + 1 < points.size(); ++i) {
+        const int low_temp = points[i].first * kCurveStepsPerDegree;
+        const int high_temp = points[i + 1].first * kCurveStepsPerDegree;
+        if (decidegree > high_temp) {
+            continue;
+        }
+        const int low_rpm = points[i].second;
+        const int high_rpm = points[i + 1].second;
+        if (low_rpm == 0 || high_rpm == 0) {
+            return decidegree < high_temp ? low_rpm : high_rpm;
+        }
+        return low_rpm + (high_rpm - low_rpm) * (decidegree - low_temp) / (high_temp - low_temp);
+    }
+    return points.back().second;
+}
+
+constexpr FanCurveTable build_curve_table(std::span<const FanCurvePoint> points)
+{
+    FanCurveTable table = {};
+    for (size_t i = 0; i < table.size(); ++i) {
+        int decidegree = kCurveMinTemp * kCurveStepsPerDegree + static_cast<int>(i);
+        table[i] = static_cast<uint16_t>(curve_rpm_at_decidegree(points, decidegree));
+    }
+    return table;
+}
+
+// Table for a built-in curve, built by the compiler
+template <size_t N>
+consteval FanCurveTable compile_curve_table(const std::array<FanCurvePoint, N> &points)
+{
+    return build_curve_table(std::span<const FanCurvePoint>(points.data(), N));
+}
+
+// Checks for static_assert on the built-in curves
+template <size_t N>
+consteval bool curve_temps_increasing(const std::array<FanCurvePoint, N> &points)
+{
+    for (size_t i = 0; i + 1 < N; ++i) {
+        if (points[i].first >= points[i + 1].first) {
+            return false;
+        }
+    }
+    return N > 0;
+}
+
+template <size_t N>
+consteval bool curve_temps_in_range(const std::array<FanCurvePoint, N> &points)
+{
+    for (const auto &point : points) {
+        if (point.first < kCurveMinTemp || point.first > kCurveMaxTemp) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every RPM is 0 (0 RPM mode) or within min_rpm..max_rpm
+template <size_t N>
+consteval bool curve_rpms_in_range(const std::array<FanCurvePoint, N> &points, int min_rpm, int max_rpm)
+{
+    for (const auto &point : points) {
+        if (point.second != 0 && (point.second < min_rpm || point.second > max_rpm)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A temperature -> RPM curve as a lookup table with one entry per 0.1 °C,
+// so evaluating it is a single index
+class FanCurve
+{
+public:
+    FanCurve() = default;
+
+    // points must be sorted by temperature without duplicates
+    explicit FanCurve(std::vector<FanCurvePoint> points);
+    // A table from compile_curve_table()
+    explicit FanCurve(const FanCurveTable &compiled) : table(compiled) {}
+
+    int rpm_at(double temp_c) const;
+    const std::vector<FanCurvePoint> &points() const { return curve_points; }
+
+private:
+    std::vector<FanCurvePoint> curve_points;
+    FanCurveTable table = {};
+};
+
+// Curves for fan 1 and fan 2
+using FanCurvePair = std::array<FanCurve, 2>;
+
+// Sorts points by temperature; false when two points share a temperature
+bool sort_curve_points(std::vector<FanCurvePoint> &points);
+
+// "OK" when the temperature is within kCurveMinTemp..kCurveMaxTemp and the
+// RPM is 0 or MIN_RPM_NONZERO..max_rpm, the error for the client otherwise
+std::string check_curve_point(const FanCurvePoint &point, int max_rpm);
+
+// Parses "temp rpm temp rpm ..." into sorted, checked points
+std::string parse_curve_points(const std::string &text, int max_rpm, std::vector<FanCurvePoint> &points);
+
+#endif // FAN_CURVE_HPP
@@ -5,7 +5,16 @@
 
 // BETTER AUTO Fan Profile Configuration
 // Each profile point: {temperature_celsius, rpm}
-// Temperatures should be in ascending order
+// Temperatures must be in ascending order within 30-100°C, RPMs 0 (0 RPM
+// mode) or between MIN_RPM_NONZERO and the fan's maximum. config_parse.cpp
+// checks this with static_assert, so a bad curve fails the build. These are
+// the defaults; fan1_curve/fan2_curve in /etc/victus-control/backend.conf
+// override them at runtime.
+
+// Fan limits, used when hwmon does not report fanN_max
+static constexpr int MIN_RPM_NONZERO = 1500;  // fans stall below this
+static constexpr int FAN1_MAX_RPM = 5800;
+static constexpr int FAN2_MAX_RPM = 6100;
 
 // Fan 1 Profile (typically CPU fan)
 // Adjust these values before compilation to customize Better Auto behavior
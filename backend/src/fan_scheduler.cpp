@@ -0,0 +1,188 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include "fan_scheduler.hpp"
+
+using SteadyClock = std::chrono::steady_clock;
+
+static constexpr std::chrono::seconds kFanRetryInitial{1};
+static constexpr std::chrono::seconds kFanRetryMax{30};
+static constexpr int kFanWriteMaxAttempts = 6;
+
+struct PendingTarget {
+    bool valid = false;
+    int rpm = 0;
+    SteadyClock::time_point submitted_at;
+    SteadyClock::time_point not_before; // retry backoff
+    int attempts = 0;
+};
+
+static std::mutex scheduler_mutex;
+static std::condition_variable scheduler_cv;
+static FanTargetWriter scheduler_writer;
+static std::array<PendingTarget, 2> pending_targets;
+static SteadyClock::time_point fan1_last_write = SteadyClock::time_point::min();
+static std::chrono::milliseconds fan_apply_gap = kFanApplyGap;
+static FanSchedulerStats scheduler_stats;
+
+// Earliest time fan index may be written, ignoring whether anything is pending.
+// While fan 2 has a target waiting out the gap, fan 1 waits with it: every
+// fan 1 write restarts the gap, so fan 1 targets arriving faster than the
+// gap would otherwise hold fan 2 back forever.
+static SteadyClock::time_point ready_at_locked(size_t index)
+{
+    auto ready = pending_targets[index].not_before;
+    if (fan1_last_write != SteadyClock::time_point::min() && (index == 1 || pending_targets[1].valid)) {
+        ready = std::max(ready, fan1_last_write + fan_apply_gap);
+    }
+    return ready;
+}
+
+static void fan_scheduler_worker()
+{
+    std::unique_lock<std::mutex> lock(scheduler_mutex);
+    while (true) {
+        auto now = SteadyClock::now();
+        int ready_index = -1;
+        auto next_wake = SteadyClock::time_point::max();
+        // Fan 2 goes first once its gap is over; before any fan 1 write
+        // the original order (fan 1, then fan 2 after the gap) holds
+        bool fan2_first = fan1_last_write != SteadyClock::time_point::min();
+        for (size_t n = 0; n < pending_targets.size(); ++n) {
+            size_t i = fan2_first ? pending_targets.size() - 1 - n : n;
+            if (!pending_targets[i].valid) {
+                continue;
+            }
+            auto ready = ready_at_locked(i);
+            if (ready <= now) {
+                ready_index = static_cast<int>(i);
+                break;
+            }
+            next_wake = std::min(next_wake, ready);
+        }
+
+        if (ready_index < 0) {
+            if (next_wake == SteadyClock::time_point::max()) {
+                scheduler_cv.wait(lock);
+            } else {
+                scheduler_cv.wait_until(lock, next_wake);
+            }
+            continue;
+        }
+
+        size_t index = static_cast<size_t>(ready_index);
+        PendingTarget target = pending_targets[index];
+        pending_targets[index].valid = false;
+
+        lock.unlock();
+        auto result = scheduler_writer(index, target.rpm);
+        lock.lock();
+
+        now = SteadyClock::now();
+        if (index == 0) {
+            // Also after a failure: the write may have reached the firmware
+            fan1_last_write = now;
+        }
+
+        if (result == "OK") {
+            auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(now - target.submitted_at);
+            scheduler_stats.applied++;
+            scheduler_stats.last_time_to_apply = latency;
+            scheduler_stats.max_time_to_apply = std::max(scheduler_stats.max_time_to_apply, latency);
+            scheduler_stats.total_time_to_apply += latency;
+            continue;
+        }
+
+        scheduler_stats.failed++;
+        if (pending_targets[index].valid) {
+            continue; // a newer target replaces the failed one anyway
+        }
+        if (++target.attempts >= kFanWriteMaxAttempts) {
+            scheduler_stats.abandoned++;
+            std::cerr << "fan-scheduler: giving up on fan " << index + 1 << " target " << target.rpm << ": " << result << std::endl;
+            continue;
+        }
+
+        auto backoff = std::min<std::chrono::seconds>(kFanRetryInitial * (1 << (target.attempts - 1)), kFanRetryMax);
+        std::cerr << "fan-scheduler: fan " << index + 1 << " write failed (" << result << "), retrying in "
+                  << backoff.count() << " s" << std::endl;
+        target.not_before = now + backoff;
+        pending_targets[index] = target;
+    }
+}
+
+void start_fan_scheduler(FanTargetWriter writer)
+{
+    static std::once_flag scheduler_once;
+    std::call_once(scheduler_once, [&writer]() {
+        scheduler_writer = std::move(writer);
+        std::thread(fan_scheduler_worker).detach();
+    });
+}
+
+void submit_fan_target(size_t index, int rpm)
+{
+    if (index >= pending_targets.size()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        PendingTarget &target = pending_targets[index];
+        if (target.valid) {
+            scheduler_stats.dropped++;
+        }
+        target.valid = true;
+        target.rpm = rpm;
+        target.submitted_at = SteadyClock::now();
+        target.not_before = SteadyClock::time_point::min();
+        target.attempts = 0;
+        scheduler_stats.submitted++;
+    }
+    scheduler_cv.notify_all();
+}
+
+void set_fan_apply_gap(std::chrono::milliseconds gap)
+{
+    {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        fan_apply_gap = gap;
+    }
+    // A waiting fan 2 target may be due now
+    scheduler_cv.notify_all();
+}
+
+FanSchedulerStats fan_scheduler_stats()
+{
+    std::lock_guard<std::mutex> lock(scheduler_mutex);
+    FanSchedulerStats stats = scheduler_stats;
+    for (size_t i = 0; i < pending_targets.size(); ++i) {
+        stats.pending[i] = pending_targets[i].valid;
+        stats.pending_rpm[i] = pending_targets[i].rpm;
+    }
+    return stats;
+}
+
+std::string format_fan_scheduler_stats()
+{
+    auto stats = fan_scheduler_stats();
+    auto pending = [&stats](size_t index) {
+        return stats.pending[index] ? std::to_string(stats.pending_rpm[index]) : std::string("-");
+    };
+    long long avg_ms = stats.applied ? stats.total_time_to_apply.count() / static_cast<long long>(stats.applied) : 0;
+
+    return "DEPTH:" + std::to_string(stats.pending[0] + stats.pending[1]) +
+           "|FAN1:" + pending(0) +
+           "|FAN2:" + pending(1) +
+           "|SUBMITTED:" + std::to_string(stats.submitted) +
+           "|APPLIED:" + std::to_string(stats.applied) +
+           "|DROPPED:" + std::to_string(stats.dropped) +
+           "|FAILED:" + std::to_string(stats.failed) +
+           "|ABANDONED:" + std::to_string(stats.abandoned) +
+           "|TTA_LAST_MS:" + std::to_string(stats.last_time_to_apply.count()) +
+           "|TTA_AVG_MS:" + std::to_string(avg_ms) +
+           "|TTA_MAX_MS:" + std::to_string(stats.max_time_to_apply.count());
+}
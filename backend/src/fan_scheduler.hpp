@@ -0,0 +1,49 @@
+#ifndef FAN_SCHEDULER_HPP
+#define FAN_SCHEDULER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// The firmware ignores a fan 2 target written too soon after fan 1. Default
+// for set_fan_apply_gap().
+static constexpr std::chrono::seconds kFanApplyGap{10};
+
+// Performs one hardware write; returns "OK" or an error string
+using FanTargetWriter = std::function<std::string(size_t index, int rpm)>;
+
+struct FanSchedulerStats {
+    std::array<bool, 2> pending = {false, false};
+    std::array<int, 2> pending_rpm = {0, 0};
+    uint64_t submitted = 0;
+    uint64_t applied = 0;
+    uint64_t dropped = 0;   // superseded before they were written
+    uint64_t failed = 0;    // writes that returned an error
+    uint64_t abandoned = 0; // gave up after repeated failures
+    // Submit-to-write latency of applied targets
+    std::chrono::milliseconds last_time_to_apply{0};
+    std::chrono::milliseconds max_time_to_apply{0};
+    std::chrono::milliseconds total_time_to_apply{0};
+};
+
+// Starts the writer thread. Each fan has one pending target; a newer submit
+// replaces it (latest wins). Fan 2 is written no sooner than the apply gap
+// after fan 1; a fan 1 target waits while fan 2 is due, so neither fan is
+// starved. Failed writes are retried with exponential backoff a few times.
+void start_fan_scheduler(FanTargetWriter writer);
+
+// Queues a target and returns immediately
+void submit_fan_target(size_t index, int rpm);
+
+// Minimum time between a fan 1 write and the next fan 2 write
+void set_fan_apply_gap(std::chrono::milliseconds gap);
+
+FanSchedulerStats fan_scheduler_stats();
+
+// "DEPTH:1|FAN1:-|FAN2:3200|SUBMITTED:..|APPLIED:..|DROPPED:..|..."
+std::string format_fan_scheduler_stats();
+
+#endif // FAN_SCHEDULER_HPP
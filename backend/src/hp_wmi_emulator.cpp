@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <optional>
+#include <fcntl.h>
+#include <sstream>
+#include <unistd.h>
+
+#include "hp_wmi_emulator.hpp"
+
+static constexpr size_t kPwmFile = 0;
+static constexpr double kThermalTimeConstantS = 20.0;
+static constexpr int kEmulatedCpus = 8;
+// Longest step the model integrates; a stalled emulator does not jump
+static constexpr double kMaxStepS = 5.0;
+
+static bool make_directories(const std::string &path)
+{
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) < 0 && errno != EEXIST) {
+            return false;
+        }
+        if (slash == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+static std::string read_file(const std::string &path)
+{
+    char buffer[256];
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return "";
+    }
+    ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+    close(fd);
+    return length > 0 ? std::string(buffer, static_cast<size_t>(length)) : "";
+}
+
+// Leading integer after optional whitespace, as the driver would parse it
+static std::optional<long long> parse_integer(const std::string &text)
+{
+    const char *start = text.c_str();
+    char *end = nullptr;
+    errno = 0;
+    long long value = std::strtoll(start, &end, 10);
+    if (end == start || errno != 0) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+static bool same_time(const struct timespec &a, const struct timespec &b)
+{
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+static double seconds_between(const struct timespec &earlier, const struct timespec &later)
+{
+    return static_cast<double>(later.tv_sec - earlier.tv_sec) + static_cast<double>(later.tv_nsec - earlier.tv_nsec) / 1e9;
+}
+
+// Sensor values are padded to a fixed width so a file never shrinks under
+// a reader that keeps it open
+static std::string padded(long long value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%-10lld\n", value);
+    return buffer;
+}
+
+void ThermalModel::advance(double dt_s, double ambient_c, double cpu_load_pct, double gpu_load_pct, double airflow)
+{
+    double blend = dt_s > 0.0 ? 1.0 - std::exp(-dt_s / kThermalTimeConstantS) : 0.0;
+    double cpu_steady = ambient_c + (12.0 + 0.75 * cpu_load_pct) * (1.0 - 0.5 * airflow);
+    double gpu_steady = ambient_c + (8.0 + 0.6 * gpu_load_pct) * (1.0 - 0.5 * airflow);
+    cpu_c = std::min(cpu_c + (cpu_steady - cpu_c) * blend, 105.0);
+    gpu_c = std::min(gpu_c + (gpu_steady - gpu_c) * blend, 105.0);
+}
+
+HpWmiEmulator::HpWmiEmulator(std::string root_path, EmulatorOptions emulator_options)
+    : root(std::move(root_path)), options(emulator_options)
+{
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    thermal.cpu_c = options.ambient_c + 10.0;
+    thermal.gpu_c = options.ambient_c + 5.0;
+    cpu_load = options.cpu_load_pct;
+    gpu_load = options.gpu_load_pct;
+    std::string hwmon = hwmon_path();
+    control_paths = {hwmon + "/pwm1_enable", hwmon + "/fan1_target", hwmon + "/fan2_target"};
+}
+
+// In place, so descriptors the backend holds stay valid
+bool HpWmiEmulator::write_file(const std::string &path, const std::string &contents)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = pwrite(fd, contents.data(), contents.size(), 0) == static_cast<ssize_t>(contents.size()) &&
+              ftruncate(fd, static_cast<off_t>(contents.size())) == 0;
+    close(fd);
+
+    for (size_t i = 0; i < control_paths.size(); ++i) {
+        struct stat st;
+        if (path == control_paths[i] && stat(path.c_str(), &st) == 0) {
+            seen_mtime[i] = st.st_mtim; // our own write is not a backend write
+        }
+    }
+    return ok;
+}
+
+bool HpWmiEmulator::changed(size_t file, struct timespec &mtime)
+{
+    struct stat st;
+    if (stat(control_paths[file].c_str(), &st) < 0 || same_time(st.st_mtim, seen_mtime[file])) {
+        return false;
+    }
+    seen_mtime[file] = st.st_mtim;
+    mtime = st.st_mtim;
+    return true;
+}
+
+std::string HpWmiEmulator::create()
+{
+    std::string hwmon = hwmon_path();
+    const std::string dirs[] = {
+        hwmon,
+        root + "/sys/class/hwmon/hwmon0",
+        root + "/sys/class/hwmon/hwmon1",
+        root + "/sys/class/thermal/thermal_zone0",
+        root + "/sys/class/drm/card0/device",
+        root + "/proc",
+        root + "/emulator",
+    };
+    for (const auto &dir : dirs) {
+        if (!make_directories(dir)) {
+            return "ERROR: Unable to create " + dir + ": " + strerror(errno);
+        }
+    }
+
+    bool ok = write_file(hwmon + "/name", "hp\n") &&
+              write_file(hwmon + "/fan1_max", std::to_string(options.max_rpm[0]) + "\n") &&
+              write_file(hwmon + "/fan2_max", std::to_string(options.max_rpm[1]) + "\n") &&
+              write_file(root + "/sys/class/hwmon/hwmon0/name", "coretemp\n") &&
+              write_file(root + "/sys/class/hwmon/hwmon0/temp1_label", "Package id 0\n") &&
+              write_file(root + "/sys/class/hwmon/hwmon1/name", "amdgpu\n") &&
+              write_file(root + "/sys/class/hwmon/hwmon1/temp1_label", "edge\n") &&
+              write_file(root + "/sys/class/thermal/thermal_zone0/type", "x86_pkg_temp\n") &&
+              write_file(control_paths[kPwmFile], "2\n") &&
+              write_file(control_paths[1], "") &&
+              write_file(control_paths[2], "") &&
+              write_file(root + "/emulator/cpu_load", padded(std::lround(cpu_load))) &&
+              write_file(root + "/emulator/gpu_load", padded(std::lround(gpu_load)));
+    if (!ok) {
+        return "ERROR: Unable to write the emulated tree under " + root + ": " + strerror(errno);
+    }
+    publish();
+    return "OK";
+}
+
+void HpWmiEmulator::take_writes(std::chrono::steady_clock::time_point now)
+{
+    struct timespec mtime;
+    if (changed(kPwmFile, mtime)) {
+        auto value = parse_integer(read_file(control_paths[kPwmFile]));
+        if (value && *value >= 0 && *value <= 2) {
+            mode = static_cast<int>(*value);
+            mode_written = now;
+            ++emulator_stats.mode_writes;
+        }
+        write_file(control_paths[kPwmFile], std::to_string(mode) + "\n");
+    }
+
+    for (size_t fan = 0; fan < 2; ++fan) {
+        if (!changed(fan + 1, mtime)) {
+            continue;
+        }
+        auto value = parse_integer(read_file(control_paths[fan + 1]));
+        write_file(control_paths[fan + 1], "");
+        if (!value) {
+            continue;
+        }
+
+        if (fan == 1 && (fan1_written.tv_sec != 0 || fan1_written.tv_nsec != 0) &&
+            seconds_between(fan1_written, mtime) * 1000.0 < static_cast<double>(options.fan_gap.count())) {
+            ++emulator_stats.dropped_writes;
+            continue;
+        }
+        if (fan == 0) {
+            fan1_written = mtime;
+        }
+        target[fan] = static_cast<int>(std::clamp<long long>(*value, 0, options.max_rpm[fan]));
+        target_changed[fan] = now;
+        ++emulator_stats.target_writes;
+        ++emulator_stats.fan_writes[fan];
+    }
+}
+
+void HpWmiEmulator::advance(std::chrono::steady_clock::time_point now)
+{
+    double dt = stepped ? std::min(std::chrono::duration<double>(now - last_step).count(), kMaxStepS) : 0.0;
+    last_step = now;
+    stepped = true;
+
+    if (mode != 2 && now - mode_written >= options.manual_timeout) {
+        mode = 2;
+        ++emulator_stats.mode_reverts;
+        write_file(control_paths[kPwmFile], "2\n");
+    }
+
+    if (auto load = parse_integer(read_file(root + "/emulator/cpu_load"))) {
+        cpu_load = std::clamp(static_cast<double>(*load), 0.0, 100.0);
+    }
+    if (auto load = parse_integer(read_file(root + "/emulator/gpu_load"))) {
+        gpu_load = std::clamp(static_cast<double>(*load), 0.0, 100.0);
+    }
+
+    double hottest = std::max(thermal.cpu_c, thermal.gpu_c);
+    double airflow = 0.0;
+    for (size_t fan = 0; fan < 2; ++fan) {
+        double goal = input[fan];
+        if (mode == 0) {
+            goal = options.max_rpm[fan];
+        } else if (mode == 1) {
+            if (now - target_changed[fan] >= options.input_delay) {
+                goal = target[fan];
+            }
+        } else {
+            // The firmware's own curve
+            goal = hottest < 45.0 ? 0.0 : std::clamp(1500.0 + (hottest - 45.0) * 110.0, 1500.0,
+                                                      static_cast<double>(options.max_rpm[fan]));
+        }
+        double step = options.rpm_slew_per_s * dt;
+        input[fan] = std::clamp(goal, input[fan] - step, input[fan] + step);
+        airflow += input[fan] / options.max_rpm[fan] / 2.0;
+    }
+
+    thermal.advance(dt, options.ambient_c, cpu_load, gpu_load, airflow);
+
+    double ticks = dt * 100.0 * kEmulatedCpus;
+    jiffies[0] += static_cast<unsigned long long>(ticks * cpu_load / 100.0);
+    jiffies[1] += static_cast<unsigned long long>(ticks * (100.0 - cpu_load) / 100.0);
+}
+
+void HpWmiEmulator::publish()
+{
+    std::string hwmon = hwmon_path();
+    long long cpu_milli = std::lround(thermal.cpu_c * 1000.0);
+    write_file(root + "/sys/class/hwmon/hwmon0/temp1_input", padded(cpu_milli));
+    write_file(root + "/sys/class/thermal/thermal_zone0/temp", padded(cpu_milli));
+    write_file(root + "/sys/class/hwmon/hwmon1/temp1_input", padded(std::lround(thermal.gpu_c * 1000.0)));
+    write_file(root + "/sys/class/drm/card0/device/gpu_busy_percent", padded(std::lround(gpu_load)));
+    write_file(hwmon + "/fan1_input", padded(std::lround(input[0])));
+    write_file(hwmon + "/fan2_input", padded(std::lround(input[1])));
+
+    // user nice system idle iowait irq softirq steal; only grows
+    char stat_line[160];
+    std::snprintf(stat_line, sizeof(stat_line), "cpu  %llu 0 0 %llu 0 0 0 0 0 0\n", jiffies[0], jiffies[1]);
+    write_file(root + "/proc/stat", stat_line);
+
+    write_file(root + "/emulator/stats", format_stats() + "\n");
+}
+
+void HpWmiEmulator::step(std::chrono::steady_clock::time_point now)
+{
+    take_writes(now);
+    advance(now);
+    publish();
+}
+
+std::string HpWmiEmulator::format_stats() const
+{
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(1);
+    out << "MODE:" << mode
+        << "|FAN1:" << std::lround(input[0])
+        << "|FAN2:" << std::lround(input[1])
+        << "|FAN1_TARGET:" << target[0]
+        << "|FAN2_TARGET:" << target[1]
+        << "|CPU_C:" << thermal.cpu_c
+        << "|GPU_C:" << thermal.gpu_c
+        << "|CPU_LOAD:" << cpu_load
+        << "|GPU_LOAD:" << gpu_load
+        << "|MODE_WRITES:" << emulator_stats.mode_writes
+        << "|MODE_REVERTS:" << emulator_stats.mode_reverts
+        << "|TARGET_WRITES:" << emulator_stats.target_writes
+        << "|FAN1_WRITES:" << emulator_stats.fan_writes[0]
+        << "|FAN2_WRITES:" << emulator_stats.fan_writes[1]
+        << "|DROPPED_WRITES:" << emulator_stats.dropped_writes;
+    return out.str();
+}
@@ -0,0 +1,97 @@
+#ifndef HP_WMI_EMULATOR_HPP
+#define HP_WMI_EMULATOR_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <sys/stat.h>
+
+// Firmware behaviour the backend works around, and a crude thermal model so
+// the fans have something to react to
+struct EmulatorOptions {
+    std::chrono::seconds manual_timeout{120}; // pwm1_enable falls back to auto (2) this long after a write
+    std::chrono::milliseconds fan_gap{10000};  // fan2_target written sooner than this after fan1_target is ignored
+    std::chrono::milliseconds input_delay{1500}; // before fan*_input starts following a new target
+    double rpm_slew_per_s = 800.0;              // how fast fan*_input then moves
+    std::array<int, 2> max_rpm = {5800, 6100};
+    double ambient_c = 35.0;
+    double cpu_load_pct = 10.0; // initial; <root>/emulator/cpu_load changes it at runtime
+    double gpu_load_pct = 5.0;
+};
+
+// The heat model behind the emulated temperatures, also the plant
+// victus-replay closes its loop with. Each part heads for a steady state set
+// by its load (percent) and the airflow (0: fans stopped, 1: both at their
+// maximum) with a 20 s time constant.
+struct ThermalModel {
+    double cpu_c = 0.0;
+    double gpu_c = 0.0;
+
+    void advance(double dt_s, double ambient_c, double cpu_load_pct, double gpu_load_pct, double airflow);
+};
+
+struct EmulatorStats {
+    uint64_t mode_writes = 0;
+    uint64_t mode_reverts = 0;    // manual -> auto on manual_timeout
+    uint64_t target_writes = 0;   // accepted fan*_target writes
+    uint64_t dropped_writes = 0;  // fan2 writes inside fan_gap
+    std::array<uint64_t, 2> fan_writes = {0, 0};
+};
+
+// Builds a fake hp-wmi machine under root (the backend's VICTUS_FS_ROOT):
+//   sys/devices/platform/hp-wmi/hwmon/hwmon3/{pwm1_enable,fan[12]_{target,input,max}}
+//   sys/class/hwmon/hwmon{0,1} (coretemp, amdgpu), sys/class/thermal/thermal_zone0
+//   sys/class/drm/card0/device/gpu_busy_percent, proc/stat
+//   emulator/{cpu_load,gpu_load} (inputs), emulator/stats (KEY:value output)
+// Writes are noticed by their mtime on the next step(). pwrite() into a
+// regular file does not truncate, so fan*_target is emptied once a write is
+// taken and reads back empty; pwm1_enable holds the current mode.
+class HpWmiEmulator
+{
+public:
+    explicit HpWmiEmulator(std::string root_path, EmulatorOptions emulator_options = {});
+
+    // Creates the tree (directories may exist); "OK" or an error
+    std::string create();
+
+    // Takes the writes since the last step and advances the model to now
+    void step(std::chrono::steady_clock::time_point now);
+
+    const EmulatorStats &stats() const { return emulator_stats; }
+    std::string hwmon_path() const { return root + "/sys/devices/platform/hp-wmi/hwmon/hwmon3"; }
+    const std::string &root_path() const { return root; }
+
+    // "MODE:..|FAN1:..|FAN2:..|FAN1_TARGET:..|CPU_C:..|...|DROPPED_WRITES:.."
+    std::string format_stats() const;
+
+private:
+    bool write_file(const std::string &path, const std::string &contents);
+    bool changed(size_t file, struct timespec &mtime);
+    void take_writes(std::chrono::steady_clock::time_point now);
+    void advance(std::chrono::steady_clock::time_point now);
+    void publish();
+
+    std::string root;
+    EmulatorOptions options;
+    EmulatorStats emulator_stats;
+
+    // pwm1_enable, fan1_target, fan2_target
+    std::array<std::string, 3> control_paths;
+    std::array<struct timespec, 3> seen_mtime = {};
+
+    int mode = 2; // 0 max, 1 manual, 2 auto
+    std::chrono::steady_clock::time_point mode_written;
+    std::array<int, 2> target = {0, 0};
+    std::array<double, 2> input = {0.0, 0.0};
+    std::array<std::chrono::steady_clock::time_point, 2> target_changed;
+    struct timespec fan1_written = {};
+    ThermalModel thermal;
+    double cpu_load;
+    double gpu_load;
+    std::array<unsigned long long, 2> jiffies = {0, 0}; // busy, idle
+    std::chrono::steady_clock::time_point last_step;
+    bool stepped = false;
+};
+
+#endif // HP_WMI_EMULATOR_HPP
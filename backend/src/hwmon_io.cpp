@@ -0,0 +1,301 @@
+#include <iostream>
+#include <string>
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "hwmon_io.hpp"
+#include "fan_broker.hpp"
+#include "util.hpp"
+#include "metrics.hpp"
+
+extern char **environ;
+
+// Re-assert manual mode before a target write when our last pwm1_enable
+// write is older than this; the firmware drops back to auto on its own.
+static constexpr std::chrono::seconds kManualAssertWindow{30};
+static constexpr int kBrokerTimeoutMs = 5000;
+// Don't respawn a broker that just failed (e.g. not installed) on every write
+static constexpr std::chrono::seconds kBrokerRetryBackoff{60};
+
+struct HwmonFds {
+    std::string hwmon_path;
+    unsigned long generation = 0;
+    std::array<int, kBrokerFdCount> fds = {-1, -1, -1};
+    std::string last_pwm_value;
+    std::chrono::steady_clock::time_point last_pwm_write = std::chrono::steady_clock::time_point::min();
+};
+
+static std::mutex hwmon_io_mutex;
+static HwmonFds hwmon_fds;
+static std::chrono::steady_clock::time_point broker_failed_at = std::chrono::steady_clock::time_point::min();
+
+static void close_fds_locked()
+{
+    for (int &fd : hwmon_fds.fds) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    hwmon_fds.hwmon_path.clear();
+    hwmon_fds.last_pwm_value.clear();
+    hwmon_fds.last_pwm_write = std::chrono::steady_clock::time_point::min();
+}
+
+static bool fds_open_locked()
+{
+    for (int fd : hwmon_fds.fds) {
+        if (fd < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns 0 on success, otherwise the errno of the first failed open
+static int open_direct_locked(const std::string &hwmon_path)
+{
+    const std::array<std::string, kBrokerFdCount> names = {"pwm1_enable", "fan1_target", "fan2_target"};
+    for (size_t i = 0; i < names.size(); ++i) {
+        std::string path = hwmon_path + "/" + names[i];
+        int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            int open_errno = errno;
+            close_fds_locked();
+            return open_errno;
+        }
+        hwmon_fds.fds[i] = fd;
+    }
+    hwmon_fds.hwmon_path = hwmon_path;
+    return 0;
+}
+
+static std::string open_via_broker_locked()
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+        std::cerr << "fan-broker: socketpair failed: " << strerror(errno) << std::endl;
+        return "ERROR: Unable to start fan broker";
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], STDIN_FILENO);
+
+    char *const argv[] = {const_cast<char *>("sudo"), const_cast<char *>("-n"),
+                          const_cast<char *>(FAN_BROKER_PATH), nullptr};
+    pid_t pid = -1;
+    int spawn_result = posix_spawn(&pid, "/usr/bin/sudo", &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(sv[1]);
+
+    if (spawn_result != 0) {
+        close(sv[0]);
+        std::cerr << "fan-broker: failed to spawn sudo: " << strerror(spawn_result) << std::endl;
+        return "ERROR: Unable to start fan broker";
+    }
+
+    FanBrokerReply reply;
+    std::memset(&reply, 0, sizeof(reply));
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kBrokerFdCount)];
+    struct iovec iov = {&reply, sizeof(reply)};
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received = -1;
+    struct pollfd pfd = {sv[0], POLLIN, 0};
+    if (poll(&pfd, 1, kBrokerTimeoutMs) > 0) {
+        received = recvmsg(sv[0], &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    }
+    close(sv[0]);
+
+    int status = 0;
+    if (received < 0) {
+        kill(pid, SIGTERM);
+    }
+    waitpid(pid, &status, 0);
+
+    std::array<int, kBrokerFdCount> fds = {-1, -1, -1};
+    size_t fd_count = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); received > 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            fd_count = std::min<size_t>(fd_count, kBrokerFdCount);
+            std::memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * fd_count);
+        }
+    }
+
+    bool valid = received == static_cast<ssize_t>(sizeof(reply)) && reply.magic == kFanBrokerMagic &&
+                 reply.fd_count == kBrokerFdCount && fd_count == kBrokerFdCount;
+    if (!valid) {
+        for (size_t i = 0; i < fd_count; ++i) {
+            close(fds[i]);
+        }
+        if (received == static_cast<ssize_t>(sizeof(reply)) && reply.error[0] != '\0') {
+            reply.error[sizeof(reply.error) - 1] = '\0';
+            std::cerr << "fan-broker: " << reply.error << std::endl;
+        } else if (WIFEXITED(status)) {
+            std::cerr << "fan-broker: helper exited with code " << WEXITSTATUS(status) << " without descriptors" << std::endl;
+        } else {
+            std::cerr << "fan-broker: helper terminated abnormally" << std::endl;
+        }
+        return "ERROR: Fan broker did not provide descriptors";
+    }
+
+    reply.hwmon_path[sizeof(reply.hwmon_path) - 1] = '\0';
+    hwmon_fds.fds = fds;
+    hwmon_fds.hwmon_path = reply.hwmon_path;
+    std::cout << "fan-broker: received control descriptors for " << hwmon_fds.hwmon_path << std::endl;
+    return "OK";
+}
+
+static std::string ensure_fds_locked()
+{
+    unsigned long generation = hwmon_generation();
+    if (fds_open_locked()) {
+        if (hwmon_fds.generation == generation) {
+            return "OK";
+        }
+        // The uevent monitor saw the driver change; these fds are dead
+        close_fds_locked();
+    }
+
+    std::string hwmon_path = hwmon_directory();
+    if (hwmon_path.empty()) {
+        return "ERROR: Hwmon directory not found";
+    }
+
+    int open_errno = open_direct_locked(hwmon_path);
+    if (open_errno == 0) {
+        hwmon_fds.generation = generation;
+        return "OK";
+    }
+    if (open_errno == ENOENT) {
+        invalidate_hwmon_directory();
+    }
+    if (open_errno != EACCES && open_errno != EPERM) {
+        std::cerr << "Failed to open hp-wmi control files in " << hwmon_path << ": " << strerror(open_errno) << std::endl;
+        return "ERROR: Unable to open fan control files";
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (broker_failed_at != std::chrono::steady_clock::time_point::min() && now - broker_failed_at < kBrokerRetryBackoff) {
+        return "ERROR: Fan broker unavailable";
+    }
+
+    static LatencyHistogram &broker_latency = metrics_histogram("BROKER_OPEN");
+    std::string result;
+    {
+        ScopedLatency timer(broker_latency);
+        result = open_via_broker_locked();
+    }
+    if (result == "OK") {
+        hwmon_fds.generation = generation;
+    }
+    broker_failed_at = (result == "OK") ? std::chrono::steady_clock::time_point::min() : now;
+    return result;
+}
+
+static bool is_stale_fd_error(int err)
+{
+    return err == ENODEV || err == ENOENT || err == EBADF || err == ENXIO;
+}
+
+// One pwrite() on a cached descriptor; reopens once if the driver went away
+static std::string write_cached_locked(size_t slot, const std::string &value)
+{
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        auto result = ensure_fds_locked();
+        if (result != "OK") {
+            return result;
+        }
+
+        static std::array<LatencyHistogram *, kBrokerFdCount> write_latency = {
+            &metrics_histogram("SYSFS_WRITE_PWM_ENABLE"),
+            &metrics_histogram("SYSFS_WRITE_FAN1_TARGET"),
+            &metrics_histogram("SYSFS_WRITE_FAN2_TARGET")};
+        static MetricCounter &write_errors = metrics_counter("SYSFS_WRITE_ERRORS");
+
+        ssize_t written;
+        {
+            ScopedLatency timer(*write_latency[slot]);
+            written = pwrite(hwmon_fds.fds[slot], value.data(), value.size(), 0);
+        }
+        if (written == static_cast<ssize_t>(value.size())) {
+            return "OK";
+        }
+        write_errors.add();
+
+        int write_errno = written < 0 ? errno : EIO;
+        if (attempt == 0 && is_stale_fd_error(write_errno)) {
+            std::cerr << "hp-wmi control descriptor went stale (" << strerror(write_errno) << "), reopening" << std::endl;
+            close_fds_locked();
+            invalidate_hwmon_directory();
+            continue;
+        }
+
+        std::cerr << "Failed to write hp-wmi control file: " << strerror(write_errno) << std::endl;
+        return "ERROR: Failed to write fan control file";
+    }
+    return "ERROR: Failed to write fan control file";
+}
+
+static std::string write_pwm_locked(const std::string &encoded)
+{
+    auto result = write_cached_locked(kBrokerPwmEnable, encoded);
+    if (result == "OK") {
+        hwmon_fds.last_pwm_value = encoded;
+        hwmon_fds.last_pwm_write = std::chrono::steady_clock::now();
+    }
+    return result;
+}
+
+std::string hwmon_write_fan_target(size_t index, int rpm)
+{
+    if (index > 1) {
+        return "ERROR: Invalid fan index";
+    }
+
+    std::lock_guard<std::mutex> lock(hwmon_io_mutex);
+
+    auto now = std::chrono::steady_clock::now();
+    bool manual_current = hwmon_fds.last_pwm_value == "1" &&
+                          hwmon_fds.last_pwm_write != std::chrono::steady_clock::time_point::min() &&
+                          now - hwmon_fds.last_pwm_write < kManualAssertWindow;
+    if (!manual_current) {
+        auto result = write_pwm_locked("1");
+        if (result != "OK") {
+            return result;
+        }
+    }
+
+    size_t slot = (index == 0) ? kBrokerFan1Target : kBrokerFan2Target;
+    return write_cached_locked(slot, std::to_string(rpm));
+}
+
+std::string hwmon_write_pwm_enable(const std::string &encoded)
+{
+    std::lock_guard<std::mutex> lock(hwmon_io_mutex);
+    return write_pwm_locked(encoded);
+}
+
+void hwmon_close_fds()
+{
+    std::lock_guard<std::mutex> lock(hwmon_io_mutex);
+    close_fds_locked();
+}
@@ -0,0 +1,21 @@
+#ifndef HWMON_IO_HPP
+#define HWMON_IO_HPP
+
+#include <string>
+#include <cstddef>
+
+// Cached write descriptors for the hp-wmi control files. The files are
+// opened directly when the udev rules grant access, otherwise they are
+// fetched once from victus-fan-broker. Each write is a single pwrite().
+
+// Writes fanN_target (index 0 or 1). Makes sure pwm1_enable is in manual
+// mode first, like set-fan-speed.sh did, but only when it is not already.
+std::string hwmon_write_fan_target(size_t index, int rpm);
+
+// Writes an already encoded pwm1_enable value ("0", "1" or "2").
+std::string hwmon_write_pwm_enable(const std::string &encoded);
+
+// Drops all cached descriptors; the next write reopens them.
+void hwmon_close_fds();
+
+#endif // HWMON_IO_HPP
@@ -0,0 +1,229 @@
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "loop_timer.hpp"
+
+using SteadyClock = std::chrono::steady_clock;
+
+// steady_clock is CLOCK_MONOTONIC on Linux, so its time points can be handed
+// to the timerfd directly
+static struct timespec to_timespec(std::chrono::nanoseconds value)
+{
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(value);
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(seconds.count());
+    ts.tv_nsec = static_cast<long>((value - seconds).count());
+    return ts;
+}
+
+LoopTimer::LoopTimer()
+{
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (timer_fd < 0 || event_fd < 0) {
+        std::cerr << "loop-timer: timerfd/eventfd unavailable, using a condition variable: " << strerror(errno) << std::endl;
+        if (timer_fd >= 0) {
+            close(timer_fd);
+            timer_fd = -1;
+        }
+        if (event_fd >= 0) {
+            close(event_fd);
+            event_fd = -1;
+        }
+    }
+}
+
+LoopTimer::~LoopTimer()
+{
+    if (timer_fd >= 0) {
+        close(timer_fd);
+    }
+    if (event_fd >= 0) {
+        close(event_fd);
+    }
+}
+
+void LoopTimer::arm(std::chrono::nanoseconds new_period, std::chrono::nanoseconds first_delay)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    start = SteadyClock::now() + first_delay;
+    period = new_period;
+    next_index = 0;
+    armed = true;
+    stopped = false;
+    ++generation;
+
+    if (timer_fd >= 0) {
+        struct itimerspec spec;
+        spec.it_value = to_timespec(start.time_since_epoch());
+        spec.it_interval = to_timespec(period);
+        if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+            std::cerr << "loop-timer: timerfd_settime failed: " << strerror(errno) << std::endl;
+        }
+    }
+    cv.notify_all();
+}
+
+void LoopTimer::arm_at(SteadyClock::time_point deadline)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    start = deadline;
+    period = std::chrono::nanoseconds(0);
+    next_index = 0;
+    armed = true;
+    stopped = false;
+    ++generation;
+
+    if (timer_fd >= 0) {
+        // A zero it_value would disarm the timer instead
+        struct itimerspec spec = {};
+        spec.it_value = to_timespec(std::max(start.time_since_epoch(), std::chrono::nanoseconds(1)));
+        if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+            std::cerr << "loop-timer: timerfd_settime failed: " << strerror(errno) << std::endl;
+        }
+    }
+    cv.notify_all();
+}
+
+void LoopTimer::disarm()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    armed = false;
+    ++generation;
+
+    if (timer_fd >= 0) {
+        struct itimerspec spec = {};
+        timerfd_settime(timer_fd, 0, &spec, nullptr);
+    }
+    cv.notify_all();
+}
+
+void LoopTimer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        armed = false;
+        ++generation;
+
+        if (timer_fd >= 0) {
+            struct itimerspec spec = {};
+            timerfd_settime(timer_fd, 0, &spec, nullptr);
+        }
+    }
+    cv.notify_all();
+
+    if (event_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(event_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+bool LoopTimer::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (timer_fd < 0) {
+        return wait_fallback(lock);
+    }
+
+    while (!stopped) {
+        lock.unlock();
+        struct pollfd fds[2] = {{timer_fd, POLLIN, 0}, {event_fd, POLLIN, 0}};
+        int ready = poll(fds, 2, -1);
+        lock.lock();
+
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "loop-timer: poll failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t wakeups;
+            ssize_t ignored = read(event_fd, &wakeups, sizeof(wakeups));
+            (void)ignored;
+        }
+        if (stopped || !(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        // Read under the lock so the count belongs to the grid arm() set up;
+        // EAGAIN when the timer was re-armed after poll() returned
+        uint64_t expirations = 0;
+        if (read(timer_fd, &expirations, sizeof(expirations)) == static_cast<ssize_t>(sizeof(expirations)) &&
+            expirations > 0 && armed) {
+            record_tick_locked(expirations, SteadyClock::now());
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LoopTimer::wait_fallback(std::unique_lock<std::mutex> &lock)
+{
+    while (!stopped) {
+        if (!armed) {
+            cv.wait(lock);
+            continue;
+        }
+
+        auto deadline = start + period * static_cast<int64_t>(next_index);
+        uint64_t armed_generation = generation;
+        if (cv.wait_until(lock, deadline, [&] { return generation != armed_generation; })) {
+            continue;
+        }
+
+        auto now = SteadyClock::now();
+        uint64_t expirations = 1;
+        if (period.count() > 0) {
+            expirations += static_cast<uint64_t>((now - deadline) / period);
+        }
+        record_tick_locked(expirations, now);
+        return true;
+    }
+    return false;
+}
+
+void LoopTimer::record_tick_locked(uint64_t expirations, SteadyClock::time_point now)
+{
+    next_index += expirations;
+    auto deadline = start + period * static_cast<int64_t>(next_index - 1);
+    auto lateness = std::chrono::duration_cast<std::chrono::microseconds>(now - deadline);
+    if (lateness.count() < 0) {
+        lateness = std::chrono::microseconds(0);
+    }
+
+    ++tick_stats.ticks;
+    tick_stats.missed += expirations - 1;
+    tick_stats.last_lateness = lateness;
+    tick_stats.max_lateness = std::max(tick_stats.max_lateness, lateness);
+    tick_stats.total_lateness += lateness;
+
+    if (period.count() == 0) {
+        armed = false; // arm_at() fires once
+    }
+}
+
+LoopTimerStats LoopTimer::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return tick_stats;
+}
+
+std::string format_loop_timer_stats(const std::string &prefix, const LoopTimerStats &stats)
+{
+    long long avg_us = stats.ticks ? stats.total_lateness.count() / static_cast<long long>(stats.ticks) : 0;
+    return prefix + "_TICKS:" + std::to_string(stats.ticks) +
+           "|" + prefix + "_MISSED:" + std::to_string(stats.missed) +
+           "|" + prefix + "_LATE_LAST_US:" + std::to_string(stats.last_lateness.count()) +
+           "|" + prefix + "_LATE_AVG_US:" + std::to_string(avg_us) +
+           "|" + prefix + "_LATE_MAX_US:" + std::to_string(stats.max_lateness.count());
+}
@@ -0,0 +1,70 @@
+#ifndef LOOP_TIMER_HPP
+#define LOOP_TIMER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+struct LoopTimerStats {
+    uint64_t ticks = 0;
+    uint64_t missed = 0; // grid points skipped because the loop overran
+    // How long after its deadline a tick was delivered
+    std::chrono::microseconds last_lateness{0};
+    std::chrono::microseconds max_lateness{0};
+    std::chrono::microseconds total_lateness{0};
+};
+
+// Periodic wakeups on a fixed grid (start, start + period, ...) from an
+// absolute CLOCK_MONOTONIC timerfd, so time spent in the loop body does not
+// shift later ticks. An eventfd interrupts wait() for stop(); re-arming
+// takes effect immediately as well. Falls back to a condition variable when
+// the descriptors cannot be created.
+class LoopTimer
+{
+public:
+    LoopTimer();
+    ~LoopTimer();
+
+    LoopTimer(const LoopTimer &) = delete;
+    LoopTimer &operator=(const LoopTimer &) = delete;
+
+    // Starts a new grid with the first tick after first_delay and clears a
+    // previous stop()
+    void arm(std::chrono::nanoseconds period, std::chrono::nanoseconds first_delay = std::chrono::nanoseconds(0));
+    // A single tick at deadline (right away if it already passed)
+    void arm_at(std::chrono::steady_clock::time_point deadline);
+    // No ticks until the next arm(); wait() keeps blocking
+    void disarm();
+    // Makes wait() return false, now and on later calls until arm()
+    void stop();
+
+    // Blocks until the next tick; false once stopped. When the loop fell
+    // behind, missed grid points are skipped rather than delivered in a burst.
+    bool wait();
+
+    LoopTimerStats stats() const;
+
+private:
+    bool wait_fallback(std::unique_lock<std::mutex> &lock);
+    void record_tick_locked(uint64_t expirations, std::chrono::steady_clock::time_point now);
+
+    int timer_fd = -1;
+    int event_fd = -1;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv; // fallback only
+    bool armed = false;
+    bool stopped = false;
+    uint64_t generation = 0;    // bumped by arm()/disarm()/stop()
+    std::chrono::steady_clock::time_point start;
+    std::chrono::nanoseconds period{0};
+    uint64_t next_index = 0;    // grid points consumed so far
+    LoopTimerStats tick_stats;
+};
+
+// "<PREFIX>_TICKS:..|<PREFIX>_MISSED:..|<PREFIX>_LATE_LAST_US:..|<PREFIX>_LATE_AVG_US:..|<PREFIX>_LATE_MAX_US:.."
+std::string format_loop_timer_stats(const std::string &prefix, const LoopTimerStats &stats);
+
+#endif // LOOP_TIMER_HPP
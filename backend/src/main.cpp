@@ -1,182 +1,33 @@
-#include <atomic>
 #include <iostream>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <string>
-#include <vector>
-#include <cstdint>
-#include <sstream>
-#include <algorithm>
-#include <cctype>
+#include <cstring>
+#include <cerrno>
 
 #include "fan.hpp"
+#include "util.hpp"
+#include "telemetry.hpp"
+#include "server.hpp"
+#include "config.hpp"
+#include "control_trace.hpp"
 
-#define SOCKET_DIR "/run/victus-control"
-#define SOCKET_PATH SOCKET_DIR "/victus_backend.sock"
-
-static std::atomic<int> active_clients{0};
-
-static void on_client_connected()
-{
-    int current = active_clients.fetch_add(1) + 1;
-    std::cout << "Client connected (active: " << current << ")" << std::endl;
-}
-
-static void on_client_disconnected()
-{
-    int previous = active_clients.fetch_sub(1);
-    int current = previous - 1;
-    if (previous <= 0) {
-        active_clients.store(0);
-        current = 0;
-    }
-    std::cout << "Client disconnected (active: " << current << ")" << std::endl;
-
-    if (current == 0) {
-        auto result = ensure_better_auto_mode();
-        if (result != "OK") {
-            std::cerr << "Failed to enforce BETTER_AUTO mode after client disconnect: " << result << std::endl;
-        }
-    }
-}
-
-// Helper function to reliably send a block of data
-bool send_all(int socket, const void *buffer, size_t length) {
-    const char *ptr = static_cast<const char*>(buffer);
-    while (length > 0) {
-        ssize_t bytes_sent = send(socket, ptr, length, 0);
-        if (bytes_sent < 1) {
-            std::cerr << "Failed to send data" << std::endl;
-            return false;
-        }
-        ptr += bytes_sent;
-        length -= bytes_sent;
-    }
-    return true;
-}
-
-// Helper function to reliably read a block of data
-bool read_all(int socket, void *buffer, size_t length) {
-    char *ptr = static_cast<char*>(buffer);
-    while (length > 0) {
-        ssize_t bytes_read = read(socket, ptr, length);
-        if (bytes_read < 1) {
-            // Client disconnected or error
-            return false;
-        }
-        ptr += bytes_read;
-        length -= bytes_read;
-    }
-    return true;
-}
-
-
-static std::string trim(const std::string &input)
-{
-    size_t start = input.find_first_not_of(" \t\r\n");
-    if (start == std::string::npos) {
-        return "";
-    }
-    size_t end = input.find_last_not_of(" \t\r\n");
-    return input.substr(start, end - start + 1);
-}
-
-static std::string normalize_mode(std::string mode)
-{
-    for (char &ch : mode) {
-        if (ch == '-' || ch == ' ') {
-            ch = '_';
-        } else {
-            ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
-        }
-    }
-    return mode;
-}
-
-void handle_command(const std::string &command_str, int client_socket)
+int main()
 {
-    std::stringstream ss(command_str);
-    std::string command;
-    ss >> command;
-
-	std::string response;
+	int server_socket;
+	struct sockaddr_un server_addr;
+	std::string socket_path = run_path(SOCKET_NAME);
 
-	if (command == "GET_FAN_SPEED")
-	{
-        std::string fan_num;
-        ss >> fan_num;
-		response = get_fan_speed(fan_num);
-	}
-	else if (command == "SET_FAN_SPEED")
-	{
-		std::string fan_num;
-        std::string speed;
-        ss >> fan_num >> speed;
-        if (!fan_num.empty() && !speed.empty()) {
-		    response = set_fan_speed(fan_num, speed, true, true); // true = allow triggering fan_mode_trigger
-        } else {
-            response = "ERROR: Invalid SET_FAN_SPEED command format";
-        }
-	}
-	else if (command == "SET_FAN_MODE")
-	{
-		std::string remainder;
-        std::getline(ss, remainder);
-        remainder = trim(remainder);
-        if (remainder.empty()) {
-            response = "ERROR: Invalid SET_FAN_MODE command format";
-        } else {
-            std::string mode = normalize_mode(remainder);
-		    response = set_fan_mode(mode);
-            if (response == "OK") {
-		        fan_mode_trigger(mode);
-            }
-        }
-	}
-	else if (command == "GET_FAN_MODE")
-	{
-		response = get_fan_mode();
-	}
-	else if (command == "GET_CPU_TEMP")
-	{
-		response = get_cpu_temp();
-	}
-	else if (command == "GET_ALL_TEMPS")
+	if (!fs_root().empty())
 	{
-		response = get_all_temps();
+		std::cout << "Using emulated filesystem root " << fs_root() << std::endl;
 	}
-	else if (command == "SET_FAN_PROFILE")
-	{
-		std::string remainder;
-		std::getline(ss, remainder);
-		remainder = trim(remainder);
-		if (remainder.empty()) {
-			response = "ERROR: Invalid SET_FAN_PROFILE command format";
-		} else {
-			response = set_fan_profile(remainder);
-			if (response == "OK") {
-				fan_mode_trigger("PROFILE");
-			}
-		}
-	}
-	else
-		response = "ERROR: Unknown command";
-
-    uint32_t len = response.length();
-    if (!send_all(client_socket, &len, sizeof(len))) return;
-    if (!send_all(client_socket, response.c_str(), len)) return;
-}
-
-int main()
-{
-	int server_socket, client_socket;
-	struct sockaddr_un server_addr;
 
-	unlink(SOCKET_PATH);
+	unlink(socket_path.c_str());
 
-	server_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	server_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
 	if (server_socket < 0)
 	{
 		std::cerr << "Error creating socket: " << strerror(errno) << std::endl;
@@ -185,7 +36,7 @@ int main()
 
 	memset(&server_addr, 0, sizeof(server_addr));
 	server_addr.sun_family = AF_UNIX;
-	strncpy(server_addr.sun_path, SOCKET_PATH, sizeof(server_addr.sun_path) - 1);
+	strncpy(server_addr.sun_path, socket_path.c_str(), sizeof(server_addr.sun_path) - 1);
 
 	if (bind(server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
 	{
@@ -194,14 +45,14 @@ int main()
 		return 1;
 	}
 
-	if (chmod(SOCKET_PATH, 0660) < 0)
+	if (chmod(socket_path.c_str(), 0660) < 0)
 	{
 		std::cerr << "Failed to set socket permissions: " << strerror(errno) << std::endl;
 		close(server_socket);
 		return 1;
 	}
 
-	if (listen(server_socket, 5) < 0)
+	if (listen(server_socket, SOMAXCONN) < 0)
 	{
 		std::cerr << "Listen failed: " << strerror(errno) << std::endl;
 		close(server_socket);
@@ -210,49 +61,25 @@ int main()
 
 	std::cout << "Server is listening..." << std::endl;
 
+	// Before any thread that records into it starts
+	open_control_trace(run_path(CONTROL_TRACE_FILE).c_str());
+	start_config_watcher();
+	apply_backend_config();
+	start_hwmon_uevent_monitor();
+	start_telemetry_sampler();
+
 	auto ensure_result = ensure_better_auto_mode();
 	if (ensure_result != "OK")
 	{
 		std::cerr << "Failed to enforce initial BETTER_AUTO mode: " << ensure_result << std::endl;
 	}
 
-	while (true)
-	{
-		client_socket = accept(server_socket, nullptr, nullptr);
-		if (client_socket < 0)
-		{
-			perror("accept");
-			continue;
-		}
-
-		on_client_connected();
-
-		while (true)
-		{
-            uint32_t cmd_len;
-            if (!read_all(client_socket, &cmd_len, sizeof(cmd_len))) {
-                std::cerr << "Client disconnected or error occurred while reading command length.\n";
-                break;
-            }
-
-            if (cmd_len > 1024) { // Basic sanity check
-                std::cerr << "Command too long. Closing connection.\n";
-                break;
-            }
-
-            std::vector<char> buffer(cmd_len);
-            if (!read_all(client_socket, buffer.data(), cmd_len)) {
-                std::cerr << "Client disconnected or error occurred while reading command.\n";
-                break;
-            }
-
-			handle_command(std::string(buffer.begin(), buffer.end()), client_socket);
-		}
-
-		close(client_socket);
-		on_client_disconnected();
-	}
-
+	int result = run_server(server_socket);
 	close(server_socket);
-	return 0;
+
+	// The scheduler and worker threads never exit; running static destructors
+	// under them can block (condition variables they wait on), so leave
+	// without them and let systemd restart the service
+	std::cout.flush();
+	_exit(result);
 }
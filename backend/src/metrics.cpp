@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "metrics.hpp"
+
+static constexpr uint64_t kSubBuckets = uint64_t(1) << LatencyHistogram::kSubBucketBits;
+
+// Values below 2 * kSubBuckets get a bucket each; above, the top
+// kSubBucketBits + 1 bits select the bucket
+static size_t bucket_index(uint64_t value)
+{
+    value = std::min(value, (uint64_t(1) << LatencyHistogram::kMaxValueBits) - 1);
+    int msb = 63 - std::countl_zero(value | 1);
+    if (msb <= LatencyHistogram::kSubBucketBits) {
+        return static_cast<size_t>(value);
+    }
+    int shift = msb - LatencyHistogram::kSubBucketBits;
+    return static_cast<size_t>((static_cast<uint64_t>(shift) + 1) * kSubBuckets + ((value >> shift) - kSubBuckets));
+}
+
+static uint64_t bucket_upper_bound(size_t index)
+{
+    if (index < 2 * kSubBuckets) {
+        return index;
+    }
+    int shift = static_cast<int>(index / kSubBuckets) - 1;
+    uint64_t sub = index % kSubBuckets + kSubBuckets;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency)
+{
+    uint64_t value = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0;
+    buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    total_count.fetch_add(1, std::memory_order_relaxed);
+    sum_ns.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t previous = max_ns.load(std::memory_order_relaxed);
+    while (value > previous && !max_ns.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total_count.store(0, std::memory_order_relaxed);
+    max_ns.store(0, std::memory_order_relaxed);
+    sum_ns.store(0, std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double fraction) const
+{
+    uint64_t total = count();
+    if (total == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+
+    uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(total))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= wanted) {
+            return std::min(std::chrono::nanoseconds(bucket_upper_bound(i)), max());
+        }
+    }
+    return max();
+}
+
+struct MetricsRegistry {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<MetricCounter>> counters;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+    std::chrono::steady_clock::time_point reset_at = std::chrono::steady_clock::now();
+};
+
+static MetricsRegistry &registry()
+{
+    // Leaked on purpose: threads keep recording until the process exits
+    static MetricsRegistry *instance = new MetricsRegistry();
+    return *instance;
+}
+
+MetricCounter &metrics_counter(const std::string &name)
+{
+    MetricsRegistry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    auto &slot = metrics.counters[name];
+    if (!slot) {
+        slot = std::make_unique<MetricCounter>();
+    }
+    return *slot;
+}
+
+LatencyHistogram &metrics_histogram(const std::string &name)
+{
+    MetricsRegistry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    auto &slot = metrics.histograms[name];
+    if (!slot) {
+        slot = std::make_unique<LatencyHistogram>();
+    }
+    return *slot;
+}
+
+std::string format_metrics()
+{
+    MetricsRegistry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+
+    auto us = [](std::chrono::nanoseconds value) {
+        return std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(value).count());
+    };
+    auto since_reset = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - metrics.reset_at);
+
+    std::string result = "SINCE_RESET_S:" + std::to_string(since_reset.count());
+    for (const auto &entry : metrics.counters) {
+        result += "|" + entry.first + ":" + std::to_string(entry.second->value());
+    }
+    for (const auto &entry : metrics.histograms) {
+        const LatencyHistogram &histogram = *entry.second;
+        result += "|" + entry.first + "_COUNT:" + std::to_string(histogram.count()) +
+                  "|" + entry.first + "_P50_US:" + us(histogram.percentile(0.50)) +
+                  "|" + entry.first + "_P99_US:" + us(histogram.percentile(0.99)) +
+                  "|" + entry.first + "_MAX_US:" + us(histogram.max());
+    }
+    return result;
+}
+
+void reset_metrics()
+{
+    MetricsRegistry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    for (auto &entry : metrics.counters) {
+        entry.second->reset();
+    }
+    for (auto &entry : metrics.histograms) {
+        entry.second->reset();
+    }
+    metrics.reset_at = std::chrono::steady_clock::now();
+}
+
+void visit_metrics(const std::function<void(const std::string &, const MetricCounter &)> &on_counter,
+                   const std::function<void(const std::string &, const LatencyHistogram &)> &on_histogram)
+{
+    MetricsRegistry &metrics = registry();
+    std::lock_guard<std::mutex> lock(metrics.mutex);
+    for (const auto &entry : metrics.counters) {
+        on_counter(entry.first, *entry.second);
+    }
+    for (const auto &entry : metrics.histograms) {
+        on_histogram(entry.first, *entry.second);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+class MetricCounter
+{
+public:
+    void add(uint64_t n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return count.load(std::memory_order_relaxed); }
+    void reset() { count.store(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> count{0};
+};
+
+// Log-linear latency histogram in the style of HdrHistogram: 16 linear
+// buckets per power of two of nanoseconds, so any value is kept within
+// about 6% up to ~18 minutes. Recording is a few relaxed atomic adds and
+// never blocks.
+class LatencyHistogram
+{
+public:
+    void record(std::chrono::nanoseconds latency);
+    void reset();
+
+    uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+    std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(max_ns.load(std::memory_order_relaxed)); }
+    std::chrono::nanoseconds sum() const { return std::chrono::nanoseconds(sum_ns.load(std::memory_order_relaxed)); }
+    // Upper bound of the bucket holding the given fraction (0..1) of samples
+    std::chrono::nanoseconds percentile(double fraction) const;
+
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kMaxValueBits = 40;
+    static constexpr size_t kBucketCount = (kMaxValueBits - kSubBucketBits + 2) << kSubBucketBits;
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets = {};
+    std::atomic<uint64_t> total_count{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> sum_ns{0};
+};
+
+// Named metrics, created on first use and never destroyed, so callers can
+// keep the reference in a function-local static
+MetricCounter &metrics_counter(const std::string &name);
+LatencyHistogram &metrics_histogram(const std::string &name);
+
+// Records the time from construction to destruction
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency(LatencyHistogram &target)
+        : histogram(target), start(std::chrono::steady_clock::now())
+    {
+    }
+    ~ScopedLatency() { histogram.record(std::chrono::steady_clock::now() - start); }
+
+    ScopedLatency(const ScopedLatency &) = delete;
+    ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+    LatencyHistogram &histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+// "SINCE_RESET_S:..|<COUNTER>:..|<HIST>_COUNT:..|<HIST>_P50_US:..|<HIST>_P99_US:..|<HIST>_MAX_US:..",
+// counters, then histograms, each sorted by name
+std::string format_metrics();
+void reset_metrics();
+
+// Walks the registry in the same order as format_metrics(), with the
+// registry locked; the visitors must not create metrics
+void visit_metrics(const std::function<void(const std::string &, const MetricCounter &)> &on_counter,
+                   const std::function<void(const std::string &, const LatencyHistogram &)> &on_histogram);
+
+#endif // METRICS_HPP
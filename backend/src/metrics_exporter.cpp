@@ -0,0 +1,627 @@
+#include <iostream>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include <string_view>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "metrics_exporter.hpp"
+#include "config.hpp"
+#include "fan.hpp"
+#include "fan_scheduler.hpp"
+#include "metrics.hpp"
+#include "telemetry.hpp"
+
+// Scrapers connect once per scrape; a few slots are plenty
+static constexpr size_t kMaxScrapeClients = 4;
+static constexpr size_t kMaxRequestSize = 2048;
+
+struct ScrapeConnection {
+    int fd = -1;
+    uint64_t accepted = 0; // the oldest connection is dropped when all slots are busy
+    std::array<char, kMaxRequestSize> request;
+    size_t request_size = 0;
+    std::string output; // kept with the slot, so its capacity is reused
+    size_t output_offset = 0;
+};
+
+static int exporter_epoll_fd = -1;
+static int listener_fd = -1;
+static std::string listener_spec = "off"; // metrics_listen the listener was bound for
+static std::string listener_unix_path;
+static std::shared_ptr<const BackendConfig> listener_config;
+static std::array<ScrapeConnection, kMaxScrapeClients> scrapes;
+static uint64_t scrapes_accepted = 0;
+static std::string body_buffer;
+
+static void close_listener()
+{
+    if (listener_fd < 0) {
+        return;
+    }
+    epoll_ctl(exporter_epoll_fd, EPOLL_CTL_DEL, listener_fd, nullptr);
+    close(listener_fd);
+    listener_fd = -1;
+    if (!listener_unix_path.empty()) {
+        unlink(listener_unix_path.c_str());
+        listener_unix_path.clear();
+    }
+}
+
+static int open_listener(const MetricsListenAddress &address)
+{
+    int fd;
+    int result;
+    if (address.unix_socket) {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        struct sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, address.path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(address.path.c_str());
+        result = bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+        if (result == 0) {
+            result = chmod(address.path.c_str(), 0660);
+        }
+    } else if (address.ipv6) {
+        fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        struct sockaddr_in6 addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_loopback;
+        addr.sin6_port = htons(address.port);
+        result = bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(address.port);
+        result = bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    }
+
+    if (result < 0 || listen(fd, 16) < 0) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+    return fd;
+}
+
+void update_metrics_listener()
+{
+    if (exporter_epoll_fd < 0) {
+        return;
+    }
+    auto config = backend_config();
+    if (config == listener_config) {
+        return;
+    }
+    listener_config = config;
+    if (config->metrics_listen == listener_spec) {
+        return;
+    }
+
+    close_listener();
+    listener_spec = config->metrics_listen;
+    MetricsListenAddress address;
+    if (!parse_metrics_listen(listener_spec, address) || (!address.unix_socket && address.port == 0)) {
+        return; // off (the config parser rejects invalid values)
+    }
+
+    int fd = open_listener(address);
+    if (fd < 0) {
+        std::cerr << "Failed to open metrics listener " << listener_spec << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(exporter_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        std::cerr << "Failed to watch metrics listener: " << strerror(errno) << std::endl;
+        close(fd);
+        return;
+    }
+    listener_fd = fd;
+    if (address.unix_socket) {
+        listener_unix_path = address.path;
+    }
+    std::cout << "Serving OpenMetrics on " << listener_spec << std::endl;
+}
+
+void start_metrics_exporter(int epoll_fd)
+{
+    exporter_epoll_fd = epoll_fd;
+    update_metrics_listener();
+}
+
+static ScrapeConnection *find_scrape(int fd)
+{
+    for (auto &scrape : scrapes) {
+        if (scrape.fd == fd) {
+            return &scrape;
+        }
+    }
+    return nullptr;
+}
+
+bool is_metrics_fd(int fd)
+{
+    return fd >= 0 && (fd == listener_fd || find_scrape(fd) != nullptr);
+}
+
+static void close_scrape(ScrapeConnection &scrape)
+{
+    epoll_ctl(exporter_epoll_fd, EPOLL_CTL_DEL, scrape.fd, nullptr);
+    close(scrape.fd);
+    scrape.fd = -1;
+    scrape.request_size = 0;
+    scrape.output.clear();
+    scrape.output_offset = 0;
+}
+
+static void accept_scrapes()
+{
+    while (true) {
+        int fd = accept4(listener_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        ScrapeConnection *slot = &scrapes[0];
+        for (auto &scrape : scrapes) {
+            if (scrape.fd < 0) {
+                slot = &scrape;
+                break;
+            }
+            if (scrape.accepted < slot->accepted) {
+                slot = &scrape;
+            }
+        }
+        if (slot->fd >= 0) {
+            close_scrape(*slot);
+        }
+
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(exporter_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        slot->fd = fd;
+        slot->accepted = ++scrapes_accepted;
+    }
+}
+
+// Returns false when done with the connection (sent or failed)
+static bool flush_scrape(ScrapeConnection &scrape)
+{
+    while (scrape.output_offset < scrape.output.size()) {
+        ssize_t sent = send(scrape.fd, scrape.output.data() + scrape.output_offset,
+                            scrape.output.size() - scrape.output_offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct epoll_event ev;
+                std::memset(&ev, 0, sizeof(ev));
+                ev.events = EPOLLOUT;
+                ev.data.fd = scrape.fd;
+                return epoll_ctl(exporter_epoll_fd, EPOLL_CTL_MOD, scrape.fd, &ev) == 0;
+            }
+            return false;
+        }
+        scrape.output_offset += static_cast<size_t>(sent);
+    }
+    return false;
+}
+
+static void append_status(std::string &out, const char *status, std::string_view content_type, size_t length)
+{
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), length);
+    out += "HTTP/1.1 ";
+    out += status;
+    out += "\r\nContent-Type: ";
+    out += content_type;
+    out += "\r\nContent-Length: ";
+    out.append(digits, result.ptr);
+    out += "\r\nConnection: close\r\n\r\n";
+}
+
+// Answers one HTTP request: GET / or GET /metrics, anything else is an error
+static void respond(ScrapeConnection &scrape, std::string_view request)
+{
+    scrape.output.clear();
+    scrape.output_offset = 0;
+
+    size_t line_end = request.find("\r\n");
+    std::string_view line = request.substr(0, line_end);
+    if (line.substr(0, 4) != "GET ") {
+        append_status(scrape.output, "405 Method Not Allowed", "text/plain", 0);
+        return;
+    }
+    std::string_view target = line.substr(4, line.find(' ', 4) - 4);
+    target = target.substr(0, target.find('?'));
+    if (target != "/" && target != "/metrics") {
+        append_status(scrape.output, "404 Not Found", "text/plain", 0);
+        return;
+    }
+
+    render_openmetrics(body_buffer);
+    append_status(scrape.output, "200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                  body_buffer.size());
+    scrape.output += body_buffer;
+}
+
+static bool handle_scrape_readable(ScrapeConnection &scrape)
+{
+    while (scrape.request_size < scrape.request.size()) {
+        ssize_t bytes_read = recv(scrape.fd, scrape.request.data() + scrape.request_size,
+                                  scrape.request.size() - scrape.request_size, 0);
+        if (bytes_read > 0) {
+            scrape.request_size += static_cast<size_t>(bytes_read);
+            continue;
+        }
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return false; // closed before a complete request, or failed
+    }
+
+    std::string_view request(scrape.request.data(), scrape.request_size);
+    if (request.find("\r\n\r\n") == std::string_view::npos) {
+        if (scrape.request_size == scrape.request.size()) {
+            scrape.output.clear();
+            scrape.output_offset = 0;
+            append_status(scrape.output, "431 Request Header Fields Too Large", "text/plain", 0);
+            return flush_scrape(scrape);
+        }
+        return true;
+    }
+    respond(scrape, request);
+    return flush_scrape(scrape);
+}
+
+void handle_metrics_event(int fd, uint32_t events)
+{
+    if (fd == listener_fd) {
+        accept_scrapes();
+        return;
+    }
+    ScrapeConnection *scrape = find_scrape(fd);
+    if (!scrape) {
+        return;
+    }
+
+    bool keep;
+    if (events & EPOLLERR) {
+        keep = false;
+    } else if (!scrape->output.empty()) {
+        keep = flush_scrape(*scrape);
+    } else {
+        keep = handle_scrape_readable(*scrape);
+    }
+    if (!keep) {
+        close_scrape(*scrape);
+    }
+}
+
+// Rendering appends to one buffer; numbers go through to_chars so a scrape
+// does not allocate once the buffer has grown to size
+
+static void append_number(std::string &out, double value)
+{
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+static void append_number(std::string &out, uint64_t value)
+{
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+static void append_family(std::string &out, const char *name, const char *type, const char *help)
+{
+    out += "# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += "\n# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += '\n';
+}
+
+// name{labels} value; labels is preformatted (key="value",...) or empty.
+// Samples without a value (sensor missing) are left out.
+static void append_sample(std::string &out, std::string_view name, std::string_view labels, double value)
+{
+    if (!std::isfinite(value)) {
+        return;
+    }
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    append_number(out, value);
+    out += '\n';
+}
+
+static void append_counter(std::string &out, std::string_view name, std::string_view labels, uint64_t value)
+{
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    append_number(out, value);
+    out += '\n';
+}
+
+template <typename T>
+static void append_optional(std::string &out, std::string_view name, std::string_view labels,
+                            const std::optional<T> &value)
+{
+    if (value) {
+        append_sample(out, name, labels, static_cast<double>(*value));
+    }
+}
+
+static void append_label_value(std::string &out, std::string_view value)
+{
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+}
+
+// METRICS registry names are upper case; OpenMetrics label values are
+// conventionally lower case
+static void append_lower(std::string &out, std::string_view value)
+{
+    for (char c : value) {
+        out += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+}
+
+static double seconds(std::chrono::nanoseconds value)
+{
+    return std::chrono::duration<double>(value).count();
+}
+
+static void render_sensors(std::string &out, const TelemetrySnapshot &snapshot)
+{
+    const ThermalSnapshot &thermal = snapshot.thermal;
+    append_family(out, "victus_temperature_celsius", "gauge", "Temperature sensors, CPU and GPU after the control filter");
+    append_optional(out, "victus_temperature_celsius", "sensor=\"cpu\"", thermal.cpu_temp_c);
+    append_optional(out, "victus_temperature_celsius", "sensor=\"cpu_raw\"", thermal.cpu_temp_raw_c);
+    append_optional(out, "victus_temperature_celsius", "sensor=\"gpu\"", thermal.gpu_temp_c);
+    append_optional(out, "victus_temperature_celsius", "sensor=\"gpu_raw\"", thermal.gpu_temp_raw_c);
+    append_optional(out, "victus_temperature_celsius", "sensor=\"libsensors\"", snapshot.cpu_temp);
+    append_optional(out, "victus_temperature_celsius", "sensor=\"package\"", snapshot.pkg_temp);
+
+    char labels[48];
+    for (size_t i = 0; i < snapshot.core_temps.size(); ++i) {
+        int length = std::snprintf(labels, sizeof(labels), "sensor=\"core\",index=\"%zu\"", i);
+        append_sample(out, "victus_temperature_celsius", std::string_view(labels, length), snapshot.core_temps[i]);
+    }
+    for (size_t i = 0; i < snapshot.nvme_temps.size(); ++i) {
+        int length = std::snprintf(labels, sizeof(labels), "sensor=\"nvme\",index=\"%zu\"", i);
+        append_sample(out, "victus_temperature_celsius", std::string_view(labels, length), snapshot.nvme_temps[i]);
+    }
+
+    append_family(out, "victus_usage_ratio", "gauge", "CPU and GPU utilisation");
+    if (thermal.cpu_usage_pct) {
+        append_sample(out, "victus_usage_ratio", "device=\"cpu\"", *thermal.cpu_usage_pct / 100.0);
+    }
+    if (thermal.gpu_usage_pct) {
+        append_sample(out, "victus_usage_ratio", "device=\"gpu\"", *thermal.gpu_usage_pct / 100.0);
+    }
+
+    append_family(out, "victus_hwmon_present", "gauge", "Whether the hp-wmi hwmon directory was found");
+    append_sample(out, "victus_hwmon_present", "", snapshot.hwmon_found ? 1.0 : 0.0);
+
+    append_family(out, "victus_telemetry_timestamp_seconds", "gauge", "Wall clock time of the sample these values come from");
+    append_sample(out, "victus_telemetry_timestamp_seconds", "", static_cast<double>(snapshot.timestamp_ms) / 1000.0);
+}
+
+static void render_fans(std::string &out, const TelemetrySnapshot &snapshot, const FanControlState &state)
+{
+    static constexpr std::array<std::string_view, 2> kFanLabels = {"fan=\"1\"", "fan=\"2\""};
+
+    append_family(out, "victus_fan_mode", "info", "Fan mode the backend is in");
+    if (snapshot.fan_mode.rfind("ERROR", 0) != 0) {
+        out += "victus_fan_mode_info{mode=\"";
+        append_label_value(out, snapshot.fan_mode);
+        out += "\"} 1\n";
+    }
+
+    append_family(out, "victus_fan_speed_rpm", "gauge", "Measured fan speed");
+    for (size_t i = 0; i < kFanLabels.size(); ++i) {
+        append_optional(out, "victus_fan_speed_rpm", kFanLabels[i], snapshot.fan_rpm[i]);
+    }
+    append_family(out, "victus_fan_target_rpm", "gauge", "Last target written to the fan");
+    for (size_t i = 0; i < kFanLabels.size(); ++i) {
+        append_optional(out, "victus_fan_target_rpm", kFanLabels[i], state.applied_target[i]);
+    }
+
+    FanSchedulerStats queue = fan_scheduler_stats();
+    append_family(out, "victus_fan_queue_pending", "gauge", "Fan targets waiting to be written");
+    for (size_t i = 0; i < kFanLabels.size(); ++i) {
+        append_sample(out, "victus_fan_queue_pending", kFanLabels[i], queue.pending[i] ? 1.0 : 0.0);
+    }
+    append_family(out, "victus_fan_queue_targets", "counter", "Fan targets by what happened to them");
+    append_counter(out, "victus_fan_queue_targets_total", "result=\"submitted\"", queue.submitted);
+    append_counter(out, "victus_fan_queue_targets_total", "result=\"applied\"", queue.applied);
+    append_counter(out, "victus_fan_queue_targets_total", "result=\"dropped\"", queue.dropped);
+    append_counter(out, "victus_fan_queue_targets_total", "result=\"failed\"", queue.failed);
+    append_counter(out, "victus_fan_queue_targets_total", "result=\"abandoned\"", queue.abandoned);
+}
+
+static void render_controller(std::string &out, const FanControlState &state)
+{
+    static constexpr std::array<std::string_view, 2> kFanLabels = {"fan=\"1\"", "fan=\"2\""};
+
+    append_family(out, "victus_controller", "info", "Controller driving the fans in BETTER_AUTO");
+    out += "victus_controller_info{active=\"";
+    append_lower(out, controller_name(state.active));
+    out += "\"} 1\n";
+
+    append_family(out, "victus_pid_target_celsius", "gauge", "Temperature the PID controller holds");
+    append_sample(out, "victus_pid_target_celsius", "", state.pid_target_c);
+    append_family(out, "victus_pid_output_ratio", "gauge", "PID output as a fraction of the fan range");
+    append_sample(out, "victus_pid_output_ratio", "", state.pid_output);
+    append_family(out, "victus_pid_integral_ratio", "gauge", "PID integral term");
+    append_sample(out, "victus_pid_integral_ratio", "", state.pid_integral);
+    append_family(out, "victus_pid_slope_celsius_per_second", "gauge", "Temperature slope the feed-forward acts on");
+    append_sample(out, "victus_pid_slope_celsius_per_second", "", state.pid_slope);
+    append_family(out, "victus_pid_fan_rpm", "gauge", "Fan speed the PID controller asks for");
+    for (size_t i = 0; i < kFanLabels.size(); ++i) {
+        append_sample(out, "victus_pid_fan_rpm", kFanLabels[i], state.pid_rpms[i]);
+    }
+
+    static constexpr std::array<std::string_view, 2> kActive = {"controller=\"curve\",role=\"active\"",
+                                                                "controller=\"pid\",role=\"active\""};
+    static constexpr std::array<std::string_view, 2> kShadow = {"controller=\"curve\",role=\"shadow\"",
+                                                                "controller=\"pid\",role=\"shadow\""};
+    append_family(out, "victus_controller_run_seconds", "counter", "Time each controller ran, driving or in shadow");
+    for (size_t i = 0; i < state.controllers.size(); ++i) {
+        append_sample(out, "victus_controller_run_seconds_total", kActive[i],
+                      std::chrono::duration<double>(state.controllers[i].active_time).count());
+        append_sample(out, "victus_controller_run_seconds_total", kShadow[i],
+                      std::chrono::duration<double>(state.controllers[i].shadow_time).count());
+    }
+    append_family(out, "victus_controller_writes", "counter", "Fan writes each controller made after its output shaper, driving or in shadow");
+    for (size_t i = 0; i < state.controllers.size(); ++i) {
+        append_counter(out, "victus_controller_writes_total", kActive[i], state.controllers[i].writes);
+        append_counter(out, "victus_controller_writes_total", kShadow[i], state.controllers[i].shadow_writes);
+    }
+    append_family(out, "victus_controller_overshoot_celsius", "gauge", "Peak temperature above the PID target while driving");
+    append_sample(out, "victus_controller_overshoot_celsius", "controller=\"curve\"", state.controllers[0].peak_overshoot_c);
+    append_sample(out, "victus_controller_overshoot_celsius", "controller=\"pid\"", state.controllers[1].peak_overshoot_c);
+
+    static constexpr std::array<std::array<std::string_view, 6>, 2> kShaperLabels = {{
+        {"fan=\"1\",result=\"request\"", "fan=\"1\",result=\"write\"", "fan=\"1\",result=\"equal\"",
+         "fan=\"1\",result=\"deadband\"", "fan=\"1\",result=\"superseded\"", "fan=\"1\",result=\"slew_step\""},
+        {"fan=\"2\",result=\"request\"", "fan=\"2\",result=\"write\"", "fan=\"2\",result=\"equal\"",
+         "fan=\"2\",result=\"deadband\"", "fan=\"2\",result=\"superseded\"", "fan=\"2\",result=\"slew_step\""},
+    }};
+    append_family(out, "victus_shaper_targets", "counter", "Output shaper decisions per fan");
+    for (size_t i = 0; i < state.shapers.size(); ++i) {
+        const ShaperStats &shaper = state.shapers[i];
+        append_counter(out, "victus_shaper_targets_total", kShaperLabels[i][0], shaper.requests);
+        append_counter(out, "victus_shaper_targets_total", kShaperLabels[i][1], shaper.writes);
+        append_counter(out, "victus_shaper_targets_total", kShaperLabels[i][2], shaper.equal);
+        append_counter(out, "victus_shaper_targets_total", kShaperLabels[i][3], shaper.deadband);
+        append_counter(out, "victus_shaper_targets_total", kShaperLabels[i][4], shaper.superseded);
+        append_counter(out, "victus_shaper_targets_total", kShaperLabels[i][5], shaper.slew_steps);
+    }
+}
+
+// The METRICS registry: counters as one family labelled by name,
+// histograms as one summary labelled by operation
+static void render_registry(std::string &out)
+{
+    append_family(out, "victus_events", "counter", "Backend event counters, see the METRICS command");
+    visit_metrics(
+        [&out](const std::string &name, const MetricCounter &counter) {
+            out += "victus_events_total{event=\"";
+            append_lower(out, name);
+            out += "\"} ";
+            append_number(out, counter.value());
+            out += '\n';
+        },
+        [](const std::string &, const LatencyHistogram &) {});
+
+    append_family(out, "victus_operation_latency_seconds", "summary", "Latency of hardware writes, reads, scripts, ticks and commands");
+    visit_metrics(
+        [](const std::string &, const MetricCounter &) {},
+        [&out](const std::string &name, const LatencyHistogram &histogram) {
+            static constexpr std::array<std::pair<double, std::string_view>, 2> kQuantiles = {{{0.5, "0.5"}, {0.99, "0.99"}}};
+            for (const auto &quantile : kQuantiles) {
+                out += "victus_operation_latency_seconds{operation=\"";
+                append_lower(out, name);
+                out += "\",quantile=\"";
+                out += quantile.second;
+                out += "\"} ";
+                append_number(out, seconds(histogram.percentile(quantile.first)));
+                out += '\n';
+            }
+            out += "victus_operation_latency_seconds_count{operation=\"";
+            append_lower(out, name);
+            out += "\"} ";
+            append_number(out, histogram.count());
+            out += "\nvictus_operation_latency_seconds_sum{operation=\"";
+            append_lower(out, name);
+            out += "\"} ";
+            append_number(out, seconds(histogram.sum()));
+            out += '\n';
+        });
+}
+
+void render_openmetrics(std::string &out)
+{
+    static LatencyHistogram &render_latency = metrics_histogram("OPENMETRICS_RENDER");
+    ScopedLatency timer(render_latency);
+
+    out.clear();
+    auto snapshot = latest_telemetry();
+    FanControlState state = fan_control_state();
+    render_sensors(out, *snapshot);
+    render_fans(out, *snapshot, state);
+    render_controller(out, state);
+    render_registry(out);
+    out += "# EOF\n";
+}
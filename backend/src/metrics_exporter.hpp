@@ -0,0 +1,24 @@
+#ifndef METRICS_EXPORTER_HPP
+#define METRICS_EXPORTER_HPP
+
+#include <cstdint>
+#include <string>
+
+// Registers the exporter with the server's epoll loop and binds the listener
+// configured in backend_config(), if any
+void start_metrics_exporter(int epoll_fd);
+
+// Rebinds the listener when metrics_listen changed since the last call;
+// cheap when it did not
+void update_metrics_listener();
+
+// True for the listener and scrape connections, which go to
+// handle_metrics_event() instead of the command protocol
+bool is_metrics_fd(int fd);
+void handle_metrics_event(int fd, uint32_t events);
+
+// OpenMetrics text of the cached telemetry snapshot, control loop state and
+// METRICS registry into out (cleared, its capacity reused)
+void render_openmetrics(std::string &out);
+
+#endif // METRICS_EXPORTER_HPP
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "output_shaper.hpp"
+
+using SteadyClock = std::chrono::steady_clock;
+
+void OutputShaper::reset()
+{
+    pending = false;
+    forced = false;
+    written = -1;
+    last_write = SteadyClock::time_point::min();
+    last_step = SteadyClock::time_point::min();
+}
+
+void OutputShaper::set_target(int rpm, bool force)
+{
+    ++shaper_stats.requests;
+    if (pending) {
+        ++shaper_stats.superseded;
+    }
+    target = rpm;
+    pending = true;
+    forced = forced || force;
+}
+
+std::optional<int> OutputShaper::step(SteadyClock::time_point now, int min_rpm)
+{
+    double elapsed = 0.0;
+    if (last_step != SteadyClock::time_point::min()) {
+        elapsed = std::chrono::duration<double>(now - last_step).count();
+    }
+    last_step = now;
+    if (!pending) {
+        return std::nullopt;
+    }
+
+    if (written < 0) {
+        shaped = target; // nothing to slew from
+    } else {
+        double delta = target - shaped;
+        if (delta > 0 && limits.slew_up_rpm_per_s > 0) {
+            delta = std::min(delta, limits.slew_up_rpm_per_s * elapsed);
+        } else if (delta < 0 && limits.slew_down_rpm_per_s > 0) {
+            delta = std::max(delta, -limits.slew_down_rpm_per_s * elapsed);
+        }
+        shaped += delta;
+        // No speeds between 0 and min_rpm: start at min_rpm, stop from it
+        if (target > 0 && shaped < min_rpm) {
+            shaped = min_rpm;
+        } else if (target == 0 && shaped <= min_rpm) {
+            shaped = 0;
+        }
+    }
+
+    int candidate = static_cast<int>(std::lround(shaped));
+    bool reached = (candidate == target);
+    if (candidate == written) {
+        if (reached) {
+            pending = false;
+            forced = false;
+            ++shaper_stats.equal;
+        }
+        return std::nullopt;
+    }
+
+    bool crosses_zero = (written == 0 || candidate == 0);
+    if (!forced && written > 0 && !crosses_zero && std::abs(candidate - written) < limits.deadband_rpm) {
+        if (reached) {
+            pending = false;
+            ++shaper_stats.deadband;
+            shaped = written; // slew from what the fan actually runs at
+        }
+        return std::nullopt;
+    }
+
+    if (!forced && written >= 0) {
+        auto dwell = crosses_zero ? std::max(limits.dwell, limits.zero_dwell) : limits.dwell;
+        if (now - last_write < dwell) {
+            return std::nullopt; // stays pending
+        }
+    }
+
+    written = candidate;
+    last_write = now;
+    ++shaper_stats.writes;
+    if (reached) {
+        pending = false;
+        forced = false;
+    } else {
+        ++shaper_stats.slew_steps;
+    }
+    return candidate;
+}
@@ -0,0 +1,60 @@
+#ifndef OUTPUT_SHAPER_HPP
+#define OUTPUT_SHAPER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+struct ShaperLimits {
+    int deadband_rpm = 200;          // smaller changes are not written
+    double slew_up_rpm_per_s = 0.0;  // 0: unlimited, react to heat at once
+    double slew_down_rpm_per_s = 100.0;
+    std::chrono::seconds dwell{10};      // minimum time between writes to a fan
+    std::chrono::seconds zero_dwell{60}; // ... when stopping or starting it (0 RPM)
+};
+
+struct ShaperStats {
+    uint64_t requests = 0;   // targets from the controller
+    uint64_t writes = 0;
+    uint64_t equal = 0;      // same as the last written target
+    uint64_t deadband = 0;   // within deadband_rpm of it
+    uint64_t superseded = 0; // replaced while held back by dwell or slew
+    uint64_t slew_steps = 0; // writes of an intermediate, slew-limited value
+
+    uint64_t avoided() const { return equal + deadband + superseded; }
+};
+
+// Sits between a controller and the writes of one fan: the controller sets
+// targets, step() runs every tick and says what to write, if anything.
+// The written value moves towards the target at most at the slew rates; a
+// fan never runs between 0 and min_rpm, so starting and stopping are steps.
+class OutputShaper
+{
+public:
+    void set_limits(const ShaperLimits &new_limits) { limits = new_limits; }
+    // Forgets the written value; the next target is written right away
+    void reset();
+
+    // forced (new curves or config) skips the deadband and dwell checks,
+    // but not the slew limits; a target equal to the written one is never
+    // written again
+    void set_target(int rpm, bool forced);
+
+    // Next RPM to write on this tick, nullopt to write nothing
+    std::optional<int> step(std::chrono::steady_clock::time_point now, int min_rpm);
+
+    const ShaperStats &stats() const { return shaper_stats; }
+
+private:
+    ShaperLimits limits;
+    ShaperStats shaper_stats;
+    bool pending = false;
+    bool forced = false;
+    int target = 0;
+    double shaped = 0.0;   // slew-limited value heading for target
+    int written = -1;      // -1: nothing written yet
+    std::chrono::steady_clock::time_point last_write;
+    std::chrono::steady_clock::time_point last_step;
+};
+
+#endif // OUTPUT_SHAPER_HPP
@@ -0,0 +1,49 @@
+#include <algorithm>
+
+#include "sensor_filter.hpp"
+
+// Past this the history says nothing about the current temperature
+static constexpr std::chrono::seconds kFilterStaleAfter{30};
+
+void SensorFilter::reset()
+{
+    samples.clear();
+    output.reset();
+}
+
+double SensorFilter::update(double raw, std::chrono::steady_clock::time_point now, const SensorFilterConfig &config)
+{
+    if (output && now - last_update > kFilterStaleAfter) {
+        reset();
+    }
+    double elapsed = output ? std::chrono::duration<double>(now - last_update).count() : 0.0;
+    last_update = now;
+
+    samples.push(raw);
+    size_t window = std::clamp<size_t>(config.median_window, 1, kMaxMedianWindow);
+    window = std::min(window, samples.size());
+    std::array<double, kMaxMedianWindow> recent = {};
+    for (size_t i = 0; i < window; ++i) {
+        recent[i] = samples[samples.size() - window + i];
+    }
+    std::nth_element(recent.begin(), recent.begin() + window / 2, recent.begin() + window);
+    double value = recent[window / 2];
+    if (window % 2 == 0) {
+        // Even window: mean of the two middle samples
+        double lower = *std::max_element(recent.begin(), recent.begin() + window / 2);
+        value = (value + lower) / 2.0;
+    }
+
+    if (!output) {
+        output = value;
+        return *output;
+    }
+
+    if (config.max_rate_c_per_s > 0) {
+        double max_step = config.max_rate_c_per_s * elapsed;
+        value = std::clamp(value, *output - max_step, *output + max_step);
+    }
+    double alpha = std::clamp(config.ema_alpha, 0.0, 1.0);
+    output = *output + alpha * (value - *output);
+    return *output;
+}
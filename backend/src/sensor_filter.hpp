@@ -0,0 +1,64 @@
+#ifndef SENSOR_FILTER_HPP
+#define SENSOR_FILTER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+// Fixed-capacity FIFO that overwrites its oldest element when full
+template <typename T, size_t Capacity>
+class RingBuffer
+{
+public:
+    void push(const T &value)
+    {
+        items[(first + count) % Capacity] = value;
+        if (count < Capacity) {
+            ++count;
+        } else {
+            first = (first + 1) % Capacity;
+        }
+    }
+    void clear() { first = count = 0; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    // 0 is the oldest element
+    const T &operator[](size_t index) const { return items[(first + index) % Capacity]; }
+    const T &newest() const { return (*this)[count - 1]; }
+
+private:
+    std::array<T, Capacity> items = {};
+    size_t first = 0;
+    size_t count = 0;
+};
+
+static constexpr size_t kMaxMedianWindow = 9;
+
+// Stages of one sensor's filter chain, applied in this order
+struct SensorFilterConfig {
+    size_t median_window = 3;    // median of the last N raw samples, 1 = off
+    double max_rate_c_per_s = 0; // clamp on how fast the output may move, 0 = off
+    double ema_alpha = 1.0;      // weight of the new sample, 1 = off
+};
+
+// Turns raw temperature samples into the value the control loop uses. The
+// median drops single-sample spikes (turbo bursts), the rate clamp limits
+// what gets through a longer excursion, the EMA smooths what is left.
+class SensorFilter
+{
+public:
+    // Returns the filtered value for this sample
+    double update(double raw, std::chrono::steady_clock::time_point now, const SensorFilterConfig &config);
+    void reset();
+
+    std::optional<double> value() const { return output; }
+
+private:
+    RingBuffer<double, kMaxMedianWindow> samples;
+    std::optional<double> output;
+    std::chrono::steady_clock::time_point last_update;
+};
+
+#endif // SENSOR_FILTER_HPP
@@ -0,0 +1,118 @@
+#include "sensor_reader.hpp"
+#include "metrics.hpp"
+#include <charconv>
+#include <utility>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+SensorReader::SensorReader(std::string path) : file_path(std::move(path))
+{
+}
+
+SensorReader::~SensorReader()
+{
+    close();
+}
+
+SensorReader::SensorReader(SensorReader &&other) noexcept
+    : file_path(std::move(other.file_path)), fd(std::exchange(other.fd, -1))
+{
+}
+
+SensorReader &SensorReader::operator=(SensorReader &&other) noexcept
+{
+    if (this != &other) {
+        close();
+        file_path = std::move(other.file_path);
+        fd = std::exchange(other.fd, -1);
+    }
+    return *this;
+}
+
+void SensorReader::set_path(const std::string &path)
+{
+    if (path == file_path) {
+        return;
+    }
+    close();
+    file_path = path;
+}
+
+void SensorReader::close()
+{
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool SensorReader::ensure_open()
+{
+    if (fd >= 0) {
+        return true;
+    }
+    if (file_path.empty()) {
+        return false;
+    }
+    fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    return fd >= 0;
+}
+
+ssize_t SensorReader::read(char *buffer, size_t size)
+{
+    if (size == 0) {
+        return -1;
+    }
+
+    static LatencyHistogram &read_latency = metrics_histogram("SENSOR_READ");
+    static MetricCounter &read_errors = metrics_counter("SENSOR_READ_ERRORS");
+    ScopedLatency timer(read_latency);
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (!ensure_open()) {
+            return -1;
+        }
+
+        ssize_t length = pread(fd, buffer, size - 1, 0);
+        if (length >= 0) {
+            buffer[length] = '\0';
+            return length;
+        }
+
+        // ENODEV/ENOENT: the device behind the attribute was removed
+        int read_errno = errno;
+        close();
+        if (read_errno != ENODEV && read_errno != ENOENT && read_errno != EBADF) {
+            read_errors.add();
+            return -1;
+        }
+    }
+    read_errors.add();
+    return -1;
+}
+
+std::optional<long long> SensorReader::read_integer()
+{
+    char buffer[64];
+    ssize_t length = read(buffer, sizeof(buffer));
+    if (length <= 0) {
+        return std::nullopt;
+    }
+    return parse_integer(std::string_view(buffer, static_cast<size_t>(length)));
+}
+
+std::optional<long long> parse_integer(std::string_view text)
+{
+    size_t start = 0;
+    while (start < text.size() && (text[start] == ' ' || text[start] == '\t' || text[start] == '\n')) {
+        ++start;
+    }
+
+    long long value = 0;
+    auto [ptr, ec] = std::from_chars(text.data() + start, text.data() + text.size(), value);
+    if (ec != std::errc() || ptr == text.data() + start) {
+        return std::nullopt;
+    }
+    return value;
+}
@@ -0,0 +1,47 @@
+#ifndef SENSOR_READER_HPP
+#define SENSOR_READER_HPP
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstddef>
+#include <sys/types.h>
+
+// Keeps a sysfs/procfs file open and re-reads it with pread(fd, buf, n, 0)
+// instead of building a new std::ifstream for every sample. Sysfs and
+// seq_file both regenerate the contents when read from offset 0.
+class SensorReader
+{
+public:
+    SensorReader() = default;
+    explicit SensorReader(std::string path);
+    ~SensorReader();
+
+    SensorReader(const SensorReader &) = delete;
+    SensorReader &operator=(const SensorReader &) = delete;
+    SensorReader(SensorReader &&other) noexcept;
+    SensorReader &operator=(SensorReader &&other) noexcept;
+
+    // Switches to a new file; the old descriptor is closed right away
+    void set_path(const std::string &path);
+    const std::string &path() const { return file_path; }
+    void close();
+
+    // Reads the current contents into buffer (NUL terminated), returns the
+    // length or -1. A descriptor that went stale is reopened once.
+    ssize_t read(char *buffer, size_t size);
+
+    // Reads the file and parses the leading integer
+    std::optional<long long> read_integer();
+
+private:
+    bool ensure_open();
+
+    std::string file_path;
+    int fd = -1;
+};
+
+// Parses a decimal integer after optional leading whitespace
+std::optional<long long> parse_integer(std::string_view text);
+
+#endif // SENSOR_READER_HPP
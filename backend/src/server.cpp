@@ -0,0 +1,610 @@
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <map>
+#include <chrono>
+#include <sstream>
+#include <optional>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "server.hpp"
+#include "commands.hpp"
+#include "command_worker.hpp"
+#include "fan.hpp"
+#include "telemetry.hpp"
+#include "config.hpp"
+#include "metrics_exporter.hpp"
+
+// Stop reading from a client that does not drain its responses
+static constexpr size_t kMaxPendingOutput = 1 << 20;
+// Stop reading from a client whose commands are still being worked on
+static constexpr size_t kMaxPendingInput = 64 << 10;
+static constexpr int kMaxEvents = 64;
+static constexpr std::chrono::milliseconds kMaxSubscribeInterval{3600000};
+
+using SteadyClock = std::chrono::steady_clock;
+
+// State of a SUBSCRIBE on one connection. Pushes carry only the sections
+// that differ from last_sent, i.e. from what the client actually received.
+struct Subscription {
+    bool active = false;
+    unsigned fields = 0;
+    std::chrono::milliseconds min_interval{0};
+    SteadyClock::time_point last_push = SteadyClock::time_point::min();
+    bool pending = false;   // a newer snapshot has not been pushed yet
+    std::map<std::string, std::string> last_sent;
+};
+
+struct Connection {
+    int fd = -1;
+    uint64_t id = 0;         // unique per connection, fds get reused
+    std::string input;       // bytes of not yet processed frames
+    std::string output;      // framed responses not yet sent
+    size_t output_offset = 0;
+    bool peer_closed = false;
+    uint32_t events = 0;     // currently registered epoll events
+    size_t jobs_in_flight = 0;
+    bool waiting_in_order = false; // an untagged slow command is running
+    Subscription subscription;
+};
+
+static int epoll_fd = -1;
+static std::unordered_map<int, Connection> connections;
+static int active_clients = 0;
+static int subscriber_count = 0;
+static uint64_t next_connection_id = 1;
+
+static void on_client_connected()
+{
+    ++active_clients;
+    std::cout << "Client connected (active: " << active_clients << ")" << std::endl;
+}
+
+static void on_client_disconnected()
+{
+    if (active_clients > 0) {
+        --active_clients;
+    }
+    std::cout << "Client disconnected (active: " << active_clients << ")" << std::endl;
+
+    if (active_clients == 0) {
+        // On the worker: may fall back to a sudo script, and must not run
+        // between the steps of a SET_FAN_MODE
+        auto enforce = []() {
+            auto result = ensure_better_auto_mode();
+            if (result != "OK") {
+                std::cerr << "Failed to enforce BETTER_AUTO mode after client disconnect: " << result << std::endl;
+            }
+            return result;
+        };
+        if (command_worker_event_fd() >= 0) {
+            CommandJob job;
+            job.action = enforce;
+            submit_command(std::move(job));
+        } else {
+            enforce();
+        }
+    }
+}
+
+static void update_events(Connection &conn)
+{
+    uint32_t events = conn.peer_closed ? 0u : static_cast<uint32_t>(EPOLLRDHUP);
+    if (!conn.peer_closed && conn.output.size() - conn.output_offset < kMaxPendingOutput &&
+        conn.input.size() < kMaxPendingInput) {
+        events |= EPOLLIN;
+    }
+    if (conn.output_offset < conn.output.size()) {
+        events |= EPOLLOUT;
+    }
+    if (events == conn.events) {
+        return;
+    }
+
+    // Nothing to wait for but the worker (peer gone, output sent). The
+    // kernel reports EPOLLHUP even with no events registered, so take the
+    // fd out of the set; handle_completed_commands() picks it up again.
+    if (events == 0) {
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr) == 0) {
+            conn.events = 0;
+        }
+        return;
+    }
+
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = conn.fd;
+    int op = conn.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(epoll_fd, op, conn.fd, &ev) == 0) {
+        conn.events = events;
+    }
+}
+
+static void close_connection(int fd)
+{
+    auto it = connections.find(fd);
+    if (it != connections.end() && it->second.subscription.active) {
+        --subscriber_count;
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+    on_client_disconnected();
+}
+
+static void queue_response(Connection &conn, const std::string &response)
+{
+    uint32_t len = response.length();
+    conn.output.append(reinterpret_cast<const char *>(&len), sizeof(len));
+    conn.output.append(response);
+}
+
+static void queue_tagged_response(Connection &conn, uint32_t request_id, const std::string &response)
+{
+    uint32_t len = static_cast<uint32_t>(response.length()) | kFrameTagged;
+    conn.output.append(reinterpret_cast<const char *>(&len), sizeof(len));
+    conn.output.append(reinterpret_cast<const char *>(&request_id), sizeof(request_id));
+    conn.output.append(response);
+}
+
+// Returns false when the connection failed and must be closed
+static bool flush_output(Connection &conn)
+{
+    while (conn.output_offset < conn.output.size()) {
+        ssize_t sent = send(conn.fd, conn.output.data() + conn.output_offset,
+                            conn.output.size() - conn.output_offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            std::cerr << "Failed to send data" << std::endl;
+            return false;
+        }
+        conn.output_offset += static_cast<size_t>(sent);
+    }
+
+    if (conn.output_offset == conn.output.size()) {
+        conn.output.clear();
+        conn.output_offset = 0;
+    } else if (conn.output_offset > kMaxPendingOutput) {
+        conn.output.erase(0, conn.output_offset);
+        conn.output_offset = 0;
+    }
+    return true;
+}
+
+// Queues a PUSH frame with the sections that changed since the last push.
+// While earlier output is still unsent the push is postponed, so a slow
+// consumer only ever gets the newest state instead of a backlog of frames.
+static void try_push(Connection &conn, SteadyClock::time_point now)
+{
+    Subscription &sub = conn.subscription;
+    if (!sub.active || !sub.pending || conn.peer_closed || conn.output_offset < conn.output.size()) {
+        return;
+    }
+    if (sub.last_push != SteadyClock::time_point::min() && now - sub.last_push < sub.min_interval) {
+        return;
+    }
+
+    auto snapshot = latest_telemetry();
+    std::string push = "PUSH|TS:" + std::to_string(snapshot->timestamp_ms);
+    bool changed = false;
+    for (auto &section : telemetry_sections(*snapshot, sub.fields)) {
+        auto it = sub.last_sent.find(section.first);
+        if (it != sub.last_sent.end() && it->second == section.second) {
+            continue;
+        }
+        push += "|" + section.first + ":" + section.second;
+        sub.last_sent[section.first] = std::move(section.second);
+        changed = true;
+    }
+
+    sub.pending = false;
+    if (changed) {
+        queue_response(conn, push);
+        sub.last_push = now;
+    }
+}
+
+// Milliseconds until the next postponed push is due, -1 when none is
+static int next_push_timeout(SteadyClock::time_point now)
+{
+    if (subscriber_count == 0) {
+        return -1;
+    }
+
+    int timeout = -1;
+    for (auto &entry : connections) {
+        const Connection &conn = entry.second;
+        const Subscription &sub = conn.subscription;
+        if (!sub.active || !sub.pending || conn.output_offset < conn.output.size()) {
+            continue;
+        }
+        auto due = sub.last_push + sub.min_interval;
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count() + 1;
+        int wait_ms = wait < 0 ? 0 : static_cast<int>(wait);
+        if (timeout < 0 || wait_ms < timeout) {
+            timeout = wait_ms;
+        }
+    }
+    return timeout;
+}
+
+// Sends due pushes on every subscribed connection
+static void push_subscribers(bool new_snapshot)
+{
+    if (subscriber_count == 0) {
+        return;
+    }
+
+    auto now = SteadyClock::now();
+    std::vector<int> failed;
+    for (auto &entry : connections) {
+        Connection &conn = entry.second;
+        if (!conn.subscription.active) {
+            continue;
+        }
+        if (new_snapshot) {
+            conn.subscription.pending = true;
+        }
+        bool had_output = conn.output_offset < conn.output.size();
+        try_push(conn, now);
+        if (!had_output && conn.output_offset < conn.output.size()) {
+            if (!flush_output(conn)) {
+                failed.push_back(conn.fd);
+                continue;
+            }
+            update_events(conn);
+        }
+    }
+    for (int fd : failed) {
+        close_connection(fd);
+    }
+}
+
+// "SUBSCRIBE <fields> <min_interval_ms>" / "UNSUBSCRIBE"; these change
+// connection state, so they are handled here instead of handle_command()
+static std::optional<std::string> handle_subscription_command(Connection &conn, const std::string &command)
+{
+    std::stringstream ss(command);
+    std::string cmd;
+    ss >> cmd;
+
+    if (cmd == "UNSUBSCRIBE") {
+        if (conn.subscription.active) {
+            --subscriber_count;
+        }
+        conn.subscription = Subscription();
+        return std::string("OK");
+    }
+    if (cmd != "SUBSCRIBE") {
+        return std::nullopt;
+    }
+
+    std::string field_list;
+    long long interval_ms = -1;
+    if (!(ss >> field_list >> interval_ms)) {
+        return std::string("ERROR: Usage: SUBSCRIBE <MODE,FAN1,FAN2,CPU,TEMPS|ALL> <min_interval_ms>");
+    }
+    auto fields = parse_telemetry_fields(field_list);
+    if (!fields) {
+        return "ERROR: Unknown subscription fields " + field_list;
+    }
+    if (interval_ms < 0 || interval_ms > kMaxSubscribeInterval.count()) {
+        return "ERROR: Invalid minimum interval " + std::to_string(interval_ms) + " (valid range: 0-" +
+               std::to_string(kMaxSubscribeInterval.count()) + " ms)";
+    }
+    if (telemetry_event_fd() < 0) {
+        return std::string("ERROR: Subscriptions unavailable");
+    }
+
+    if (!conn.subscription.active) {
+        ++subscriber_count;
+    }
+    // A (re)subscribe starts from scratch: the first push carries every field
+    conn.subscription = Subscription();
+    conn.subscription.active = true;
+    conn.subscription.fields = *fields;
+    conn.subscription.min_interval = std::chrono::milliseconds(interval_ms);
+    conn.subscription.pending = true;
+    return std::string("OK");
+}
+
+// Runs every complete frame in the input buffer. Slow commands go to the
+// command worker; for untagged frames processing then pauses until the
+// response is back, so untagged responses stay in request order.
+static bool process_input(Connection &conn)
+{
+    size_t offset = 0;
+    while (!conn.waiting_in_order && conn.input.size() - offset >= sizeof(uint32_t)) {
+        uint32_t header;
+        std::memcpy(&header, conn.input.data() + offset, sizeof(header));
+        bool tagged = (header & kFrameTagged) != 0;
+        uint32_t cmd_len = header & ~kFrameTagged;
+        size_t header_len = sizeof(header) + (tagged ? sizeof(uint32_t) : 0);
+        if (cmd_len > kMaxCommandLength) { // Basic sanity check
+            std::cerr << "Command too long. Closing connection.\n";
+            return false;
+        }
+        if (conn.input.size() - offset < header_len + cmd_len) {
+            break;
+        }
+
+        uint32_t request_id = 0;
+        if (tagged) {
+            std::memcpy(&request_id, conn.input.data() + offset + sizeof(header), sizeof(request_id));
+        }
+        std::string command = conn.input.substr(offset + header_len, cmd_len);
+        offset += header_len + cmd_len;
+
+        std::string response;
+        auto subscription_response = handle_subscription_command(conn, command);
+        if (subscription_response) {
+            response = *subscription_response;
+        } else if (command_worker_event_fd() >= 0 && is_slow_command(command)) {
+            CommandJob job;
+            job.fd = conn.fd;
+            job.connection_id = conn.id;
+            job.tagged = tagged;
+            job.request_id = request_id;
+            job.command = std::move(command);
+            submit_command(std::move(job));
+            ++conn.jobs_in_flight;
+            conn.waiting_in_order = !tagged;
+            continue;
+        } else {
+            response = handle_command(command);
+        }
+
+        if (tagged) {
+            queue_tagged_response(conn, request_id, response);
+        } else {
+            queue_response(conn, response);
+        }
+    }
+    conn.input.erase(0, offset);
+    return true;
+}
+
+static bool handle_readable(Connection &conn)
+{
+    char buffer[4096];
+    while (true) {
+        ssize_t bytes_read = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (bytes_read > 0) {
+            conn.input.append(buffer, static_cast<size_t>(bytes_read));
+            if (conn.input.size() >= kMaxPendingInput) {
+                break; // resumes once process_input() caught up
+            }
+            continue;
+        }
+        if (bytes_read == 0) {
+            conn.peer_closed = true;
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        return false;
+    }
+    return process_input(conn);
+}
+
+static void accept_clients(int server_socket)
+{
+    while (true) {
+        int client_socket = accept4(server_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            return;
+        }
+
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = client_socket;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) < 0) {
+            std::cerr << "Failed to watch client socket: " << strerror(errno) << std::endl;
+            close(client_socket);
+            continue;
+        }
+
+        Connection conn;
+        conn.fd = client_socket;
+        conn.id = next_connection_id++;
+        conn.events = ev.events;
+        connections.emplace(client_socket, std::move(conn));
+        on_client_connected();
+    }
+}
+
+static bool has_complete_frame(const Connection &conn)
+{
+    if (conn.input.size() < sizeof(uint32_t)) {
+        return false;
+    }
+    uint32_t header;
+    std::memcpy(&header, conn.input.data(), sizeof(header));
+    size_t header_len = sizeof(header) + ((header & kFrameTagged) ? sizeof(uint32_t) : 0);
+    return conn.input.size() >= header_len + (header & ~kFrameTagged);
+}
+
+static void handle_client_event(int fd, uint32_t events)
+{
+    auto it = connections.find(fd);
+    if (it == connections.end()) {
+        return;
+    }
+    Connection &conn = it->second;
+
+    if (events & EPOLLERR) {
+        close_connection(fd);
+        return;
+    }
+    if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !handle_readable(conn)) {
+        std::cerr << "Client disconnected or error occurred while reading command.\n";
+        close_connection(fd);
+        return;
+    }
+    if (!flush_output(conn)) {
+        close_connection(fd);
+        return;
+    }
+    // Output drained: deliver the newest state that was held back (or the
+    // initial push right after a SUBSCRIBE's OK)
+    if (conn.subscription.pending && conn.output.empty()) {
+        try_push(conn, SteadyClock::now());
+        if (!flush_output(conn)) {
+            close_connection(fd);
+            return;
+        }
+    }
+
+    // Answer everything the peer sent before hanging up, then close
+    if (conn.peer_closed && conn.output.empty() && conn.jobs_in_flight == 0 && !has_complete_frame(conn)) {
+        close_connection(fd);
+        return;
+    }
+    update_events(conn);
+}
+
+// Delivers responses of commands the worker has finished
+static void handle_completed_commands()
+{
+    for (auto &job : take_completed_commands()) {
+        auto it = connections.find(job.fd);
+        if (it == connections.end() || it->second.id != job.connection_id) {
+            continue; // client went away meanwhile
+        }
+
+        Connection &conn = it->second;
+        --conn.jobs_in_flight;
+        if (job.tagged) {
+            queue_tagged_response(conn, job.request_id, job.response);
+        } else {
+            queue_response(conn, job.response);
+            conn.waiting_in_order = false;
+            // Continue with frames that arrived while this one was running
+            if (!process_input(conn)) {
+                close_connection(conn.fd);
+                continue;
+            }
+        }
+        handle_client_event(conn.fd, 0);
+    }
+}
+
+int run_server(int server_socket)
+{
+    int flags = fcntl(server_socket, F_GETFL, 0);
+    fcntl(server_socket, F_SETFL, flags | O_NONBLOCK);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        std::cerr << "epoll_create1 failed: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = server_socket;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &ev) < 0) {
+        std::cerr << "Failed to watch server socket: " << strerror(errno) << std::endl;
+        close(epoll_fd);
+        return 1;
+    }
+
+    int telemetry_fd = telemetry_event_fd();
+    if (telemetry_fd >= 0) {
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = telemetry_fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, telemetry_fd, &ev) < 0) {
+            std::cerr << "Failed to watch telemetry events: " << strerror(errno) << std::endl;
+            telemetry_fd = -1;
+        }
+    }
+
+    start_command_worker();
+    int worker_fd = command_worker_event_fd();
+    if (worker_fd >= 0) {
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = worker_fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, worker_fd, &ev) < 0) {
+            std::cerr << "Failed to watch command worker: " << strerror(errno) << std::endl;
+            return 1;
+        }
+    }
+
+    int config_fd = config_watch_fd();
+    if (config_fd >= 0) {
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = config_fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, config_fd, &ev) < 0) {
+            std::cerr << "Failed to watch config changes: " << strerror(errno) << std::endl;
+            config_fd = -1;
+        }
+    }
+
+    start_metrics_exporter(epoll_fd);
+
+    struct epoll_event events[kMaxEvents];
+    while (true) {
+        int count = epoll_wait(epoll_fd, events, kMaxEvents, next_push_timeout(SteadyClock::now()));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+            close(epoll_fd);
+            return 1;
+        }
+
+        bool new_snapshot = false;
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == server_socket) {
+                accept_clients(server_socket);
+            } else if (events[i].data.fd == telemetry_fd) {
+                uint64_t published;
+                while (read(telemetry_fd, &published, sizeof(published)) > 0) {
+                }
+                new_snapshot = true;
+            } else if (events[i].data.fd == worker_fd) {
+                handle_completed_commands();
+            } else if (events[i].data.fd == config_fd) {
+                if (handle_config_events()) {
+                    apply_backend_config();
+                }
+            } else if (is_metrics_fd(events[i].data.fd)) {
+                handle_metrics_event(events[i].data.fd, events[i].events);
+            } else {
+                handle_client_event(events[i].data.fd, events[i].events);
+            }
+        }
+        // Also runs on timeout, for pushes held back by min_interval
+        push_subscribers(new_snapshot);
+        // After a reload, from the file watch or RELOAD_CONFIG
+        update_metrics_listener();
+    }
+}
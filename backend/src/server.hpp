@@ -0,0 +1,23 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <cstdint>
+
+// In RUN_DIR (util.hpp)
+#define SOCKET_NAME "victus_backend.sock"
+
+// Commands and responses are framed as a native-endian u32 length followed
+// by the payload
+static constexpr uint32_t kMaxCommandLength = 1024;
+
+// A length with this bit set is followed by a native-endian u32 request id
+// before the payload. The response to such a frame carries the same flag and
+// id and may arrive out of order; untagged frames are answered in order.
+// Subscription pushes are always untagged.
+static constexpr uint32_t kFrameTagged = 0x80000000u;
+
+// Serves every client connection from one epoll loop. server_socket must be
+// a listening unix socket; only returns on a fatal epoll error.
+int run_server(int server_socket);
+
+#endif // SERVER_HPP
@@ -15,7 +15,8 @@ FAN_NUM=$1
 SPEED=$2
 
 # Find the correct hwmon directory path
-HWMON_BASE="/sys/devices/platform/hp-wmi/hwmon"
+# VICTUS_FS_ROOT only survives sudo when set on purpose (emulator, benchmarks)
+HWMON_BASE="${VICTUS_FS_ROOT}/sys/devices/platform/hp-wmi/hwmon"
 HWMON_PATH=$(find "$HWMON_BASE" -mindepth 1 -type d -name "hwmon*" | head -n 1)
 echo "Debug: Found hwmon path: $HWMON_PATH" >&2
 
@@ -0,0 +1,190 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <queue>
+#include <vector>
+#include <algorithm>
+
+#include "task_scheduler.hpp"
+
+using SteadyClock = std::chrono::steady_clock;
+
+struct ScheduledTask {
+    std::string name;
+    std::chrono::nanoseconds period{0};
+    std::function<void()> fn;
+    SteadyClock::time_point start; // grid origin
+    uint64_t next_index = 0;       // next run is start + period * next_index
+    SteadyClock::time_point next_run;
+};
+
+using HeapEntry = std::pair<SteadyClock::time_point, TaskHandle>;
+
+static std::mutex task_mutex;
+static std::condition_variable task_done_cv;
+static std::map<TaskHandle, ScheduledTask> tasks;
+// Entries go stale when a task is cancelled or rescheduled; they are skipped
+// when they reach the top instead of being searched for
+static std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> task_heap;
+static std::map<std::string, LoopTimerStats> stats_by_name;
+static TaskHandle next_task_handle = 1;
+static TaskHandle running_task = 0;
+static std::thread::id scheduler_thread_id;
+static LoopTimer scheduler_wakeup;
+
+static bool is_stale_locked(const HeapEntry &entry)
+{
+    auto it = tasks.find(entry.second);
+    return it == tasks.end() || it->second.next_run != entry.first;
+}
+
+static void drop_stale_locked()
+{
+    while (!task_heap.empty() && is_stale_locked(task_heap.top())) {
+        task_heap.pop();
+    }
+}
+
+// Points the wakeup timer at the earliest live deadline
+static void rearm_locked()
+{
+    drop_stale_locked();
+    if (task_heap.empty()) {
+        scheduler_wakeup.disarm();
+    } else {
+        scheduler_wakeup.arm_at(task_heap.top().first);
+    }
+}
+
+static void restart_grid_locked(TaskHandle handle, ScheduledTask &task, SteadyClock::time_point first_run)
+{
+    task.start = first_run;
+    task.next_index = 0;
+    task.next_run = first_run;
+    task_heap.emplace(first_run, handle);
+    rearm_locked();
+}
+
+static void scheduler_worker()
+{
+    std::unique_lock<std::mutex> lock(task_mutex);
+    while (true) {
+        drop_stale_locked();
+        auto now = SteadyClock::now();
+        if (task_heap.empty() || task_heap.top().first > now) {
+            rearm_locked();
+            lock.unlock();
+            scheduler_wakeup.wait();
+            lock.lock();
+            continue;
+        }
+
+        TaskHandle handle = task_heap.top().second;
+        task_heap.pop();
+        ScheduledTask &task = tasks[handle];
+
+        // Skip grid points that already passed, the task runs once for them
+        uint64_t expirations = 1;
+        if (task.period.count() > 0) {
+            expirations += static_cast<uint64_t>((now - task.next_run) / task.period);
+        }
+        task.next_index += expirations;
+        auto deadline = task.start + task.period * static_cast<int64_t>(task.next_index - 1);
+        auto lateness = std::chrono::duration_cast<std::chrono::microseconds>(now - deadline);
+        if (lateness.count() < 0) {
+            lateness = std::chrono::microseconds(0);
+        }
+
+        LoopTimerStats &stats = stats_by_name[task.name];
+        ++stats.ticks;
+        stats.missed += expirations - 1;
+        stats.last_lateness = lateness;
+        stats.max_lateness = std::max(stats.max_lateness, lateness);
+        stats.total_lateness += lateness;
+
+        task.next_run = task.start + task.period * static_cast<int64_t>(task.next_index);
+        task_heap.emplace(task.next_run, handle);
+
+        // The task may be cancelled or rescheduled while it runs
+        auto fn = task.fn;
+        running_task = handle;
+        lock.unlock();
+        fn();
+        lock.lock();
+        running_task = 0;
+        task_done_cv.notify_all();
+    }
+}
+
+static void start_scheduler()
+{
+    static std::once_flag scheduler_once;
+    std::call_once(scheduler_once, []() {
+        std::thread worker(scheduler_worker);
+        scheduler_thread_id = worker.get_id();
+        worker.detach();
+    });
+}
+
+TaskHandle schedule_periodic_task(const std::string &name, std::chrono::nanoseconds period,
+                                  std::function<void()> fn, std::chrono::nanoseconds first_delay)
+{
+    start_scheduler();
+
+    std::lock_guard<std::mutex> lock(task_mutex);
+    TaskHandle handle = next_task_handle++;
+    ScheduledTask &task = tasks[handle];
+    task.name = name;
+    task.period = period;
+    task.fn = std::move(fn);
+    restart_grid_locked(handle, task, SteadyClock::now() + first_delay);
+    return handle;
+}
+
+void cancel_task(TaskHandle handle)
+{
+    std::unique_lock<std::mutex> lock(task_mutex);
+    if (tasks.erase(handle) == 0) {
+        return;
+    }
+    rearm_locked();
+    if (std::this_thread::get_id() != scheduler_thread_id) {
+        task_done_cv.wait(lock, [handle] { return running_task != handle; });
+    }
+}
+
+void reschedule_task(TaskHandle handle, std::chrono::nanoseconds period, std::chrono::nanoseconds first_delay)
+{
+    std::lock_guard<std::mutex> lock(task_mutex);
+    auto it = tasks.find(handle);
+    if (it == tasks.end()) {
+        return;
+    }
+    it->second.period = period;
+    restart_grid_locked(handle, it->second, SteadyClock::now() + first_delay);
+}
+
+void run_task_now(TaskHandle handle)
+{
+    std::lock_guard<std::mutex> lock(task_mutex);
+    auto it = tasks.find(handle);
+    if (it == tasks.end()) {
+        return;
+    }
+    restart_grid_locked(handle, it->second, SteadyClock::now());
+}
+
+LoopTimerStats task_stats(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(task_mutex);
+    auto it = stats_by_name.find(name);
+    return it == stats_by_name.end() ? LoopTimerStats() : it->second;
+}
+
+size_t scheduled_task_count()
+{
+    std::lock_guard<std::mutex> lock(task_mutex);
+    return tasks.size();
+}
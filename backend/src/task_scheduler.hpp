@@ -0,0 +1,39 @@
+#ifndef TASK_SCHEDULER_HPP
+#define TASK_SCHEDULER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "loop_timer.hpp"
+
+// Identifies a scheduled task; 0 is never a valid handle
+using TaskHandle = uint64_t;
+
+// Runs every periodic background job (sampling, mode re-assert, BETTER_AUTO
+// ticks) on one thread, ordered by a min-heap of deadlines. Each task ticks
+// on its own fixed grid; if the thread fell behind, missed grid points are
+// skipped. Tasks run one at a time, so they must not block for long.
+TaskHandle schedule_periodic_task(const std::string &name, std::chrono::nanoseconds period,
+                                  std::function<void()> fn,
+                                  std::chrono::nanoseconds first_delay = std::chrono::nanoseconds(0));
+
+// Removes the task. If it is running right now, waits for that run to
+// finish, unless called from the task itself. Unknown handles are ignored.
+void cancel_task(TaskHandle handle);
+
+// Restarts the task's grid with a new period, first run after first_delay
+void reschedule_task(TaskHandle handle, std::chrono::nanoseconds period,
+                     std::chrono::nanoseconds first_delay = std::chrono::nanoseconds(0));
+
+// Runs the task as soon as the scheduler is free; its grid restarts there
+void run_task_now(TaskHandle handle);
+
+// Runs and lateness, summed over every task scheduled under name
+LoopTimerStats task_stats(const std::string &name);
+
+size_t scheduled_task_count();
+
+#endif // TASK_SCHEDULER_HPP
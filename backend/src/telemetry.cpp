@@ -0,0 +1,322 @@
+#include <iostream>
+#include <mutex>
+#include <cerrno>
+#include <sstream>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <cstring>
+#include <sensors/sensors.h>
+#include <sensors/error.h>
+
+#include "telemetry.hpp"
+#include "sensor_reader.hpp"
+#include "util.hpp"
+#include "fan.hpp"
+#include "task_scheduler.hpp"
+#include "metrics.hpp"
+
+enum class SensorKind {
+    Package,
+    Core,
+    Nvme,
+    Other
+};
+
+// libsensors temperature inputs, enumerated once instead of on every request
+struct SensorEntry {
+    const sensors_chip_name *chip;
+    int subfeature;
+    SensorKind kind;
+};
+
+static std::once_flag sensor_entries_once;
+static std::vector<SensorEntry> sensor_entries;
+
+static std::mutex snapshot_mutex;
+static std::shared_ptr<const TelemetrySnapshot> published_snapshot = std::make_shared<TelemetrySnapshot>();
+
+static std::mutex sampler_mutex;
+static std::chrono::milliseconds sampler_interval = kTelemetryDefaultInterval;
+static TaskHandle sampler_task = 0;
+static int sampler_event_fd = -1;
+
+// fanN_input readers, reopened when the hwmon directory changes
+static std::array<SensorReader, 2> fan_input_readers;
+static unsigned long fan_input_generation = 0;
+
+static void enumerate_sensor_entries()
+{
+    sensors_init(nullptr);
+
+    const sensors_chip_name *chip;
+    int chip_nr = 0;
+
+    while ((chip = sensors_get_detected_chips(nullptr, &chip_nr)) != nullptr) {
+        const char *prefix = chip->prefix;
+        const bool is_coretemp = prefix && std::string(prefix).rfind("core", 0) == 0;
+        const bool is_nvme = prefix && std::string(prefix).rfind("nvme", 0) == 0;
+        bool nvme_added = false;
+
+        const sensors_feature *feature;
+        int feature_nr = 0;
+
+        while ((feature = sensors_get_features(chip, &feature_nr)) != nullptr) {
+            if (feature->type != SENSORS_FEATURE_TEMP) {
+                continue;
+            }
+
+            const sensors_subfeature *subfeature;
+            int subfeature_nr = 0;
+
+            while ((subfeature = sensors_get_all_subfeatures(chip, feature, &subfeature_nr)) != nullptr) {
+                if (subfeature->type != SENSORS_SUBFEATURE_TEMP_INPUT) {
+                    continue;
+                }
+
+                SensorKind kind = SensorKind::Other;
+                if (is_coretemp) {
+                    kind = (feature_nr == 1) ? SensorKind::Package : SensorKind::Core;
+                } else if (is_nvme) {
+                    // Only the composite (first) temperature of each drive
+                    if (nvme_added) {
+                        continue;
+                    }
+                    kind = SensorKind::Nvme;
+                    nvme_added = true;
+                }
+                sensor_entries.push_back({chip, subfeature->number, kind});
+            }
+        }
+    }
+
+    std::cout << "telemetry: tracking " << sensor_entries.size() << " libsensors temperature inputs" << std::endl;
+}
+
+static void sample_sensors(TelemetrySnapshot &snapshot)
+{
+    std::call_once(sensor_entries_once, enumerate_sensor_entries);
+
+    static LatencyHistogram &libsensors_latency = metrics_histogram("LIBSENSORS_READ");
+    ScopedLatency timer(libsensors_latency);
+
+    for (const auto &entry : sensor_entries) {
+        double temp_val;
+        if (sensors_get_value(entry.chip, entry.subfeature, &temp_val) != 0 || temp_val < 0 || temp_val > 150) {
+            continue;
+        }
+
+        int temp_int = static_cast<int>(temp_val);
+        if (!snapshot.cpu_temp) {
+            snapshot.cpu_temp = temp_int;
+        }
+
+        switch (entry.kind) {
+        case SensorKind::Package:
+            if (!snapshot.pkg_temp) {
+                snapshot.pkg_temp = temp_int;
+            }
+            break;
+        case SensorKind::Core:
+            snapshot.core_temps.push_back(temp_int);
+            break;
+        case SensorKind::Nvme:
+            snapshot.nvme_temps.push_back(temp_int);
+            break;
+        case SensorKind::Other:
+            break;
+        }
+    }
+}
+
+static void sample_fans(TelemetrySnapshot &snapshot)
+{
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        unsigned long generation = hwmon_generation();
+        std::string hwmon_path = hwmon_directory();
+        snapshot.hwmon_found = !hwmon_path.empty();
+        if (!snapshot.hwmon_found) {
+            return;
+        }
+
+        if (generation != fan_input_generation) {
+            for (auto &reader : fan_input_readers) {
+                reader.close();
+            }
+            fan_input_generation = generation;
+        }
+
+        bool vanished = false;
+        for (size_t i = 0; i < fan_input_readers.size(); ++i) {
+            SensorReader &reader = fan_input_readers[i];
+            reader.set_path(hwmon_path + "/fan" + std::to_string(i + 1) + "_input");
+            auto value = reader.read_integer();
+            if (value) {
+                snapshot.fan_rpm[i] = static_cast<int>(*value);
+            } else if (errno == ENOENT) {
+                vanished = true;
+            }
+        }
+
+        if (!vanished || attempt > 0) {
+            return;
+        }
+        // Cached directory vanished (driver reloaded), rescan once
+        invalidate_hwmon_directory();
+    }
+}
+
+static void sample_once()
+{
+    static LatencyHistogram &sample_latency = metrics_histogram("TELEMETRY_SAMPLE");
+    ScopedLatency timer(sample_latency);
+
+    auto snapshot = std::make_shared<TelemetrySnapshot>();
+    snapshot->thermal = collect_snapshot();
+    snapshot->fan_mode = read_fan_mode();
+    sample_fans(*snapshot);
+    sample_sensors(*snapshot);
+
+    snapshot->sampled_at = std::chrono::steady_clock::now();
+    snapshot->timestamp_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        published_snapshot = std::move(snapshot);
+    }
+
+    if (sampler_event_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(sampler_event_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void start_telemetry_sampler()
+{
+    static std::once_flag sampler_once;
+    std::call_once(sampler_once, []() {
+        sampler_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (sampler_event_fd < 0) {
+            std::cerr << "telemetry: eventfd failed, subscriptions will not be pushed: " << strerror(errno) << std::endl;
+        }
+        sample_once();
+        std::lock_guard<std::mutex> lock(sampler_mutex);
+        sampler_task = schedule_periodic_task("SAMPLE", sampler_interval, sample_once, sampler_interval);
+        std::cout << "telemetry: sampling every " << sampler_interval.count() << " ms" << std::endl;
+    });
+}
+
+std::string set_telemetry_interval(std::chrono::milliseconds interval)
+{
+    if (interval < kTelemetryMinInterval || interval > kTelemetryMaxInterval) {
+        return "ERROR: Invalid sample interval " + std::to_string(interval.count()) + " (valid range: " +
+               std::to_string(kTelemetryMinInterval.count()) + "-" + std::to_string(kTelemetryMaxInterval.count()) + " ms)";
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sampler_mutex);
+        sampler_interval = interval;
+        // New rate: restart the wait instead of sampling early
+        reschedule_task(sampler_task, interval, interval);
+    }
+    std::cout << "telemetry: sampling every " << interval.count() << " ms" << std::endl;
+    return "OK";
+}
+
+void request_telemetry_sample()
+{
+    std::lock_guard<std::mutex> lock(sampler_mutex);
+    run_task_now(sampler_task);
+}
+
+int telemetry_event_fd()
+{
+    return sampler_event_fd;
+}
+
+std::chrono::milliseconds telemetry_interval()
+{
+    std::lock_guard<std::mutex> lock(sampler_mutex);
+    return sampler_interval;
+}
+
+std::shared_ptr<const TelemetrySnapshot> latest_telemetry()
+{
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    return published_snapshot;
+}
+
+std::string with_sample_timestamp(const std::string &value, const TelemetrySnapshot &snapshot)
+{
+    return value + "|TS:" + std::to_string(snapshot.timestamp_ms);
+}
+
+std::optional<unsigned> parse_telemetry_fields(const std::string &list)
+{
+    unsigned fields = 0;
+    std::stringstream ss(list);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        if (name == "ALL") {
+            fields |= kFieldAll;
+        } else if (name == "MODE") {
+            fields |= kFieldMode;
+        } else if (name == "FAN1") {
+            fields |= kFieldFan1;
+        } else if (name == "FAN2") {
+            fields |= kFieldFan2;
+        } else if (name == "CPU") {
+            fields |= kFieldCpu;
+        } else if (name == "TEMPS") {
+            fields |= kFieldTemps;
+        } else {
+            return std::nullopt;
+        }
+    }
+    if (fields == 0) {
+        return std::nullopt;
+    }
+    return fields;
+}
+
+static std::string join_temps(const std::vector<int> &values)
+{
+    std::string joined;
+    for (int value : values) {
+        if (!joined.empty()) joined += ",";
+        joined += std::to_string(value);
+    }
+    return joined;
+}
+
+std::vector<std::pair<std::string, std::string>> telemetry_sections(const TelemetrySnapshot &snapshot, unsigned fields)
+{
+    std::vector<std::pair<std::string, std::string>> sections;
+    auto optional_value = [](const std::optional<int> &value) {
+        return value ? std::to_string(*value) : std::string("N/A");
+    };
+
+    if (fields & kFieldMode) {
+        sections.emplace_back("MODE", snapshot.fan_mode);
+    }
+    if (fields & kFieldFan1) {
+        sections.emplace_back("FAN1", optional_value(snapshot.fan_rpm[0]));
+    }
+    if (fields & kFieldFan2) {
+        sections.emplace_back("FAN2", optional_value(snapshot.fan_rpm[1]));
+    }
+    if (fields & kFieldCpu) {
+        std::optional<int> cpu = snapshot.cpu_temp;
+        if (!cpu && snapshot.thermal.cpu_temp_c) {
+            cpu = static_cast<int>(*snapshot.thermal.cpu_temp_c);
+        }
+        sections.emplace_back("CPU", optional_value(cpu));
+    }
+    if (fields & kFieldTemps) {
+        sections.emplace_back("PKG", snapshot.pkg_temp ? std::to_string(*snapshot.pkg_temp) : std::string());
+        sections.emplace_back("CORES", join_temps(snapshot.core_temps));
+        sections.emplace_back("NVME", join_temps(snapshot.nvme_temps));
+    }
+    return sections;
+}
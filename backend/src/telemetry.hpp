@@ -0,0 +1,74 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "thermal.hpp"
+
+// Everything the GET_* commands report, sampled by a periodic task on the
+// task scheduler. Commands answer from the latest published snapshot and
+// never touch the hardware themselves.
+struct TelemetrySnapshot {
+    uint64_t timestamp_ms = 0; // wall clock of the sample, 0 before the first one
+    std::chrono::steady_clock::time_point sampled_at;
+
+    ThermalSnapshot thermal;
+
+    std::string fan_mode;
+
+    bool hwmon_found = false;
+    std::array<std::optional<int>, 2> fan_rpm;
+
+    std::optional<int> cpu_temp; // first valid libsensors temperature
+    std::optional<int> pkg_temp; // coretemp package
+    std::vector<int> core_temps;
+    std::vector<int> nvme_temps; // one per drive
+};
+
+static constexpr std::chrono::milliseconds kTelemetryDefaultInterval{1000};
+static constexpr std::chrono::milliseconds kTelemetryMinInterval{100};
+static constexpr std::chrono::milliseconds kTelemetryMaxInterval{60000};
+
+// Fields a client can subscribe to
+enum TelemetryField : unsigned {
+    kFieldMode = 1u << 0,
+    kFieldFan1 = 1u << 1,
+    kFieldFan2 = 1u << 2,
+    kFieldCpu = 1u << 3,
+    kFieldTemps = 1u << 4,
+    kFieldAll = kFieldMode | kFieldFan1 | kFieldFan2 | kFieldCpu | kFieldTemps
+};
+
+// Takes the first sample synchronously, then keeps sampling in the background
+void start_telemetry_sampler();
+
+// Samples right away instead of waiting for the next interval, e.g. after a
+// mode change so subscribers see it immediately
+void request_telemetry_sample();
+
+// Becomes readable (eventfd counter) every time a new snapshot is published
+int telemetry_event_fd();
+
+std::string set_telemetry_interval(std::chrono::milliseconds interval);
+std::chrono::milliseconds telemetry_interval();
+
+std::shared_ptr<const TelemetrySnapshot> latest_telemetry();
+
+// Appends "|TS:<ms>" so clients can tell how old a value is
+std::string with_sample_timestamp(const std::string &value, const TelemetrySnapshot &snapshot);
+
+// Parses "MODE,FAN1,FAN2,CPU,TEMPS" or "ALL"; nullopt on unknown names
+std::optional<unsigned> parse_telemetry_fields(const std::string &list);
+
+// KEY:value sections for the selected fields. Every key is always present
+// (empty or N/A when unavailable) so a delta can clear a value.
+std::vector<std::pair<std::string, std::string>> telemetry_sections(const TelemetrySnapshot &snapshot, unsigned fields);
+
+#endif // TELEMETRY_HPP
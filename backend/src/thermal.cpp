@@ -0,0 +1,381 @@
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <dirent.h>
+#include <cctype>
+#include <array>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+#include "thermal.hpp"
+#include "sensor_reader.hpp"
+#include "sensor_filter.hpp"
+#include "config.hpp"
+#include "util.hpp"
+
+static std::once_flag cpu_sensor_once;
+static std::once_flag gpu_sensor_once;
+static std::once_flag gpu_usage_once;
+static std::optional<std::string> cpu_temp_path;
+static std::optional<std::string> gpu_temp_path;
+static std::optional<std::string> gpu_busy_path;
+static std::atomic<bool> cpu_sensor_warned(false);
+static std::atomic<bool> gpu_sensor_warned(false);
+static std::atomic<bool> gpu_usage_warned(false);
+
+struct CpuSampleTimes {
+    unsigned long long idle;
+    unsigned long long total;
+};
+static std::mutex cpu_usage_mutex;
+static std::optional<CpuSampleTimes> previous_cpu_times;
+
+// Open-once readers for the BETTER_AUTO sampling path
+static std::mutex sensor_reader_mutex;
+static SensorReader cpu_temp_reader;
+static SensorReader gpu_temp_reader;
+static SensorReader gpu_busy_reader;
+static SensorReader proc_stat_reader(fs_path("/proc/stat"));
+// CPU, GPU; only used by collect_snapshot() under sensor_reader_mutex
+static std::array<SensorFilter, 2> temp_filters;
+
+static std::string to_lower_copy(const std::string &input)
+{
+    std::string lowered = input;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return lowered;
+}
+
+static std::optional<std::string> find_thermal_zone_by_type(const std::vector<std::string> &hints)
+{
+    std::string class_path = fs_path("/sys/class/thermal");
+    DIR *dir = opendir(class_path.c_str());
+    if (!dir) {
+        return std::nullopt;
+    }
+
+    std::optional<std::string> fallback;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        if (std::strncmp(entry->d_name, "thermal_zone", 12) != 0) {
+            continue;
+        }
+
+        std::string base_path = class_path + "/" + entry->d_name;
+        std::ifstream type_file(base_path + "/type");
+        if (!type_file) {
+            continue;
+        }
+
+        std::string sensor_type;
+        std::getline(type_file, sensor_type);
+        std::string lowered = to_lower_copy(sensor_type);
+
+        if (!fallback) {
+            fallback = base_path + "/temp";
+        }
+
+        for (const auto &hint : hints) {
+            if (lowered.find(hint) != std::string::npos) {
+                closedir(dir);
+                return base_path + "/temp";
+            }
+        }
+    }
+
+    closedir(dir);
+    return fallback;
+}
+
+static std::optional<std::string> find_hwmon_temp_sensor(const std::vector<std::string> &name_hints,
+                                                         const std::vector<std::string> &label_hints)
+{
+    std::string class_path = fs_path("/sys/class/hwmon");
+    DIR *dir = opendir(class_path.c_str());
+    if (!dir) {
+        return std::nullopt;
+    }
+
+    std::optional<std::string> fallback;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        if (std::strncmp(entry->d_name, "hwmon", 5) != 0) {
+            continue;
+        }
+
+        std::string base_path = class_path + "/" + entry->d_name;
+        std::string name_path = base_path + "/name";
+        std::ifstream name_file(name_path);
+        std::string name_value;
+        if (name_file) {
+            std::getline(name_file, name_value);
+        }
+        std::string lowered_name = to_lower_copy(name_value);
+
+        bool name_matches = false;
+        for (const auto &hint : name_hints) {
+            if (!hint.empty() && lowered_name.find(hint) != std::string::npos) {
+                name_matches = true;
+                break;
+            }
+        }
+
+        DIR *inner = opendir(base_path.c_str());
+        if (!inner) {
+            continue;
+        }
+
+        std::vector<std::string> input_candidates;
+        struct dirent *inner_entry;
+        while ((inner_entry = readdir(inner)) != nullptr)
+        {
+            std::string file_name = inner_entry->d_name;
+            if (file_name.rfind("temp", 0) != 0) {
+                continue;
+            }
+            if (file_name.find("_input") == std::string::npos) {
+                continue;
+            }
+
+            std::string input_path = base_path + "/" + file_name;
+            input_candidates.push_back(input_path);
+
+            std::string prefix = file_name.substr(0, file_name.find("_input"));
+            std::string label_path = base_path + "/" + prefix + "_label";
+
+            std::ifstream label_file(label_path);
+            if (label_file) {
+                std::string label_value;
+                std::getline(label_file, label_value);
+                std::string lowered_label = to_lower_copy(label_value);
+
+                for (const auto &hint : label_hints) {
+                    if (!hint.empty() && lowered_label.find(hint) != std::string::npos) {
+                        closedir(inner);
+                        closedir(dir);
+                        return input_path;
+                    }
+                }
+            }
+        }
+        closedir(inner);
+
+        if (name_matches && !input_candidates.empty()) {
+            closedir(dir);
+            return input_candidates.front();
+        }
+
+        if (!fallback && !input_candidates.empty()) {
+            fallback = input_candidates.front();
+        }
+    }
+
+    closedir(dir);
+    return fallback;
+}
+
+static std::optional<std::string> locate_cpu_temp_sensor()
+{
+    std::call_once(cpu_sensor_once, []() {
+        const std::vector<std::string> hwmon_name_hints = {"k10temp", "coretemp", "zenpower", "cpu", "package", "soc"};
+        const std::vector<std::string> hwmon_label_hints = {"cpu", "package", "soc"};
+        cpu_temp_path = find_hwmon_temp_sensor(hwmon_name_hints, hwmon_label_hints);
+
+        if (!cpu_temp_path) {
+            const std::vector<std::string> zone_hints = {"x86_pkg", "tctl", "cpu", "soc"};
+            cpu_temp_path = find_thermal_zone_by_type(zone_hints);
+        }
+
+        if (!cpu_temp_path && !cpu_sensor_warned.exchange(true)) {
+            std::cerr << "better-auto: CPU thermal sensor not found; automatic mode will use default fan steps" << std::endl;
+        }
+    });
+    return cpu_temp_path;
+}
+
+static std::optional<std::string> locate_gpu_temp_sensor()
+{
+    std::call_once(gpu_sensor_once, []() {
+        const std::vector<std::string> hwmon_name_hints = {"amdgpu", "radeon", "nvidia", "gpu"};
+        const std::vector<std::string> hwmon_label_hints = {"edge", "gpu", "junction", "hotspot"};
+        gpu_temp_path = find_hwmon_temp_sensor(hwmon_name_hints, hwmon_label_hints);
+
+        if (!gpu_temp_path) {
+            const std::vector<std::string> zone_hints = {"gpu", "amdgpu", "nvidia"};
+            gpu_temp_path = find_thermal_zone_by_type(zone_hints);
+        }
+
+        if (!gpu_temp_path && !gpu_sensor_warned.exchange(true)) {
+            std::cerr << "better-auto: GPU thermal sensor not found; automatic mode will rely on CPU temperature" << std::endl;
+        }
+    });
+    return gpu_temp_path;
+}
+
+static std::optional<std::string> locate_gpu_busy_file()
+{
+    std::call_once(gpu_usage_once, []() {
+        std::string class_path = fs_path("/sys/class/drm");
+        DIR *dir = opendir(class_path.c_str());
+        if (!dir) {
+            if (!gpu_usage_warned.exchange(true)) {
+                std::cerr << "better-auto: /sys/class/drm unavailable; GPU usage tracking disabled" << std::endl;
+            }
+            return;
+        }
+
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr)
+        {
+            if (std::strncmp(entry->d_name, "card", 4) != 0) {
+                continue;
+            }
+
+            std::string candidate = class_path + "/" + entry->d_name + "/device/gpu_busy_percent";
+            std::ifstream test(candidate);
+            if (test)
+            {
+                gpu_busy_path = candidate;
+                break;
+            }
+        }
+
+        closedir(dir);
+        if (!gpu_busy_path && !gpu_usage_warned.exchange(true)) {
+            std::cerr << "better-auto: GPU usage source not found; automatic mode will use temperature only" << std::endl;
+        }
+    });
+    return gpu_busy_path;
+}
+
+static std::optional<double> read_temperature_celsius(SensorReader &reader, const std::optional<std::string> &path)
+{
+    if (!path) {
+        return std::nullopt;
+    }
+
+    reader.set_path(*path);
+    auto value = reader.read_integer();
+    if (!value) {
+        return std::nullopt;
+    }
+
+    return static_cast<double>(*value) / 1000.0;
+}
+
+// Parses the aggregate "cpu  user nice system idle iowait irq softirq steal" line
+static bool parse_cpu_times(std::string_view line, std::array<unsigned long long, 8> &fields)
+{
+    if (line.size() < 4 || line.substr(0, 3) != "cpu" || line[3] != ' ') {
+        return false;
+    }
+
+    const char *ptr = line.data() + 3;
+    const char *end = line.data() + line.size();
+    for (auto &field : fields) {
+        while (ptr < end && *ptr == ' ') {
+            ++ptr;
+        }
+        auto [next, ec] = std::from_chars(ptr, end, field);
+        if (ec != std::errc()) {
+            return false;
+        }
+        ptr = next;
+    }
+    return true;
+}
+
+// Caller holds sensor_reader_mutex (proc_stat_reader)
+static std::optional<double> read_cpu_usage_pct_locked()
+{
+    // The first line is all we need; it always fits in this buffer
+    char buffer[512];
+    ssize_t length = proc_stat_reader.read(buffer, sizeof(buffer));
+    if (length <= 0) {
+        return std::nullopt;
+    }
+
+    std::string_view contents(buffer, static_cast<size_t>(length));
+    std::string_view line = contents.substr(0, contents.find('\n'));
+
+    std::array<unsigned long long, 8> fields{};
+    if (!parse_cpu_times(line, fields)) {
+        return std::nullopt;
+    }
+    auto [user, nice, system, idle, iowait, irq, softirq, steal] = fields;
+
+    unsigned long long idle_all = idle + iowait;
+    unsigned long long non_idle = user + nice + system + irq + softirq + steal;
+    unsigned long long total = idle_all + non_idle;
+
+    std::lock_guard<std::mutex> lock(cpu_usage_mutex);
+    if (!previous_cpu_times) {
+        previous_cpu_times = CpuSampleTimes{idle_all, total};
+        return std::nullopt; // need a baseline before reporting usage
+    }
+
+    unsigned long long total_diff = total - previous_cpu_times->total;
+    unsigned long long idle_diff = idle_all - previous_cpu_times->idle;
+    previous_cpu_times = CpuSampleTimes{idle_all, total};
+
+    if (total_diff == 0) {
+        return std::nullopt;
+    }
+
+    double usage = static_cast<double>(total_diff - idle_diff) / static_cast<double>(total_diff);
+    return usage * 100.0;
+}
+
+std::optional<double> read_cpu_usage_pct()
+{
+    std::lock_guard<std::mutex> lock(sensor_reader_mutex);
+    return read_cpu_usage_pct_locked();
+}
+
+static std::optional<double> read_gpu_usage_pct()
+{
+    auto path = locate_gpu_busy_file();
+    if (!path) {
+        return std::nullopt;
+    }
+
+    gpu_busy_reader.set_path(*path);
+    auto value = gpu_busy_reader.read_integer();
+    if (!value) {
+        return std::nullopt;
+    }
+
+    return static_cast<double>(*value);
+}
+
+ThermalSnapshot collect_snapshot()
+{
+    auto config = backend_config();
+    ThermalSnapshot snapshot;
+    {
+        std::lock_guard<std::mutex> lock(sensor_reader_mutex);
+        snapshot.cpu_temp_raw_c = read_temperature_celsius(cpu_temp_reader, locate_cpu_temp_sensor());
+        snapshot.gpu_temp_raw_c = read_temperature_celsius(gpu_temp_reader, locate_gpu_temp_sensor());
+        snapshot.cpu_usage_pct = read_cpu_usage_pct_locked();
+        snapshot.gpu_usage_pct = read_gpu_usage_pct();
+
+        auto now = std::chrono::steady_clock::now();
+        if (snapshot.cpu_temp_raw_c) {
+            snapshot.cpu_temp_c = temp_filters[0].update(*snapshot.cpu_temp_raw_c, now, config->temp_filters[0]);
+        }
+        if (snapshot.gpu_temp_raw_c) {
+            snapshot.gpu_temp_c = temp_filters[1].update(*snapshot.gpu_temp_raw_c, now, config->temp_filters[1]);
+        }
+    }
+    
+    return snapshot;
+}
@@ -0,0 +1,27 @@
+#ifndef THERMAL_HPP
+#define THERMAL_HPP
+
+#include <optional>
+
+// CPU/GPU temperature and usage used by the automatic fan modes. The sensor
+// files are located once and then read through open-once SensorReaders.
+// Temperatures go through each sensor's filter chain (see backend.conf);
+// the *_raw_c fields keep the value as read.
+struct ThermalSnapshot {
+    std::optional<double> cpu_temp_c;
+    std::optional<double> gpu_temp_c;
+    std::optional<double> cpu_temp_raw_c;
+    std::optional<double> gpu_temp_raw_c;
+    std::optional<double> cpu_usage_pct;
+    std::optional<double> gpu_usage_pct;
+};
+
+// CPU usage is a delta against the previous call, so the first call after
+// startup reports no usage
+ThermalSnapshot collect_snapshot();
+
+// The /proc/stat part of collect_snapshot(); shares its baseline and its
+// reader lock, so it is safe to call next to the sampler
+std::optional<double> read_cpu_usage_pct();
+
+#endif // THERMAL_HPP
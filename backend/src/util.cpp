@@ -1,6 +1,41 @@
 #include "util.hpp"
 #include <dirent.h>
 #include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+const std::string &fs_root()
+{
+	static const std::string root = []() {
+		const char *value = std::getenv("VICTUS_FS_ROOT");
+		std::string path = value ? value : "";
+		while (!path.empty() && path.back() == '/')
+		{
+			path.pop_back();
+		}
+		return path;
+	}();
+	return root;
+}
+
+std::string fs_path(const std::string &path)
+{
+	return fs_root() + path;
+}
+
+std::string run_path(const std::string &name)
+{
+	const char *dir = std::getenv("VICTUS_RUN_DIR");
+	return std::string(dir && *dir ? dir : RUN_DIR) + "/" + name;
+}
 
 std::string find_hwmon_directory(const std::string &base_path)
 {
@@ -35,3 +70,123 @@ std::string find_hwmon_directory(const std::string &base_path)
 	}
 	return hwmon_path;
 }
+
+static std::mutex hwmon_cache_mutex;
+static std::string hwmon_cache;
+static std::atomic<unsigned long> hwmon_cache_generation{0};
+
+std::string hwmon_directory()
+{
+	std::lock_guard<std::mutex> lock(hwmon_cache_mutex);
+	if (hwmon_cache.empty())
+	{
+		// Not cached while missing so the driver showing up later is noticed
+		hwmon_cache = find_hwmon_directory(fs_path(HP_WMI_HWMON_BASE));
+	}
+	return hwmon_cache;
+}
+
+void invalidate_hwmon_directory()
+{
+	std::lock_guard<std::mutex> lock(hwmon_cache_mutex);
+	hwmon_cache.clear();
+	hwmon_cache_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+unsigned long hwmon_generation()
+{
+	return hwmon_cache_generation.load(std::memory_order_acquire);
+}
+
+// Kernel uevents look like "add@/devices/platform/hp-wmi/hwmon/hwmon5\0ACTION=add\0..."
+static bool is_hp_wmi_uevent(const char *buffer, size_t length)
+{
+	std::string header(buffer, strnlen(buffer, length));
+	size_t at = header.find('@');
+	if (at == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string action = header.substr(0, at);
+	if (action != "add" && action != "remove" && action != "bind" && action != "unbind")
+	{
+		return false;
+	}
+	return header.find("/hp-wmi", at) != std::string::npos;
+}
+
+static void hwmon_uevent_worker(int sock)
+{
+	char buffer[8192];
+	while (true)
+	{
+		ssize_t received = recv(sock, buffer, sizeof(buffer) - 1, 0);
+		if (received < 0)
+		{
+			if (errno == EINTR || errno == ENOBUFS)
+			{
+				// ENOBUFS means events were lost, so assume the driver changed
+				if (errno == ENOBUFS)
+				{
+					invalidate_hwmon_directory();
+				}
+				continue;
+			}
+			std::cerr << "hwmon uevent monitor stopped: " << strerror(errno) << std::endl;
+			break;
+		}
+		buffer[received] = '\0';
+
+		if (is_hp_wmi_uevent(buffer, static_cast<size_t>(received)))
+		{
+			std::cout << "hp-wmi uevent: " << buffer << ", rescanning hwmon directory" << std::endl;
+			invalidate_hwmon_directory();
+		}
+	}
+	close(sock);
+}
+
+void start_hwmon_uevent_monitor()
+{
+	static std::once_flag monitor_once;
+	std::call_once(monitor_once, []() {
+		int sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+		if (sock < 0)
+		{
+			std::cerr << "Unable to open uevent socket, hwmon cache will only refresh on errors: " << strerror(errno) << std::endl;
+			return;
+		}
+
+		struct sockaddr_nl addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.nl_family = AF_NETLINK;
+		addr.nl_groups = 1; // kernel events
+		if (bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+		{
+			std::cerr << "Unable to bind uevent socket, hwmon cache will only refresh on errors: " << strerror(errno) << std::endl;
+			close(sock);
+			return;
+		}
+
+		std::thread(hwmon_uevent_worker, sock).detach();
+	});
+}
+
+int process_thread_count()
+{
+	DIR *dir = opendir("/proc/self/task");
+	if (!dir) {
+		return -1;
+	}
+
+	int count = 0;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != nullptr) {
+		if (entry->d_name[0] != '.') {
+			++count;
+		}
+	}
+	closedir(dir);
+	return count;
+}
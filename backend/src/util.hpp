@@ -1,3 +1,32 @@
+#ifndef UTIL_HPP
+#define UTIL_HPP
+
 #include <string>
 
-std::string find_hwmon_directory(const std::string &base_path);
\ No newline at end of file
+#define HP_WMI_HWMON_BASE "/sys/devices/platform/hp-wmi/hwmon"
+#define RUN_DIR "/run/victus-control"
+
+// Prefix for the /sys and /proc paths the backend reads and writes, from
+// VICTUS_FS_ROOT (empty on real hardware), so an emulated tree such as
+// victus-hpwmi-emu's can stand in for the machine
+const std::string &fs_root();
+// fs_root() + path, path being absolute
+std::string fs_path(const std::string &path);
+// RUN_DIR, or VICTUS_RUN_DIR when set; the socket and control trace live here
+std::string run_path(const std::string &name);
+
+std::string find_hwmon_directory(const std::string &base_path);
+
+// Process-wide cached find_hwmon_directory(fs_path(HP_WMI_HWMON_BASE)). Only rescans
+// after invalidate_hwmon_directory(), which the uevent monitor calls when
+// the hp-wmi driver is (re)bound and callers use when a file vanished.
+std::string hwmon_directory();
+void invalidate_hwmon_directory();
+// Bumped on every invalidation so holders of open descriptors can notice
+unsigned long hwmon_generation();
+void start_hwmon_uevent_monitor();
+
+// Threads of this process (entries in /proc/self/task), -1 on error
+int process_thread_count();
+
+#endif // UTIL_HPP
@@ -0,0 +1,284 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <exception>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.hpp"
+#include "server.hpp"
+#include "util.hpp"
+
+// victus-bench: load generator for the backend socket. Each of N
+// connections sends one command at a time from a weighted mix and waits
+// for the reply; latencies go into a histogram per command.
+//
+//   victus-bench [--socket PATH] [--connections N] [--duration S]
+//                [--mix get|mode|profile|"CMD=WEIGHT[xBURST],..."]
+//
+// Prints "MIX:..|CONNECTIONS:..|REQUESTS:..|OPS_PER_S:..|ERRORS:..|FAILURES:.."
+// and one "CMD:..|COUNT:..|ERRORS:..|P50_US:..|P99_US:..|P999_US:..|MAX_US:.."
+// line per command. ERRORS are "ERROR: ..." replies; FAILURES are dropped
+// connections, bad frames and replies slower than the timeout, and make
+// the exit status 1, so a long run doubles as a soak test. The SET mixes
+// change the fan mode and curves: run them against victus-hpwmi-emu.
+
+static constexpr std::chrono::seconds kReplyTimeout{10};
+static constexpr uint32_t kMaxReplyLength = 1 << 20;
+
+struct MixEntry {
+    std::string command;
+    unsigned weight = 1;
+    unsigned burst = 1; // sent back to back each time the entry is picked
+};
+
+struct CommandStats {
+    LatencyHistogram latency;
+    MetricCounter errors;
+};
+
+static const std::map<std::string, std::string> kBuiltinMixes = {
+    // What the frontend and a status bar poll
+    {"get", "GET_STATUS=4,GET_FAN_MODE=2,GET_ALL_TEMPS=2,GET_THERMAL=1,GET_FAN_SPEED 1=1,GET_CPU_TEMP=1"},
+    // Mode changes racing status reads: mode_mutex against fan_state_mutex
+    {"mode", "GET_STATUS=6,GET_FAN_MODE=2,SET_FAN_MODE BETTER_AUTO=1,SET_FAN_MODE AUTO=1,SET_FAN_MODE MAX=1"},
+    // Curve edits dragged around in the UI arrive as bursts
+    {"profile", "GET_STATUS=8,SET_FAN_PROFILE FAN1 40 1500 70 4500 FAN2 40 1800 70 4800=1x8,"
+                "SET_FAN_PROFILE 45 2000 60 3000 80 5500=1x8,SET_FAN_MODE BETTER_AUTO=1"},
+};
+
+// "CMD=WEIGHT[xBURST],..."; commands may contain spaces but not ',' or '='
+static bool parse_mix(const std::string &text, std::vector<MixEntry> &mix)
+{
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string item = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        start = comma == std::string::npos ? text.size() + 1 : comma + 1;
+        if (item.empty()) {
+            continue;
+        }
+
+        MixEntry entry;
+        size_t equals = item.rfind('=');
+        entry.command = item.substr(0, equals);
+        if (equals != std::string::npos) {
+            std::string weight = item.substr(equals + 1);
+            size_t x = weight.find('x');
+            try {
+                entry.weight = static_cast<unsigned>(std::stoul(weight.substr(0, x)));
+                entry.burst = x == std::string::npos ? 1 : static_cast<unsigned>(std::stoul(weight.substr(x + 1)));
+            } catch (const std::exception &) {
+                return false;
+            }
+        }
+        if (entry.command.empty() || entry.command.size() > kMaxCommandLength || entry.weight == 0 ||
+            entry.burst == 0) {
+            return false;
+        }
+        mix.push_back(entry);
+    }
+    return !mix.empty();
+}
+
+static bool send_all(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static bool recv_all(int fd, char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t received = recv(fd, data, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false; // closed, or SO_RCVTIMEO expired
+        }
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+static int connect_backend(const std::string &path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    struct timeval timeout = {static_cast<time_t>(kReplyTimeout.count()), 0};
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Untagged frame, so the reply is the next frame on the connection
+static bool round_trip(int fd, const std::string &command, std::string &reply)
+{
+    uint32_t length = static_cast<uint32_t>(command.size());
+    std::string frame(reinterpret_cast<const char *>(&length), sizeof(length));
+    frame += command;
+    if (!send_all(fd, frame.data(), frame.size()) || !recv_all(fd, reinterpret_cast<char *>(&length), sizeof(length))) {
+        return false;
+    }
+    if ((length & kFrameTagged) != 0 || length > kMaxReplyLength) {
+        return false;
+    }
+    reply.resize(length);
+    return recv_all(fd, reply.data(), length);
+}
+
+int main(int argc, char **argv)
+{
+    std::string socket_path = run_path(SOCKET_NAME);
+    unsigned connections = 4;
+    std::chrono::duration<double> duration{10.0};
+    std::string mix_name = "get";
+    bool usage_error = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        try {
+            if (arg == "--socket" && has_value) {
+                socket_path = argv[++i];
+            } else if (arg == "--connections" && has_value) {
+                connections = static_cast<unsigned>(std::stoul(argv[++i]));
+            } else if (arg == "--duration" && has_value) {
+                duration = std::chrono::duration<double>(std::stod(argv[++i]));
+            } else if (arg == "--mix" && has_value) {
+                mix_name = argv[++i];
+            } else {
+                usage_error = true;
+            }
+        } catch (const std::exception &) {
+            usage_error = true;
+        }
+    }
+
+    std::vector<MixEntry> mix;
+    auto builtin = kBuiltinMixes.find(mix_name);
+    if (usage_error || connections == 0 || duration.count() <= 0.0 ||
+        !parse_mix(builtin != kBuiltinMixes.end() ? builtin->second : mix_name, mix)) {
+        std::cerr << "Usage: victus-bench [--socket PATH] [--connections N] [--duration S]"
+                     " [--mix get|mode|profile|\"CMD=WEIGHT[xBURST],...\"]" << std::endl;
+        return 2;
+    }
+
+    // One histogram per distinct command, made before the threads start
+    std::map<std::string, std::unique_ptr<CommandStats>> stats;
+    for (const auto &entry : mix) {
+        auto &slot = stats[entry.command];
+        if (!slot) {
+            slot = std::make_unique<CommandStats>();
+        }
+    }
+    std::vector<unsigned> weights;
+    for (const auto &entry : mix) {
+        weights.push_back(entry.weight);
+    }
+
+    std::atomic<uint64_t> failures(0);
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+
+    std::vector<std::thread> threads;
+    for (unsigned c = 0; c < connections; ++c) {
+        threads.emplace_back([&, c]() {
+            std::mt19937 random(c + 1);
+            std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+            std::string reply;
+            int fd = -1;
+            while (std::chrono::steady_clock::now() < deadline) {
+                if (fd < 0 && (fd = connect_backend(socket_path)) < 0) {
+                    failures.fetch_add(1);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    continue;
+                }
+                const MixEntry &entry = mix[pick(random)];
+                CommandStats &command_stats = *stats[entry.command];
+                for (unsigned b = 0; b < entry.burst; ++b) {
+                    auto sent = std::chrono::steady_clock::now();
+                    if (!round_trip(fd, entry.command, reply)) {
+                        // Lost the connection or the reply; start over on a new one
+                        failures.fetch_add(1);
+                        close(fd);
+                        fd = -1;
+                        break;
+                    }
+                    command_stats.latency.record(std::chrono::steady_clock::now() - sent);
+                    if (reply.rfind("ERROR", 0) == 0) {
+                        command_stats.errors.add();
+                    }
+                }
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto us = [](std::chrono::nanoseconds value) {
+        return std::chrono::duration<double, std::micro>(value).count();
+    };
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    for (const auto &[command, command_stats] : stats) {
+        requests += command_stats->latency.count();
+        errors += command_stats->errors.value();
+    }
+
+    char line[512];
+    std::snprintf(line, sizeof(line), "MIX:%s|CONNECTIONS:%u|DURATION_S:%.1f|REQUESTS:%llu|OPS_PER_S:%.0f|ERRORS:%llu|FAILURES:%llu",
+                  builtin != kBuiltinMixes.end() ? mix_name.c_str() : "custom", connections, elapsed_s,
+                  static_cast<unsigned long long>(requests), static_cast<double>(requests) / elapsed_s,
+                  static_cast<unsigned long long>(errors), static_cast<unsigned long long>(failures.load()));
+    std::cout << line << std::endl;
+    for (const auto &[command, command_stats] : stats) {
+        const LatencyHistogram &latency = command_stats->latency;
+        std::snprintf(line, sizeof(line),
+                      "CMD:%s|COUNT:%llu|OPS_PER_S:%.0f|ERRORS:%llu|P50_US:%.0f|P99_US:%.0f|P999_US:%.0f|MAX_US:%.0f",
+                      command.substr(0, 64).c_str(), static_cast<unsigned long long>(latency.count()),
+                      static_cast<double>(latency.count()) / elapsed_s,
+                      static_cast<unsigned long long>(command_stats->errors.value()),
+                      us(latency.percentile(0.5)), us(latency.percentile(0.99)), us(latency.percentile(0.999)),
+                      us(latency.max()));
+        std::cout << line << std::endl;
+    }
+    return failures.load() == 0 ? 0 : 1;
+}
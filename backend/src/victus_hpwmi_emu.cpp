@@ -0,0 +1,87 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <exception>
+#include <algorithm>
+
+#include "hp_wmi_emulator.hpp"
+
+// victus-hpwmi-emu: builds an emulated hp-wmi machine under ROOT and runs
+// it until SIGINT/SIGTERM, so the backend can run on any Linux box:
+//
+//   victus-hpwmi-emu /tmp/victus [--cpu-load PCT] [--gpu-load PCT]
+//                    [--manual-timeout S] [--fan-gap MS] [--period MS]
+//   VICTUS_FS_ROOT=/tmp/victus VICTUS_RUN_DIR=/tmp/victus victus-backend
+//
+// The load can be changed while it runs by writing a percentage to
+// ROOT/emulator/cpu_load or gpu_load; ROOT/emulator/stats shows the state.
+
+static std::atomic<bool> stop_requested(false);
+
+static void request_stop(int)
+{
+    stop_requested.store(true);
+}
+
+int main(int argc, char **argv)
+{
+    std::string root;
+    EmulatorOptions options;
+    std::chrono::milliseconds period{100};
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        try {
+            if (arg == "--cpu-load" && has_value) {
+                options.cpu_load_pct = std::stod(argv[++i]);
+            } else if (arg == "--gpu-load" && has_value) {
+                options.gpu_load_pct = std::stod(argv[++i]);
+            } else if (arg == "--manual-timeout" && has_value) {
+                options.manual_timeout = std::chrono::seconds(std::stol(argv[++i]));
+            } else if (arg == "--fan-gap" && has_value) {
+                options.fan_gap = std::chrono::milliseconds(std::stol(argv[++i]));
+            } else if (arg == "--period" && has_value) {
+                period = std::chrono::milliseconds(std::max(10L, std::stol(argv[++i])));
+            } else if (!arg.empty() && arg[0] != '-' && root.empty()) {
+                root = arg;
+            } else {
+                root.clear();
+                break;
+            }
+        } catch (const std::exception &) {
+            root.clear();
+            break;
+        }
+    }
+    if (root.empty() || root[0] != '/') {
+        std::cerr << "Usage: victus-hpwmi-emu /abs/root [--cpu-load PCT] [--gpu-load PCT] [--manual-timeout S]"
+                     " [--fan-gap MS] [--period MS]" << std::endl;
+        return 2;
+    }
+
+    HpWmiEmulator emulator(root, options);
+    auto result = emulator.create();
+    if (result != "OK") {
+        std::cerr << "victus-hpwmi-emu: " << result.substr(7) << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+    std::cout << "victus-hpwmi-emu: emulating hp-wmi under " << root << " (" << emulator.hwmon_path() << ")"
+              << std::endl;
+    std::cout << "Run the backend with VICTUS_FS_ROOT=" << emulator.root_path() << std::endl;
+
+    auto next = std::chrono::steady_clock::now();
+    while (!stop_requested.load()) {
+        emulator.step(std::chrono::steady_clock::now());
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+
+    std::cout << emulator.format_stats() << std::endl;
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+#include "commands.hpp"
+#include "fan.hpp"
+#include "fan_curve.hpp"
+#include "fan_profile_config.hpp"
+#include "hwmon_io.hpp"
+#include "hp_wmi_emulator.hpp"
+#include "status.hpp"
+#include "telemetry.hpp"
+#include "thermal.hpp"
+#include "util.hpp"
+
+// victus-microbench: times the backend's hot paths against an emulated
+// hp-wmi tree and prints one line per benchmark:
+//
+//   BENCH:collect_snapshot|NS_PER_OP:812.4|ALLOCS_PER_OP:0.00|ITERATIONS:262144
+//
+//   VICTUS_FS_ROOT=/tmp/victus-microbench victus-microbench [--filter TEXT] [--min-time MS]
+//                                                            [--fan-script set-fan-speed.sh]
+//
+// The fan_write cases set fan 1's target once through the cached descriptor
+// and, with --fan-script, through the script the backend falls back to
+// (without sudo, which only adds to it).
+//
+// The tree is (re)created under VICTUS_FS_ROOT, stepped once and then left
+// alone, so every run reads the same values. Allocations are operator new
+// calls made by the process while a benchmark runs.
+
+static std::atomic<uint64_t> allocation_count(0);
+
+void *operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+// Keeps the compiler from dropping a result nobody reads
+template <typename T>
+static void keep(const T &value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct Benchmark {
+    const char *name;
+    std::function<void()> body;
+};
+
+// Doubles the batch until one takes min_time, then reports that batch
+static void run_benchmark(const Benchmark &benchmark, std::chrono::milliseconds min_time)
+{
+    benchmark.body(); // warm up: sensor discovery, first opens
+
+    uint64_t iterations = 1;
+    while (true) {
+        uint64_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            benchmark.body();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t allocations = allocation_count.load(std::memory_order_relaxed) - allocations_before;
+
+        if (elapsed >= min_time || iterations >= (1ull << 32)) {
+            double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            char line[256];
+            std::snprintf(line, sizeof(line), "BENCH:%s|NS_PER_OP:%.1f|ALLOCS_PER_OP:%.2f|ITERATIONS:%llu",
+                          benchmark.name, ns / static_cast<double>(iterations),
+                          static_cast<double>(allocations) / static_cast<double>(iterations),
+                          static_cast<unsigned long long>(iterations));
+            std::cout << line << std::endl;
+            return;
+        }
+        iterations *= 2;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string filter;
+    std::chrono::milliseconds min_time{200};
+    std::string fan_script;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            min_time = std::chrono::milliseconds(std::atol(argv[++i]));
+        } else if (arg == "--fan-script" && i + 1 < argc) {
+            fan_script = argv[++i];
+        } else {
+            std::cerr << "Usage: VICTUS_FS_ROOT=/abs/dir victus-microbench [--filter TEXT] [--min-time MS]"
+                         " [--fan-script PATH]" << std::endl;
+            return 2;
+        }
+    }
+
+    // Never run against the real /sys: the fan mode file would be read and
+    // the sampler would see the real fans
+    if (fs_root().empty()) {
+        std::cerr << "victus-microbench: VICTUS_FS_ROOT must name a scratch directory for the fixture" << std::endl;
+        return 2;
+    }
+    HpWmiEmulator fixture(fs_root(), EmulatorOptions{.cpu_load_pct = 40.0, .gpu_load_pct = 20.0});
+    auto created = fixture.create();
+    if (created != "OK") {
+        std::cerr << "victus-microbench: " << created.substr(7) << std::endl;
+        return 1;
+    }
+    fixture.step(std::chrono::steady_clock::now());
+    fixture.step(std::chrono::steady_clock::now() + std::chrono::seconds(1));
+
+    // One synchronous sample for the GET_* commands, then out of the way
+    start_telemetry_sampler();
+    set_telemetry_interval(kTelemetryMaxInterval);
+
+    FanCurve curve(std::vector<FanCurvePoint>(FAN1_BETTER_AUTO_PROFILE.begin(), FAN1_BETTER_AUTO_PROFILE.end()));
+    double curve_temp = kCurveMinTemp;
+
+    TelemetrySnapshot temps;
+    temps.timestamp_ms = 1700000000000ull;
+    temps.pkg_temp = 48;
+    temps.core_temps = {40, 39, 43, 45, 43, 45, 45, 45, 45, 45};
+    temps.nvme_temps = {37, 36};
+    // What the fan page gets: the same PKG/CORES/NVME sections inside a status record
+    std::string all_temps = format_all_temps(temps);
+    all_temps.erase(all_temps.rfind("|TS:"));
+    const std::string status_record = "V1|TS:1700000000000|MODE:BETTER_AUTO|FAN1:2300|FAN2:2400|CPU:48|" + all_temps;
+
+    int fan_rpm = MIN_RPM_NONZERO;
+    auto next_fan_rpm = [&fan_rpm]() {
+        fan_rpm = fan_rpm >= FAN1_MAX_RPM - 100 ? MIN_RPM_NONZERO : fan_rpm + 100;
+        return fan_rpm;
+    };
+
+    std::vector<Benchmark> benchmarks = {
+        {"collect_snapshot", [] { keep(collect_snapshot()); }},
+        {"read_cpu_usage_pct", [] { keep(read_cpu_usage_pct()); }},
+        {"curve_rpm_at", [&] {
+            curve_temp = curve_temp >= kCurveMaxTemp ? kCurveMinTemp : curve_temp + 0.37;
+            keep(curve.rpm_at(curve_temp));
+        }},
+        {"format_all_temps", [&] { keep(format_all_temps(temps)); }},
+        {"handle_command_get_all_temps", [] { keep(handle_command("GET_ALL_TEMPS")); }},
+        {"handle_command_get_status", [] { keep(handle_command("GET_STATUS")); }},
+        {"handle_command_get_fan_mode", [] { keep(handle_command("GET_FAN_MODE")); }},
+        {"handle_command_unknown", [] { keep(handle_command("NOT_A_COMMAND")); }},
+        {"frontend_parse_status", [&] { keep(parse_status(status_record)); }},
+        {"fan_write_cached_fd", [&] { keep(hwmon_write_fan_target(0, next_fan_rpm())); }},
+    };
+    if (!fan_script.empty()) {
+        benchmarks.push_back({"fan_write_script", [&] {
+            std::string command = "/bin/bash " + fan_script + " 1 " + std::to_string(next_fan_rpm()) + " 2>/dev/null";
+            keep(std::system(command.c_str()));
+        }});
+    }
+
+    for (const auto &benchmark : benchmarks) {
+        if (filter.empty() || std::string(benchmark.name).find(filter) != std::string::npos) {
+            run_benchmark(benchmark, min_time);
+        }
+    }
+
+    // Like the backend, skip static destructors under the scheduler threads
+    std::cout.flush();
+    std::_Exit(0);
+}
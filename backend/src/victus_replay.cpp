@@ -0,0 +1,460 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <optional>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <exception>
+
+#include "control_loop.hpp"
+#include "config.hpp"
+#include "fan_profile_config.hpp"
+#include "hp_wmi_emulator.hpp"
+#include "sensor_filter.hpp"
+
+// victus-replay: runs the BETTER_AUTO control loop offline against a
+// temperature trace under a virtual clock, so controller and config changes
+// can be compared without the hardware or real time.
+//
+//   victus-replay [--config FILE] [--controller curve|pid] [--threshold C]
+//                 [--synthetic HOURS] [--seed N] [--max-writes-per-h N]
+//                 [--max-overshoot C] [--max-above-pct P] [TRACE]
+//
+// TRACE is CSV with a header: victus-trace output, or any file with a time
+// column (time_s or time_us) and cpu/gpu temperature columns (cpu_raw_c or
+// cpu_c, gpu_raw_c or gpu_c; raw preferred). Rows without a temperature
+// are skipped. A trace is replayed open loop: its temperatures already
+// carry the fans that ran when it was recorded.
+//
+// Without a trace, --synthetic HOURS (default 24) of a deterministic
+// workload drives the emulator's thermal model in closed loop: temperatures
+// follow the load and the fans the controller wrote, so time above the
+// threshold and overshoot measure the controller. With --max-writes-per-h,
+// --max-overshoot or --max-above-pct the exit status is 1 when the run goes
+// over, which is how `meson test` checks a synthetic day.
+
+struct TraceSample {
+    double time_s;
+    std::optional<double> cpu_c;
+    std::optional<double> gpu_c;
+};
+
+struct LoadSample {
+    double time_s;
+    double cpu_load_pct;
+    double gpu_load_pct;
+};
+
+struct ReplayOptions {
+    std::string config_path;
+    std::optional<ControllerKind> controller;
+    std::optional<double> threshold_c;
+    double synthetic_hours = 24.0;
+    unsigned seed = 1;
+    std::string trace_path;
+    std::optional<double> max_writes_per_h;
+    std::optional<double> max_overshoot_c;
+    std::optional<double> max_above_pct;
+};
+
+class VirtualClock : public ControlClock
+{
+public:
+    std::chrono::steady_clock::time_point now() override { return current; }
+    void advance(std::chrono::milliseconds step) { current += step; }
+
+private:
+    // Away from the epoch, which the loop treats like any other time
+    std::chrono::steady_clock::time_point current = std::chrono::steady_clock::time_point(std::chrono::hours(1));
+};
+
+// Sample-and-hold of the trace at the clock's time, through the same filter
+// chain as the backend's sensor path
+class TraceSensorSource : public SensorSource
+{
+public:
+    TraceSensorSource(const std::vector<TraceSample> &trace_samples, VirtualClock &replay_clock,
+                      const BackendConfig &replay_config)
+        : samples(trace_samples), clock(replay_clock), config(replay_config)
+    {
+        start = clock.now();
+    }
+
+    ThermalSnapshot sample() override
+    {
+        auto now = clock.now();
+        double elapsed_s = std::chrono::duration<double>(now - start).count();
+        while (next + 1 < samples.size() && samples[next + 1].time_s <= elapsed_s) {
+            ++next;
+        }
+
+        ThermalSnapshot snapshot;
+        snapshot.cpu_temp_raw_c = samples[next].cpu_c;
+        snapshot.gpu_temp_raw_c = samples[next].gpu_c;
+        if (snapshot.cpu_temp_raw_c) {
+            snapshot.cpu_temp_c = filters[0].update(*snapshot.cpu_temp_raw_c, now, config.temp_filters[0]);
+        }
+        if (snapshot.gpu_temp_raw_c) {
+            snapshot.gpu_temp_c = filters[1].update(*snapshot.gpu_temp_raw_c, now, config.temp_filters[1]);
+        }
+        return snapshot;
+    }
+
+private:
+    const std::vector<TraceSample> &samples;
+    VirtualClock &clock;
+    const BackendConfig &config;
+    std::chrono::steady_clock::time_point start;
+    size_t next = 0;
+    std::array<SensorFilter, 2> filters;
+};
+
+class CountingFanSink : public FanSink
+{
+public:
+    int max_rpm(size_t index) override { return index == 0 ? FAN1_MAX_RPM : FAN2_MAX_RPM; }
+    std::string write(size_t index, int rpm) override
+    {
+        ++writes[index];
+        targets[index] = rpm;
+        return "OK";
+    }
+
+    std::array<uint64_t, 2> writes = {0, 0};
+    std::array<int, 2> targets = {0, 0};
+};
+
+// The plant for the synthetic day: the emulator's heat model, fed by the
+// load at the clock's time and the airflow of the fans as written, which
+// follow a new target after the emulator's delay and slew rate. The
+// controllers see it through sensor noise, occasional single-sample turbo
+// spikes and the backend's filter chain.
+class ThermalPlant : public CountingFanSink, public SensorSource
+{
+public:
+    ThermalPlant(const std::vector<LoadSample> &load_samples, VirtualClock &replay_clock,
+                 const BackendConfig &replay_config, unsigned seed)
+        : samples(load_samples), clock(replay_clock), config(replay_config), rng(seed)
+    {
+        start = last_step = clock.now();
+        target_written = {start, start};
+        model.cpu_c = emulated.ambient_c + 10.0;
+        model.gpu_c = emulated.ambient_c + 5.0;
+    }
+
+    std::string write(size_t index, int rpm) override
+    {
+        target_written[index] = clock.now();
+        return CountingFanSink::write(index, rpm);
+    }
+
+    ThermalSnapshot sample() override
+    {
+        auto now = clock.now();
+        double elapsed_s = std::chrono::duration<double>(now - start).count();
+        while (next + 1 < samples.size() && samples[next + 1].time_s <= elapsed_s) {
+            ++next;
+        }
+        double dt = std::chrono::duration<double>(now - last_step).count();
+        last_step = now;
+
+        double airflow = 0.0;
+        for (size_t fan = 0; fan < fan_rpm.size(); ++fan) {
+            double goal = now - target_written[fan] >= emulated.input_delay ? targets[fan] : fan_rpm[fan];
+            double step = emulated.rpm_slew_per_s * dt;
+            fan_rpm[fan] = std::clamp(goal, fan_rpm[fan] - step, fan_rpm[fan] + step);
+            airflow += fan_rpm[fan] / max_rpm(fan) / 2.0;
+        }
+        model.advance(dt, emulated.ambient_c, samples[next].cpu_load_pct, samples[next].gpu_load_pct, airflow);
+
+        ThermalSnapshot snapshot;
+        snapshot.cpu_temp_raw_c = model.cpu_c + noise(rng) + (unit(rng) < 0.002 ? 15.0 : 0.0);
+        snapshot.gpu_temp_raw_c = model.gpu_c + noise(rng);
+        snapshot.cpu_temp_c = filters[0].update(*snapshot.cpu_temp_raw_c, now, config.temp_filters[0]);
+        snapshot.gpu_temp_c = filters[1].update(*snapshot.gpu_temp_raw_c, now, config.temp_filters[1]);
+        return snapshot;
+    }
+
+    // What the parts reached, without the sensor noise
+    double hottest_c() const { return std::max(model.cpu_c, model.gpu_c); }
+
+private:
+    const std::vector<LoadSample> &samples;
+    VirtualClock &clock;
+    const BackendConfig &config;
+    const EmulatorOptions emulated;
+    std::mt19937 rng;
+    std::normal_distribution<double> noise{0.0, 0.5};
+    std::uniform_real_distribution<double> unit{0.0, 1.0};
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point last_step;
+    size_t next = 0;
+    ThermalModel model;
+    std::array<double, 2> fan_rpm = {0.0, 0.0};
+    std::array<std::chrono::steady_clock::time_point, 2> target_written;
+    std::array<SensorFilter, 2> filters;
+};
+
+static std::vector<std::string> split_csv(const std::string &line)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ',')) {
+        fields.push_back(field);
+    }
+    if (!line.empty() && line.back() == ',') {
+        fields.emplace_back();
+    }
+    return fields;
+}
+
+static std::optional<double> parse_field(const std::vector<std::string> &fields, int column)
+{
+    if (column < 0 || static_cast<size_t>(column) >= fields.size() || fields[column].empty()) {
+        return std::nullopt;
+    }
+    try {
+        return std::stod(fields[column]);
+    } catch (const std::exception &) {
+        return std::nullopt;
+    }
+}
+
+static std::string load_trace(const std::string &path, std::vector<TraceSample> &samples)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return "ERROR: Unable to open " + path + ": " + strerror(errno);
+    }
+
+    std::string line;
+    if (!std::getline(file, line)) {
+        return "ERROR: " + path + " is empty";
+    }
+    auto header = split_csv(line);
+    auto column = [&header](std::initializer_list<const char *> names) {
+        for (const char *name : names) {
+            auto found = std::find(header.begin(), header.end(), name);
+            if (found != header.end()) {
+                return static_cast<int>(found - header.begin());
+            }
+        }
+        return -1;
+    };
+    int time_s = column({"time_s"});
+    int time_us = column({"time_us"});
+    std::array<int, 2> cpu = {column({"cpu_raw_c"}), column({"cpu_c"})};
+    std::array<int, 2> gpu = {column({"gpu_raw_c"}), column({"gpu_c"})};
+    if ((time_s < 0 && time_us < 0) || (cpu[0] < 0 && cpu[1] < 0 && gpu[0] < 0 && gpu[1] < 0)) {
+        return "ERROR: " + path + " needs a time_s or time_us column and a cpu or gpu temperature column";
+    }
+
+    std::optional<double> first_time;
+    while (std::getline(file, line)) {
+        auto fields = split_csv(line);
+        auto time = time_s >= 0 ? parse_field(fields, time_s) : parse_field(fields, time_us);
+        // The raw reading when the file has it, so the replay filters it
+        // with the config under test
+        auto temperature = [&fields](const std::array<int, 2> &columns) {
+            auto raw = parse_field(fields, columns[0]);
+            return raw ? raw : parse_field(fields, columns[1]);
+        };
+        TraceSample sample{0.0, temperature(cpu), temperature(gpu)};
+        if (!time || (!sample.cpu_c && !sample.gpu_c)) {
+            continue;
+        }
+        double seconds = time_s >= 0 ? *time : *time / 1e6;
+        if (!first_time) {
+            first_time = seconds;
+        }
+        sample.time_s = seconds - *first_time;
+        if (!samples.empty() && sample.time_s < samples.back().time_s) {
+            return "ERROR: " + path + ": time goes backwards at " + std::to_string(seconds);
+        }
+        samples.push_back(sample);
+    }
+    if (samples.size() < 2) {
+        return "ERROR: " + path + " has fewer than two temperature samples";
+    }
+    return "OK";
+}
+
+// One sample per second: idle stretches and loads of random length and
+// level, which the plant turns into temperatures
+static std::vector<LoadSample> synthetic_load(double hours, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> segment_s(60.0, 1200.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    std::vector<LoadSample> samples;
+    size_t total = static_cast<size_t>(hours * 3600.0);
+    samples.reserve(total);
+    double cpu_load = 5.0, gpu_load = 3.0;
+    double segment_end = 0.0;
+    for (size_t second = 0; second < total; ++second) {
+        double time = static_cast<double>(second);
+        if (time >= segment_end) {
+            segment_end = time + segment_s(rng);
+            bool idle = unit(rng) < 0.4;
+            cpu_load = idle ? 5.0 : 20.0 + 80.0 * unit(rng);
+            gpu_load = idle ? 3.0 : std::clamp(cpu_load - 30.0 + 60.0 * unit(rng), 0.0, 100.0);
+        }
+        samples.push_back({time, cpu_load, gpu_load});
+    }
+    return samples;
+}
+
+static bool parse_options(int argc, char **argv, ReplayOptions &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        try {
+            if (arg == "--config" && has_value) {
+                options.config_path = argv[++i];
+            } else if (arg == "--controller" && has_value) {
+                options.controller = parse_controller_kind(argv[++i]);
+                if (!options.controller) {
+                    return false;
+                }
+            } else if (arg == "--threshold" && has_value) {
+                options.threshold_c = std::stod(argv[++i]);
+            } else if (arg == "--synthetic" && has_value) {
+                options.synthetic_hours = std::stod(argv[++i]);
+            } else if (arg == "--seed" && has_value) {
+                options.seed = static_cast<unsigned>(std::stoul(argv[++i]));
+            } else if (arg == "--max-writes-per-h" && has_value) {
+                options.max_writes_per_h = std::stod(argv[++i]);
+            } else if (arg == "--max-overshoot" && has_value) {
+                options.max_overshoot_c = std::stod(argv[++i]);
+            } else if (arg == "--max-above-pct" && has_value) {
+                options.max_above_pct = std::stod(argv[++i]);
+            } else if (!arg.empty() && arg[0] != '-' && options.trace_path.empty()) {
+                options.trace_path = arg;
+            } else {
+                return false;
+            }
+        } catch (const std::exception &) {
+            return false;
+        }
+    }
+    return options.synthetic_hours * 3600.0 >= 2.0;
+}
+
+int main(int argc, char **argv)
+{
+    ReplayOptions options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: victus-replay [--config FILE] [--controller curve|pid] [--threshold C]"
+                     " [--synthetic HOURS] [--seed N] [--max-writes-per-h N] [--max-overshoot C]"
+                     " [--max-above-pct P] [TRACE]"
+                  << std::endl;
+        return 2;
+    }
+
+    auto config = default_backend_config();
+    if (!options.config_path.empty()) {
+        std::ifstream file(options.config_path);
+        auto result = file ? parse_backend_config(file, *config)
+                           : "ERROR: Unable to open " + options.config_path + ": " + strerror(errno);
+        if (result != "OK") {
+            std::cerr << "victus-replay: " << result.substr(7) << std::endl;
+            return 1;
+        }
+    }
+    if (options.controller) {
+        config->controller = *options.controller;
+    }
+    double threshold_c = options.threshold_c.value_or(config->pid.target_c);
+
+    VirtualClock clock;
+    std::vector<TraceSample> trace;
+    std::vector<LoadSample> load;
+    std::unique_ptr<TraceSensorSource> trace_sensors;
+    CountingFanSink trace_fans;
+    std::unique_ptr<ThermalPlant> plant;
+    double duration_s = 0.0;
+    if (!options.trace_path.empty()) {
+        auto result = load_trace(options.trace_path, trace);
+        if (result != "OK") {
+            std::cerr << "victus-replay: " << result.substr(7) << std::endl;
+            return 1;
+        }
+        trace_sensors = std::make_unique<TraceSensorSource>(trace, clock, *config);
+        duration_s = trace.back().time_s - trace.front().time_s;
+    } else {
+        load = synthetic_load(options.synthetic_hours, options.seed);
+        plant = std::make_unique<ThermalPlant>(load, clock, *config, options.seed);
+        duration_s = load.back().time_s - load.front().time_s;
+    }
+    SensorSource &sensors = plant ? static_cast<SensorSource &>(*plant) : *trace_sensors;
+    CountingFanSink &fans = plant ? static_cast<CountingFanSink &>(*plant) : trace_fans;
+    ControlLoop loop(clock, sensors, fans);
+
+    auto wall_start = std::chrono::steady_clock::now();
+    double tick_s = std::chrono::duration<double>(config->control_tick).count();
+    uint64_t ticks = 0;
+    double above_s = 0.0;
+    double max_overshoot_c = 0.0;
+    double max_temp_c = 0.0;
+    for (double elapsed = 0.0; elapsed <= duration_s; elapsed += tick_s) {
+        ControlTick tick = loop.tick(*config, config->better_auto_curves.get(), true, false);
+        ++ticks;
+
+        // Judged on the plant's temperature, or on what the sensors read
+        // for a trace, not on the filtered value the controllers saw
+        double hottest = plant ? plant->hottest_c()
+                               : std::max(tick.thermal.cpu_temp_raw_c.value_or(0.0),
+                                          tick.thermal.gpu_temp_raw_c.value_or(0.0));
+        max_temp_c = std::max(max_temp_c, hottest);
+        if (hottest > threshold_c) {
+            above_s += tick_s;
+            max_overshoot_c = std::max(max_overshoot_c, hottest - threshold_c);
+        }
+        clock.advance(config->control_tick);
+    }
+    auto wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall_start).count();
+
+    uint64_t writes = fans.writes[0] + fans.writes[1];
+    uint64_t avoided = loop.shaper_stats(0).avoided() + loop.shaper_stats(1).avoided();
+    double hours = std::max(duration_s, tick_s) / 3600.0;
+    double writes_per_h = static_cast<double>(writes) / hours;
+    double above_pct = duration_s > 0 ? 100.0 * above_s / duration_s : 0.0;
+    std::printf("CONTROLLER:%s|LOOP:%s|SIM_S:%.0f|TICKS:%llu|WRITES:%llu|FAN1_WRITES:%llu|FAN2_WRITES:%llu"
+                "|WRITES_PER_H:%.1f|SHAPER_AVOIDED:%llu|THRESHOLD_C:%.1f|ABOVE_S:%.0f|ABOVE_PCT:%.2f"
+                "|MAX_OVERSHOOT_C:%.1f|MAX_TEMP_C:%.1f|WALL_MS:%.1f\n",
+                controller_name(config->controller), plant ? "CLOSED" : "OPEN", duration_s,
+                static_cast<unsigned long long>(ticks), static_cast<unsigned long long>(writes),
+                static_cast<unsigned long long>(fans.writes[0]), static_cast<unsigned long long>(fans.writes[1]),
+                writes_per_h, static_cast<unsigned long long>(avoided), threshold_c, above_s, above_pct,
+                max_overshoot_c, max_temp_c, wall_ms);
+
+    int status = 0;
+    if (options.max_writes_per_h && writes_per_h > *options.max_writes_per_h) {
+        std::fprintf(stderr, "victus-replay: %.1f writes per hour, over the %.1f allowed\n", writes_per_h,
+                     *options.max_writes_per_h);
+        status = 1;
+    }
+    if (options.max_overshoot_c && max_overshoot_c > *options.max_overshoot_c) {
+        std::fprintf(stderr, "victus-replay: %.1f C over the threshold, over the %.1f C allowed\n", max_overshoot_c,
+                     *options.max_overshoot_c);
+        status = 1;
+    }
+    if (options.max_above_pct && above_pct > *options.max_above_pct) {
+        std::fprintf(stderr, "victus-replay: %.2f%% of the time over the threshold, over the %.2f%% allowed\n",
+                     above_pct, *options.max_above_pct);
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "control_trace.hpp"
+
+// victus-trace: decodes the backend's control trace ring to CSV, oldest
+// record first. Usage: victus-trace [trace file]. Reads a private copy of
+// the ring so a running backend is never blocked; a slot overwritten while
+// it is copied is skipped.
+
+static const char *kind_name(uint8_t kind)
+{
+    switch (kind) {
+    case kTraceTick:
+        return "tick";
+    case kTraceWrite:
+        return "write";
+    default:
+        return "unknown";
+    }
+}
+
+static const char *controller_name(uint8_t controller)
+{
+    return controller == 1 ? "pid" : "curve";
+}
+
+static void print_temp(float value)
+{
+    if (std::isnan(value)) {
+        std::fputs(",", stdout);
+    } else {
+        std::printf(",%.2f", value);
+    }
+}
+
+static void print_rpm(int16_t value)
+{
+    if (value < 0) {
+        std::fputs(",", stdout);
+    } else {
+        std::printf(",%d", value);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // Same place as the backend's: VICTUS_RUN_DIR overrides /run/victus-control
+    const char *run_dir = std::getenv("VICTUS_RUN_DIR");
+    std::string default_path = (run_dir && *run_dir) ? std::string(run_dir) + "/" CONTROL_TRACE_FILE : CONTROL_TRACE_PATH;
+    const char *path = argc > 1 ? argv[1] : default_path.c_str();
+    if (argc > 2 || (argc == 2 && (std::strcmp(path, "-h") == 0 || std::strcmp(path, "--help") == 0))) {
+        std::cerr << "Usage: victus-trace [trace file]  (default " CONTROL_TRACE_PATH ")" << std::endl;
+        return 2;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "victus-trace: unable to open " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(TraceHeader)) {
+        std::cerr << "victus-trace: " << path << " is not a control trace" << std::endl;
+        close(fd);
+        return 1;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "victus-trace: mmap failed: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    TraceHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    if (header.magic != kTraceMagic || header.version != kTraceVersion || header.record_size != sizeof(TraceRecord) ||
+        header.header_size != sizeof(TraceHeader) ||
+        size < sizeof(TraceHeader) + size_t(header.capacity) * sizeof(TraceRecord)) {
+        std::cerr << "victus-trace: " << path << " has an unknown header (version " << header.version << ")"
+                  << std::endl;
+        return 1;
+    }
+
+    // A slot whose sequence changed while it was copied was being
+    // overwritten; it is dropped like a slot caught mid-write
+    auto *ring = reinterpret_cast<TraceRecord *>(static_cast<char *>(mapping) + sizeof(TraceHeader));
+    std::vector<TraceRecord> records(header.capacity);
+    std::memcpy(records.data(), ring, records.size() * sizeof(TraceRecord));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (std::atomic_ref<uint64_t>(ring[i].sequence).load(std::memory_order_relaxed) != records[i].sequence) {
+            records[i].sequence = 0;
+        }
+    }
+    munmap(mapping, size);
+
+    // Slots are in ring order; the sequence gives the real order and drops
+    // never-used and half-written slots
+    records.erase(std::remove_if(records.begin(), records.end(),
+                                 [](const TraceRecord &record) { return record.sequence == 0; }),
+                  records.end());
+    std::sort(records.begin(), records.end(),
+              [](const TraceRecord &a, const TraceRecord &b) { return a.sequence < b.sequence; });
+
+    std::puts("sequence,time_us,kind,controller,fan,forced,curve_write,pid_write,fallback,"
+              "cpu_raw_c,cpu_c,gpu_raw_c,gpu_c,control_c,pid_output,"
+              "curve_rpm1,curve_rpm2,pid_rpm1,pid_rpm2,applied_rpm1,applied_rpm2,latency_us,result");
+    for (const TraceRecord &record : records) {
+        bool tick = record.kind == kTraceTick;
+        std::printf("%llu,%lld,%s,%s,", static_cast<unsigned long long>(record.sequence),
+                    static_cast<long long>(record.time_us), kind_name(record.kind),
+                    tick ? controller_name(record.controller) : "");
+        if (!tick) {
+            std::printf("%d", record.fan + 1);
+        }
+        std::printf(",%d,%d,%d,%d", (record.flags & kTraceForced) != 0, (record.flags & kTraceCurveWrite) != 0,
+                    (record.flags & kTracePidWrite) != 0, (record.flags & kTraceFallback) != 0);
+        print_temp(record.cpu_raw_c);
+        print_temp(record.cpu_c);
+        print_temp(record.gpu_raw_c);
+        print_temp(record.gpu_c);
+        print_temp(record.control_c);
+        if (std::isnan(record.pid_output)) {
+            std::fputs(",", stdout);
+        } else {
+            std::printf(",%.4f", record.pid_output);
+        }
+        for (int16_t rpm : record.curve_rpm) {
+            print_rpm(rpm);
+        }
+        for (int16_t rpm : record.pid_rpm) {
+            print_rpm(rpm);
+        }
+        for (int16_t rpm : record.applied_rpm) {
+            print_rpm(rpm);
+        }
+        std::printf(",%u,%s\n", record.latency_us, record.result == 0 ? "ok" : "failed");
+    }
+    return 0;
+}
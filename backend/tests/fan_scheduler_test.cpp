@@ -0,0 +1,89 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "fan_scheduler.hpp"
+
+// Fan 1 targets arriving faster than the apply gap (a slider drag) must not
+// hold fan 2 back, and fan 2 must still never be written inside the gap.
+
+using SteadyClock = std::chrono::steady_clock;
+
+static constexpr std::chrono::milliseconds kGap{100};
+static constexpr std::chrono::milliseconds kFan1Every{30};
+static constexpr std::chrono::milliseconds kFan2Every{250};
+static constexpr std::chrono::milliseconds kRunFor{1500};
+
+struct Write {
+    size_t index;
+    int rpm;
+    SteadyClock::time_point at;
+};
+
+static std::mutex writes_mutex;
+static std::vector<Write> writes;
+
+int main()
+{
+    set_fan_apply_gap(kGap);
+    start_fan_scheduler([](size_t index, int rpm) {
+        std::lock_guard<std::mutex> lock(writes_mutex);
+        writes.push_back({index, rpm, SteadyClock::now()});
+        return std::string("OK");
+    });
+
+    auto start = SteadyClock::now();
+    auto next_fan2 = start;
+    int fan2_submits = 0;
+    for (int rpm = 2000; SteadyClock::now() - start < kRunFor; rpm += 10) {
+        submit_fan_target(0, rpm);
+        if (SteadyClock::now() >= next_fan2) {
+            submit_fan_target(1, 3000 + fan2_submits++);
+            next_fan2 += kFan2Every;
+        }
+        std::this_thread::sleep_for(kFan1Every);
+    }
+    std::this_thread::sleep_for(3 * kGap);
+
+    std::lock_guard<std::mutex> lock(writes_mutex);
+    int failures = 0;
+    int fan1_writes = 0;
+    int fan2_writes = 0;
+    int last_fan2_rpm = 0;
+    SteadyClock::time_point last_fan1 = SteadyClock::time_point::min();
+    for (const auto &write : writes) {
+        if (write.index == 0) {
+            ++fan1_writes;
+            last_fan1 = write.at;
+            continue;
+        }
+        ++fan2_writes;
+        last_fan2_rpm = write.rpm;
+        if (last_fan1 != SteadyClock::time_point::min() && write.at - last_fan1 < kGap) {
+            std::cerr << "FAIL: fan 2 written "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(write.at - last_fan1).count()
+                      << " ms after fan 1" << std::endl;
+            ++failures;
+        }
+    }
+
+    // Every fan 2 submit is a gap or more apart, so none should be superseded
+    if (fan2_writes < fan2_submits - 1 || last_fan2_rpm != 3000 + fan2_submits - 1) {
+        std::cerr << "FAIL: fan 2 written " << fan2_writes << " times for " << fan2_submits
+                  << " targets, last " << last_fan2_rpm << std::endl;
+        ++failures;
+    }
+    if (fan1_writes < 5) {
+        std::cerr << "FAIL: fan 1 written only " << fan1_writes << " times" << std::endl;
+        ++failures;
+    }
+
+    std::cout << "fan1 writes " << fan1_writes << ", fan2 writes " << fan2_writes << " of " << fan2_submits
+              << " targets" << std::endl;
+    // The scheduler thread never exits; skip static destructors under it
+    std::cout.flush();
+    std::_Exit(failures == 0 ? 0 : 1);
+}
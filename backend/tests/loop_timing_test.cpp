@@ -0,0 +1,162 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include "fan.hpp"
+#include "hp_wmi_emulator.hpp"
+#include "loop_timer.hpp"
+#include "task_scheduler.hpp"
+#include "util.hpp"
+
+// Tick lateness of LoopTimer and the task scheduler, how long stop(), a
+// re-arm and cancel_task() take to take effect, and how long SET_FAN_MODE
+// switches in and out of BETTER_AUTO take on an emulated tree
+// (VICTUS_FS_ROOT). The bounds are loose enough for a loaded build machine;
+// a sleep-based loop or a stop that waits out a period fails them by far.
+
+using SteadyClock = std::chrono::steady_clock;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+static constexpr milliseconds kPeriod{10};
+static constexpr int kTicks = 50;
+static constexpr microseconds kMaxAvgLateness{2000};
+static constexpr microseconds kMaxLateness{50000};
+static constexpr microseconds kMaxStopLatency{20000};
+static constexpr microseconds kMaxModeSwitch{250000};
+static constexpr int kModeSwitches = 20;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what)
+{
+    if (!ok) {
+        std::cerr << "FAIL: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static long long us(SteadyClock::duration duration)
+{
+    return std::chrono::duration_cast<microseconds>(duration).count();
+}
+
+static void check_lateness(const std::string &name, const LoopTimerStats &stats, uint64_t min_ticks)
+{
+    microseconds avg{stats.ticks ? stats.total_lateness.count() / static_cast<long long>(stats.ticks) : 0};
+    std::cout << format_loop_timer_stats(name, stats) << std::endl;
+    check(stats.ticks >= min_ticks, name + " ticked " + std::to_string(stats.ticks) + " times");
+    check(avg <= kMaxAvgLateness, name + " average lateness " + std::to_string(avg.count()) + " us");
+    check(stats.max_lateness <= kMaxLateness, name + " max lateness " + std::to_string(stats.max_lateness.count()) + " us");
+}
+
+static void loop_timer_checks()
+{
+    LoopTimer timer;
+    timer.arm(kPeriod);
+    for (int i = 0; i < kTicks; ++i) {
+        timer.wait();
+    }
+    check_lateness("LOOP_TIMER", timer.stats(), kTicks);
+
+    // A re-arm (new period) wakes a wait on the old, long one right away
+    timer.arm(std::chrono::seconds(10), std::chrono::seconds(10));
+    SteadyClock::time_point rearmed_at;
+    std::thread rearmer([&]() {
+        std::this_thread::sleep_for(milliseconds(50));
+        rearmed_at = SteadyClock::now();
+        timer.arm(kPeriod);
+    });
+    bool ticked = timer.wait();
+    auto woke_at = SteadyClock::now();
+    rearmer.join();
+    auto rearm_latency = woke_at - rearmed_at;
+    std::cout << "LOOP_TIMER_REARM_US:" << us(rearm_latency) << std::endl;
+    check(ticked, "wait() did not tick after a re-arm");
+    check(rearm_latency <= kMaxStopLatency, "a re-arm took " + std::to_string(us(rearm_latency)) + " us");
+
+    // stop() from another thread ends a wait on a long period right away
+    timer.arm(std::chrono::seconds(10), std::chrono::seconds(10));
+    SteadyClock::time_point stopped_at;
+    std::thread stopper([&]() {
+        std::this_thread::sleep_for(milliseconds(50));
+        stopped_at = SteadyClock::now();
+        timer.stop();
+    });
+    ticked = timer.wait();
+    woke_at = SteadyClock::now();
+    stopper.join();
+    auto stop_latency = woke_at - stopped_at;
+    std::cout << "LOOP_TIMER_STOP_US:" << us(stop_latency) << std::endl;
+    check(!ticked, "wait() returned a tick after stop()");
+    check(stop_latency <= kMaxStopLatency, "stop() took " + std::to_string(us(stop_latency)) + " us");
+}
+
+static void scheduler_checks()
+{
+    size_t tasks_before = scheduled_task_count();
+    TaskHandle task = schedule_periodic_task("TIMING_TEST", kPeriod, []() {});
+    std::this_thread::sleep_for(kPeriod * kTicks);
+
+    auto cancel_start = SteadyClock::now();
+    cancel_task(task);
+    auto cancel_latency = SteadyClock::now() - cancel_start;
+    check_lateness("TASK", task_stats("TIMING_TEST"), kTicks / 2);
+    std::cout << "TASK_CANCEL_US:" << us(cancel_latency) << std::endl;
+    check(cancel_latency <= kMaxStopLatency, "cancel_task() took " + std::to_string(us(cancel_latency)) + " us");
+    check(scheduled_task_count() == tasks_before, "task still scheduled after cancel_task()");
+}
+
+static long long loop_timing_field(const std::string &timing, const std::string &key)
+{
+    size_t at = timing.find("|" + key + ":");
+    return at == std::string::npos ? -1 : std::atoll(timing.c_str() + at + key.size() + 2);
+}
+
+static void mode_switch_checks()
+{
+    size_t tasks_before = scheduled_task_count();
+    microseconds max_switch{0};
+    for (int i = 0; i < kModeSwitches; ++i) {
+        for (const char *mode : {"BETTER_AUTO", "AUTO"}) {
+            auto start = SteadyClock::now();
+            auto result = set_fan_mode(mode);
+            auto elapsed = std::chrono::duration_cast<microseconds>(SteadyClock::now() - start);
+            max_switch = std::max(max_switch, elapsed);
+            check(result == "OK", std::string("SET_FAN_MODE ") + mode + ": " + result);
+        }
+        std::this_thread::sleep_for(milliseconds(20));
+    }
+
+    auto timing = get_loop_timing();
+    long long stop_max_us = loop_timing_field(timing, "STOP_MAX_US");
+    std::cout << "MODE_SWITCH_MAX_US:" << max_switch.count() << "|STOP_MAX_US:" << stop_max_us << std::endl;
+    check(max_switch <= kMaxModeSwitch, "a mode switch took " + std::to_string(max_switch.count()) + " us");
+    check(stop_max_us >= 0 && stop_max_us <= kMaxStopLatency.count(),
+          "BETTER_AUTO took " + std::to_string(stop_max_us) + " us to stop");
+    check(scheduled_task_count() == tasks_before, "control tasks left behind after switching back to AUTO");
+}
+
+int main()
+{
+    if (fs_root().empty()) {
+        std::cerr << "loop-timing: VICTUS_FS_ROOT must name a scratch directory for the emulated tree" << std::endl;
+        return 2;
+    }
+    HpWmiEmulator emulator(fs_root());
+    auto created = emulator.create();
+    if (created != "OK") {
+        std::cerr << "loop-timing: " << created << std::endl;
+        return 1;
+    }
+
+    loop_timer_checks();
+    scheduler_checks();
+    mode_switch_checks();
+
+    // The scheduler and worker threads never exit; skip static destructors
+    std::cout.flush();
+    std::_Exit(failures == 0 ? 0 : 1);
+}
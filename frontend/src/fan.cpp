@@ -2,43 +2,10 @@
 #include "socket.hpp"
 #include <iostream>
 #include <string>
-#include <thread>
-#include <chrono>
 #include <cmath>
 #include <algorithm>
 #include <sstream>
 
-// Helper structs for async UI updates
-struct UpdateStateData {
-    std::string fan_mode;
-    GtkWidget *mode_selector;
-    GtkWidget *manual_box;
-    GtkWidget *profile_box;
-    GtkWidget *state_label;
-};
-
-struct UpdateSpeedData {
-    std::string fan1_speed;
-    std::string fan2_speed;
-    GtkWidget *fan1_speed_label;
-    GtkWidget *fan2_speed_label;
-};
-
-struct ModeChangeData {
-    std::string mode_str;
-    GtkWidget *manual_box;
-    GtkWidget *profile_box;
-    VictusFanControl *self;
-};
-
-struct TempData {
-    std::string pkg_temp;
-    std::string nvme_temps;
-    std::string cores_temps;
-    GtkWidget *all_temps_label;
-    GtkWidget *cpu_temp_label;
-};
-
 // Constants for manual fan control
 const int MIN_RPM_NONZERO = 1500;  // Minimum non-zero RPM
 const int FAN1_MAX_RPM = 5800;
@@ -49,7 +16,7 @@ const int MAX_TEMP = 100;
 const int MIN_RPM_INPUT = 0;    // Allow 0 RPM mode
 const int MAX_RPM_INPUT = 6100; // Use fan2 max as overall max
 
-VictusFanControl::VictusFanControl(std::shared_ptr<VictusSocketClient> client) : socket_client(client), temp_timer_id(0), fan_timer_id(0)
+VictusFanControl::VictusFanControl(std::shared_ptr<VictusSocketClient> client) : socket_client(client), status_timer_id(0)
 {
     // Load settings
     settings.load();
@@ -198,20 +165,12 @@ VictusFanControl::VictusFanControl(std::shared_ptr<VictusSocketClient> client) :
     gtk_box_append(GTK_BOX(fan_page), fan2_speed_label);
 
     // Initial UI state update
-    update_ui_from_system_state();
-    update_fan_speeds();
-    update_all_temperatures();
+    refresh_status();
 
-    // Set up timers with configurable interval
-    temp_timer_id = g_timeout_add_seconds(settings.update_interval_sec, [](gpointer data) -> gboolean {
-        static_cast<VictusFanControl*>(data)->update_all_temperatures();
-        return G_SOURCE_CONTINUE;
-    }, this);
-    
-    fan_timer_id = g_timeout_add_seconds(settings.update_interval_sec, [](gpointer data) -> gboolean {
-        static_cast<VictusFanControl*>(data)->update_fan_speeds();
-        return G_SOURCE_CONTINUE;
-    }, this);
+    // Pushes replace polling; the timer is the fallback for when the
+    // subscription is down
+    subscribe_to_backend();
+    start_polling_timer();
 }
 
 GtkWidget* VictusFanControl::get_page()
@@ -222,110 +181,73 @@ GtkWidget* VictusFanControl::get_page()
 VictusFanControl::~VictusFanControl()
 {
     // Clean up timers
-    if (temp_timer_id) g_source_remove(temp_timer_id);
-    if (fan_timer_id) g_source_remove(fan_timer_id);
+    if (status_timer_id) g_source_remove(status_timer_id);
     settings.save();
 }
 
-void VictusFanControl::update_ui_from_system_state()
+void VictusFanControl::refresh_status()
 {
-    // Use a background thread to wait for the response without blocking the UI
-    auto client = socket_client;
-    auto mode_selector_ptr = mode_selector;
-    auto manual_box_ptr = manual_box;
-    auto profile_box_ptr = profile_box;
-    auto state_label_ptr = state_label;
-    
-    std::thread([client, mode_selector_ptr, manual_box_ptr, profile_box_ptr, state_label_ptr]() {
-        auto response = client->send_command_async(GET_FAN_MODE);
-        std::string fan_mode = response.get();
-
-        if (fan_mode.find("ERROR") != std::string::npos) {
-            fan_mode = "AUTO"; // Default to AUTO on error
-            std::cerr << "Failed to get fan mode, defaulting to AUTO." << std::endl;
+    // Mode, fan speeds and temperatures in one round trip, answered from a
+    // single backend sample. The response is handled on the main loop.
+    socket_client->send_command(GET_STATUS, "", [this](const std::string &record) {
+        auto status = parse_status(record);
+        if (!status) {
+            std::cerr << "Failed to get status: " << record << std::endl;
+            return;
         }
+        apply_status(*status);
+    });
+}
 
-        // Schedule UI update on main thread
-        g_idle_add([](gpointer user_data) -> gboolean {
-            UpdateStateData *data = static_cast<UpdateStateData*>(user_data);
-
-            gtk_label_set_text(GTK_LABEL(data->state_label), ("Current State: " + data->fan_mode).c_str());
-
-            if (data->fan_mode == "MANUAL") {
-                gtk_combo_box_set_active_id(GTK_COMBO_BOX(data->mode_selector), "MANUAL");
-                gtk_widget_set_sensitive(data->manual_box, TRUE);
-                gtk_widget_set_sensitive(data->profile_box, FALSE);
-            } else if (data->fan_mode == "PROFILE") {
-                gtk_combo_box_set_active_id(GTK_COMBO_BOX(data->mode_selector), "PROFILE");
-                gtk_widget_set_sensitive(data->manual_box, FALSE);
-                gtk_widget_set_sensitive(data->profile_box, TRUE);
-            } else if (data->fan_mode == "BETTER_AUTO") {
-                gtk_combo_box_set_active_id(GTK_COMBO_BOX(data->mode_selector), "BETTER_AUTO");
-                gtk_widget_set_sensitive(data->manual_box, FALSE);
-                gtk_widget_set_sensitive(data->profile_box, FALSE);
-            } else if (data->fan_mode == "MAX") {
-                gtk_combo_box_set_active_id(GTK_COMBO_BOX(data->mode_selector), "MAX");
-                gtk_widget_set_sensitive(data->manual_box, FALSE);
-                gtk_widget_set_sensitive(data->profile_box, FALSE);
-            } else { // AUTO
-                gtk_combo_box_set_active_id(GTK_COMBO_BOX(data->mode_selector), "AUTO");
-                gtk_widget_set_sensitive(data->manual_box, FALSE);
-                gtk_widget_set_sensitive(data->profile_box, FALSE);
-            }
+void VictusFanControl::apply_status(const FanStatus &update)
+{
+    merge_status(current_status, update);
 
-            delete data;
-            return G_SOURCE_REMOVE;
-        }, new UpdateStateData{fan_mode, mode_selector_ptr, manual_box_ptr, profile_box_ptr, state_label_ptr});
-    }).detach();
+    if (update.mode) {
+        show_mode(*update.mode);
+    }
+    if (update.fan1_rpm) {
+        std::string fan1_speed = update.fan1_rpm->find("ERROR") != std::string::npos ? "N/A" : *update.fan1_rpm;
+        gtk_label_set_text(GTK_LABEL(fan1_speed_label), ("Fan 1 Speed: " + fan1_speed + " RPM").c_str());
+    }
+    if (update.fan2_rpm) {
+        std::string fan2_speed = update.fan2_rpm->find("ERROR") != std::string::npos ? "N/A" : *update.fan2_rpm;
+        gtk_label_set_text(GTK_LABEL(fan2_speed_label), ("Fan 2 Speed: " + fan2_speed + " RPM").c_str());
+    }
+    if (update.pkg_temp || update.cores_temps || update.nvme_temps) {
+        show_temperatures(current_status.pkg_temp.value_or(""), current_status.cores_temps.value_or(""),
+                          current_status.nvme_temps.value_or(""));
+    }
 }
 
-void VictusFanControl::update_fan_speeds()
+void VictusFanControl::show_mode(std::string fan_mode)
 {
-    // Use background threads to wait for responses without blocking the UI
-    auto client = socket_client;
-    auto fan1_speed_label_ptr = fan1_speed_label;
-    auto fan2_speed_label_ptr = fan2_speed_label;
-    
-    std::thread([client, fan1_speed_label_ptr, fan2_speed_label_ptr]() {
-        auto response2 = client->send_command_async(GET_FAN_SPEED, "1");
-        std::string fan1_speed = response2.get();
-        if (fan1_speed.find("ERROR") != std::string::npos) fan1_speed = "N/A";
-
-        auto response3 = client->send_command_async(GET_FAN_SPEED, "2");
-        std::string fan2_speed = response3.get();
-        if (fan2_speed.find("ERROR") != std::string::npos) fan2_speed = "N/A";
-
-        // Schedule UI update on main thread
-        g_idle_add([](gpointer user_data) -> gboolean {
-            UpdateSpeedData *data = static_cast<UpdateSpeedData*>(user_data);
-
-            gtk_label_set_text(GTK_LABEL(data->fan1_speed_label), ("Fan 1 Speed: " + data->fan1_speed + " RPM").c_str());
-            gtk_label_set_text(GTK_LABEL(data->fan2_speed_label), ("Fan 2 Speed: " + data->fan2_speed + " RPM").c_str());
-
-            delete data;
-            return G_SOURCE_REMOVE;
-        }, new UpdateSpeedData{fan1_speed, fan2_speed, fan1_speed_label_ptr, fan2_speed_label_ptr});
-    }).detach();
+    if (fan_mode.find("ERROR") != std::string::npos) {
+        fan_mode = "AUTO"; // Default to AUTO on error
+        std::cerr << "Failed to get fan mode, defaulting to AUTO." << std::endl;
+    }
+
+    gtk_label_set_text(GTK_LABEL(state_label), ("Current State: " + fan_mode).c_str());
+
+    const char *mode_id = "AUTO";
+    if (fan_mode == "MANUAL" || fan_mode == "PROFILE" || fan_mode == "BETTER_AUTO" || fan_mode == "MAX") {
+        mode_id = fan_mode.c_str();
+    }
+    syncing_mode = true;
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(mode_selector), mode_id);
+    syncing_mode = false;
+
+    gtk_widget_set_sensitive(manual_box, fan_mode == "MANUAL");
+    gtk_widget_set_sensitive(profile_box, fan_mode == "PROFILE");
 }
 
 void VictusFanControl::set_fan_rpm(int rpm)
 {
     rpm = validate_rpm(rpm);
-    
-    std::string fan1_rpm_str = std::to_string(rpm);
-    std::string fan2_rpm_str = std::to_string(rpm);
 
-    // Launch a detached thread to send commands without freezing the UI
-    std::thread([this, fan1_rpm_str, fan2_rpm_str]() {
-        // Send command for Fan 1
-        socket_client->send_command_async(SET_FAN_SPEED, "1 " + fan1_rpm_str).get();
-        
-        // Wait for 10 seconds
-        std::this_thread::sleep_for(std::chrono::seconds(10));
-        
-        // Send command for Fan 2
-        socket_client->send_command_async(SET_FAN_SPEED, "2 " + fan2_rpm_str).get();
-    }).detach();
+    // The backend queues both targets and spaces the fan 2 write itself
+    socket_client->send_command(SET_FAN_SPEED, "1 " + std::to_string(rpm));
+    socket_client->send_command(SET_FAN_SPEED, "2 " + std::to_string(rpm));
 }
 
 int VictusFanControl::validate_rpm(int rpm)
@@ -416,64 +338,46 @@ void VictusFanControl::apply_profile()
                       std::to_string(profile_points[i].rpm);
     }
 
-    // Send profile in background thread without blocking the UI
-    auto client = socket_client;
-    std::thread([client, profile_str]() {
-        auto result_future = client->send_command_async(SET_FAN_PROFILE, profile_str);
-        std::string result = result_future.get();
-        
+    socket_client->send_command(SET_FAN_PROFILE, profile_str, [](const std::string &result) {
         if (result != "OK") {
             std::cerr << "Failed to apply profile: " << result << std::endl;
         }
-    }).detach();
+    });
 }
 
 void VictusFanControl::on_mode_changed(GtkComboBox *widget, gpointer data)
 {
     VictusFanControl *self = static_cast<VictusFanControl*>(data);
+    if (self->syncing_mode) {
+        return; // Reflecting the backend state, not a user choice
+    }
     const char *mode_id = gtk_combo_box_get_active_id(widget);
 
     if (mode_id) {
         std::string mode_str(mode_id);
         
-        // Send the mode command in a background thread without blocking the UI
-        auto client = self->socket_client;
-        auto manual_box_ptr = self->manual_box;
-        auto profile_box_ptr = self->profile_box;
-        auto this_ptr = self;
-        
-        std::thread([client, mode_str, manual_box_ptr, profile_box_ptr, this_ptr]() {
-            auto result_future = client->send_command_async(SET_FAN_MODE, mode_str);
-            std::string result = result_future.get();
-
-            if (result == "OK") {
-                // Schedule UI update on main thread
-                g_idle_add([](gpointer user_data) -> gboolean {
-                    ModeChangeData *data = static_cast<ModeChangeData*>(user_data);
-
-                    // Handle different modes
-                    if (data->mode_str == "MANUAL") {
-                        gtk_widget_set_sensitive(data->manual_box, TRUE);
-                        gtk_widget_set_sensitive(data->profile_box, FALSE);
-                    } else if (data->mode_str == "PROFILE") {
-                        gtk_widget_set_sensitive(data->manual_box, FALSE);
-                        gtk_widget_set_sensitive(data->profile_box, TRUE);
-                        data->self->apply_profile();
-                    } else {
-                        gtk_widget_set_sensitive(data->manual_box, FALSE);
-                        gtk_widget_set_sensitive(data->profile_box, FALSE);
-                    }
-                    
-                    // After all commands are sent, update the UI to reflect the final state.
-                    data->self->update_ui_from_system_state();
-
-                    delete data;
-                    return G_SOURCE_REMOVE;
-                }, new ModeChangeData{mode_str, manual_box_ptr, profile_box_ptr, this_ptr});
-            } else {
+        self->socket_client->send_command(SET_FAN_MODE, mode_str, [self, mode_str](const std::string &result) {
+            if (result != "OK") {
                 std::cerr << "Failed to set fan mode: " << result << std::endl;
+                return;
+            }
+
+            // Handle different modes
+            if (mode_str == "MANUAL") {
+                gtk_widget_set_sensitive(self->manual_box, TRUE);
+                gtk_widget_set_sensitive(self->profile_box, FALSE);
+            } else if (mode_str == "PROFILE") {
+                gtk_widget_set_sensitive(self->manual_box, FALSE);
+                gtk_widget_set_sensitive(self->profile_box, TRUE);
+                self->apply_profile();
+            } else {
+                gtk_widget_set_sensitive(self->manual_box, FALSE);
+                gtk_widget_set_sensitive(self->profile_box, FALSE);
             }
-        }).detach();
+
+            // After all commands are sent, update the UI to reflect the final state.
+            self->refresh_status();
+        });
     }
 }
 
@@ -498,92 +402,72 @@ void VictusFanControl::on_remove_point_clicked(GtkButton *button, gpointer data)
     }
 }
 
-void VictusFanControl::update_all_temperatures()
+void VictusFanControl::show_temperatures(const std::string &pkg, const std::string &cores, const std::string &nvme)
 {
-    auto client = socket_client;
-    auto all_temps_label_ptr = all_temps_label;
-    auto cpu_temp_label_ptr = cpu_temp_label;
-    
-    std::thread([client, all_temps_label_ptr, cpu_temp_label_ptr]() {
-        try {
-            auto result_future = client->send_command_async(ServerCommands::GET_ALL_TEMPS, "");
-            std::string result = result_future.get();
+    if (pkg.empty() && cores.empty() && nvme.empty()) {
+        gtk_label_set_text(GTK_LABEL(all_temps_label), "CPU: N/A | NVMe: N/A");
+        gtk_label_set_text(GTK_LABEL(cpu_temp_label), "CPU Cores: N/A");
+        return;
+    }
+
+    // Display system temperatures at top with colored package temp
+    if (!pkg.empty()) {
+        std::string display = "<span foreground='#FF6600'><b>CPU: " + pkg + "°C</b></span>";
+        
+        // Add all NVMe temps
+        if (!nvme.empty()) {
+            std::stringstream nvme_ss(nvme);
+            std::string nvme_temp;
+            int nvme_num = 1;
             
-            if (result == "N/A" || result.empty()) {
-                g_idle_add([](gpointer user_data) -> gboolean {
-                    TempData *data = static_cast<TempData*>(user_data);
-                    gtk_label_set_text(GTK_LABEL(data->all_temps_label), "CPU: N/A | NVMe: N/A");
-                    gtk_label_set_text(GTK_LABEL(data->cpu_temp_label), "CPU Cores: N/A");
-                    delete data;
-                    return G_SOURCE_REMOVE;
-                }, new TempData{"", "", "", all_temps_label_ptr, cpu_temp_label_ptr});
-            } else {
-                // Parse format: "PKG:48|CORES:40,39,43,45,43,45,45,45,45,45|NVME:37,36"
-                std::string pkg_temp;
-                std::string nvme_temps;
-                std::string cores_temps;
-                
-                std::stringstream ss(result);
-                std::string section;
-                
-                while (std::getline(ss, section, '|')) {
-                    if (section.find("PKG:") == 0) {
-                        pkg_temp = section.substr(4);
-                    } else if (section.find("CORES:") == 0) {
-                        cores_temps = section.substr(6);
-                    } else if (section.find("NVME:") == 0) {
-                        nvme_temps = section.substr(5);
-                    }
-                }
-
-                // Schedule UI update on main thread with parsed data
-                g_idle_add([](gpointer user_data) -> gboolean {
-                    TempData *data = static_cast<TempData*>(user_data);
-
-                    // Display system temperatures at top with colored package temp
-                    if (!data->pkg_temp.empty()) {
-                        std::string display = "<span foreground='#FF6600'><b>CPU: " + data->pkg_temp + "°C</b></span>";
-                        
-                        // Add all NVMe temps
-                        if (!data->nvme_temps.empty()) {
-                            std::stringstream nvme_ss(data->nvme_temps);
-                            std::string nvme_temp;
-                            int nvme_num = 1;
-                            
-                            while (std::getline(nvme_ss, nvme_temp, ',')) {
-                                display += " | NVMe" + std::to_string(nvme_num) + ": " + nvme_temp + "°C";
-                                nvme_num++;
-                            }
-                        }
-                        
-                        gtk_label_set_markup(GTK_LABEL(data->all_temps_label), display.c_str());
-                    }
-                    
-                    // Display all CPU cores at bottom
-                    if (!data->cores_temps.empty()) {
-                        // Format cores nicely: "Core 0: 40°C, Core 1: 39°C, ..."
-                        std::stringstream cores_ss(data->cores_temps);
-                        std::string core;
-                        int core_num = 0;
-                        std::string cores_display = "CPU Cores: ";
-                        
-                        while (std::getline(cores_ss, core, ',')) {
-                            if (core_num > 0) cores_display += ", ";
-                            cores_display += "C" + std::to_string(core_num) + ":" + core + "°C";
-                            core_num++;
-                        }
-                        
-                        gtk_label_set_text(GTK_LABEL(data->cpu_temp_label), cores_display.c_str());
-                    }
-
-                    delete data;
-                    return G_SOURCE_REMOVE;
-                }, new TempData{pkg_temp, nvme_temps, cores_temps, all_temps_label_ptr, cpu_temp_label_ptr});
+            while (std::getline(nvme_ss, nvme_temp, ',')) {
+                display += " | NVMe" + std::to_string(nvme_num) + ": " + nvme_temp + "°C";
+                nvme_num++;
             }
-        } catch (const std::exception &e) {
-            // Failed to get temps - silently ignore
         }
-    }).detach();
+        
+        gtk_label_set_markup(GTK_LABEL(all_temps_label), display.c_str());
+    }
+    
+    // Display all CPU cores at bottom
+    if (!cores.empty()) {
+        // Format cores nicely: "Core 0: 40°C, Core 1: 39°C, ..."
+        std::stringstream cores_ss(cores);
+        std::string core;
+        int core_num = 0;
+        std::string cores_display = "CPU Cores: ";
+        
+        while (std::getline(cores_ss, core, ',')) {
+            if (core_num > 0) cores_display += ", ";
+            cores_display += "C" + std::to_string(core_num) + ":" + core + "°C";
+            core_num++;
+        }
+        
+        gtk_label_set_text(GTK_LABEL(cpu_temp_label), cores_display.c_str());
+    }
+}
+
+void VictusFanControl::subscribe_to_backend()
+{
+    socket_client->subscribe("MODE,FAN1,FAN2,TEMPS", settings.update_interval_sec * 1000, [this](const std::string &payload) {
+        auto status = parse_status(payload);
+        if (status) {
+            apply_status(*status);
+        }
+    });
+}
+
+void VictusFanControl::start_polling_timer()
+{
+    if (status_timer_id) g_source_remove(status_timer_id);
+
+    status_timer_id = g_timeout_add_seconds(settings.update_interval_sec, [](gpointer d) -> gboolean {
+        auto *self = static_cast<VictusFanControl*>(d);
+        if (!self->socket_client->subscription_active()) {
+            self->refresh_status();
+        }
+        return G_SOURCE_CONTINUE;
+    }, this);
 }
 
 void VictusFanControl::on_apply_profile_clicked(GtkButton *button, gpointer data)
@@ -603,18 +487,8 @@ void VictusFanControl::on_interval_changed(int new_interval)
     if (new_interval != settings.update_interval_sec) {
         settings.update_interval_sec = new_interval;
         settings.save();
-        // Restart timers with new interval
-        if (temp_timer_id) g_source_remove(temp_timer_id);
-        if (fan_timer_id) g_source_remove(fan_timer_id);
-        
-        temp_timer_id = g_timeout_add_seconds(new_interval, [](gpointer d) -> gboolean {
-            static_cast<VictusFanControl*>(d)->update_all_temperatures();
-            return G_SOURCE_CONTINUE;
-        }, this);
-        
-        fan_timer_id = g_timeout_add_seconds(new_interval, [](gpointer d) -> gboolean {
-            static_cast<VictusFanControl*>(d)->update_fan_speeds();
-            return G_SOURCE_CONTINUE;
-        }, this);
+        // Apply the new interval to both the subscription and the fallback timer
+        subscribe_to_backend();
+        start_polling_timer();
     }
-}
\ No newline at end of file
+}
@@ -6,6 +6,7 @@
 #include <vector>
 #include "socket.hpp"
 #include "settings.hpp"
+#include "status.hpp"
 
 struct FanProfilePoint {
     int temperature;  // in Celsius
@@ -54,24 +55,34 @@ private:
 	GtkWidget *fan2_speed_label;
     GtkWidget *point_count_label;
     
-    // Timer IDs for cleanup
-    guint temp_timer_id;
-    guint fan_timer_id;
+    // Timer IDs for cleanup; the status timer only polls while no push
+    // subscription is active
+    guint status_timer_id;
+
+    // Last known backend state, pushes only carry what changed
+    FanStatus current_status;
+
+    // Set while the mode selector follows the backend, so that does not
+    // send SET_FAN_MODE back
+    bool syncing_mode = false;
 
     // Profile data (max 10 points)
     std::vector<FanProfilePoint> profile_points;
     static constexpr int MAX_PROFILE_POINTS = 10;
 
-	void update_fan_speeds();
-	void update_ui_from_system_state();
+	void refresh_status();
     void set_fan_rpm(int rpm);
     void update_profile_display();
     void add_profile_point();
     void remove_profile_point_at(int index);
     void apply_profile();
     int validate_rpm(int rpm);
-    void update_all_temperatures();
     void on_interval_changed(int new_interval);
+    void start_polling_timer();
+    void subscribe_to_backend();
+    void apply_status(const FanStatus &update);
+    void show_mode(std::string fan_mode);
+    void show_temperatures(const std::string &pkg, const std::string &cores, const std::string &nvme);
 
     // Signal handlers
 	static void on_mode_changed(GtkComboBox *widget, gpointer data);
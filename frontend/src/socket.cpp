@@ -6,39 +6,52 @@
 #include <cstring>
 #include <vector>
 #include <cerrno>
-#include <future>
-#include <mutex>
-
-// Helper function to reliably send a block of data
-bool send_all(int socket, const void *buffer, size_t length) {
-    const char *ptr = static_cast<const char*>(buffer);
-    while (length > 0) {
-        ssize_t bytes_sent = send(socket, ptr, length, 0);
-        if (bytes_sent < 1) {
-            return false;
-        }
-        ptr += bytes_sent;
-        length -= bytes_sent;
+#include <glib-unix.h>
+
+// Retry delays for the subscription
+static constexpr guint kReconnectDelaySec = 2;
+// A backend without SUBSCRIBE support is not retried as often
+static constexpr guint kRejectedDelaySec = 30;
+
+std::string strip_sample_timestamp(const std::string &response, uint64_t *timestamp_ms)
+{
+    size_t pos = response.rfind("|TS:");
+    if (pos == std::string::npos) {
+        return response;
     }
-    return true;
-}
 
-// Helper function to reliably read a block of data
-bool read_all(int socket, void *buffer, size_t length) {
-    char *ptr = static_cast<char*>(buffer);
-    while (length > 0) {
-        ssize_t bytes_read = recv(socket, ptr, length, 0);
-        if (bytes_read < 1) {
-            return false;
+    if (timestamp_ms) {
+        try {
+            *timestamp_ms = std::stoull(response.substr(pos + 4));
+        } catch (...) {
+            *timestamp_ms = 0;
         }
-        ptr += bytes_read;
-        length -= bytes_read;
     }
-    return true;
+    return response.substr(0, pos);
 }
 
+// Connects a new unix stream socket; returns -1 on failure
+static int connect_unix(const std::string &socket_path)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		return -1;
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
 
-VictusSocketClient::VictusSocketClient(const std::string &path) : socket_path(path), sockfd(-1)
+VictusSocketClient::VictusSocketClient(const std::string &path)
+	: socket_path(path), sockfd(-1), watch_id(0), watched(static_cast<GIOCondition>(0))
 {
 	command_prefix_map = {
 		{GET_FAN_SPEED, "GET_FAN_SPEED"},
@@ -48,24 +61,23 @@ VictusSocketClient::VictusSocketClient(const std::string &path) : socket_path(pa
 		{SET_FAN_PROFILE, "SET_FAN_PROFILE"},
 		{GET_CPU_TEMP, "GET_CPU_TEMP"},
 		{GET_ALL_TEMPS, "GET_ALL_TEMPS"},
+		{GET_STATUS, "GET_STATUS"},
 		{GET_KEYBOARD_COLOR, "GET_KEYBOARD_COLOR"},
 		{SET_KEYBOARD_COLOR, "SET_KEYBOARD_COLOR"},
 		{GET_KBD_BRIGHTNESS, "GET_KBD_BRIGHTNESS"},
 		{SET_KBD_BRIGHTNESS, "SET_KBD_BRIGHTNESS"},
 	};
-
-	// Start the queue worker thread
-	queue_worker_thread = std::thread(&VictusSocketClient::queue_worker, this);
 }
 
 VictusSocketClient::~VictusSocketClient()
 {
-	shutdown_queue = true;
-	queue_cv.notify_all();
-	if (queue_worker_thread.joinable()) {
-		queue_worker_thread.join();
+	if (resubscribe_timer_id) {
+		g_source_remove(resubscribe_timer_id);
 	}
-	close_socket();
+	// The owners of these callbacks may already be gone
+	subscription_callback = nullptr;
+	pending_requests.clear();
+	disconnect("ERROR: Client shutting down");
 }
 
 bool VictusSocketClient::connect_to_server()
@@ -76,140 +88,277 @@ bool VictusSocketClient::connect_to_server()
 
 	std::cout << "Connecting to server..." << std::endl;
 
-	sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	// Connecting a unix socket completes (or fails) right away
+	sockfd = connect_unix(socket_path);
 	if (sockfd == -1)
-	{
-		std::cerr << "Cannot create socket: " << strerror(errno) << std::endl;
-		return false;
-	}
-
-	struct sockaddr_un addr;
-	memset(&addr, 0, sizeof(addr));
-	addr.sun_family = AF_UNIX;
-	strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
-
-	// Try to connect with a timeout
-	if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
 	{
 		std::cerr << "Failed to connect to the server: " << strerror(errno) << std::endl;
-		close(sockfd);
-		sockfd = -1;
 		return false;
 	}
 
 	std::cout << "Connection to server successful." << std::endl;
+	update_watch();
 	return true;
 }
 
-void VictusSocketClient::close_socket()
-{
-	if (sockfd != -1) {
-        std::cout << "Closing the connection..." << std::endl;
-		close(sockfd);
-        sockfd = -1;
-        std::cout << "Connection closed." << std::endl;
-    }
-}
-
-std::string VictusSocketClient::send_command(const std::string &command)
+void VictusSocketClient::disconnect(const std::string &error)
 {
-    std::lock_guard<std::mutex> lock(socket_mutex);
-
 	if (sockfd == -1) {
-        if (!connect_to_server()) {
-		    return "ERROR: No server connection";
-        }
-    }
+		return;
+	}
 
-    uint32_t len = command.length();
-    if (!send_all(sockfd, &len, sizeof(len)) || !send_all(sockfd, command.c_str(), len)) {
-        std::cerr << "Failed to send command, closing socket." << std::endl;
-        close_socket();
-        return "ERROR: Failed to send command";
-    }
+    std::cout << "Closing the connection..." << std::endl;
+	// Inside on_socket_ready the source removes itself
+	if (watch_id && !in_socket_callback) {
+		g_source_remove(watch_id);
+	}
+	watch_id = 0;
+	watched = static_cast<GIOCondition>(0);
+	close(sockfd);
+	sockfd = -1;
+	input.clear();
+	output.clear();
+	subscribed = false;
+    std::cout << "Connection closed." << std::endl;
 
-    uint32_t response_len;
-    if (!read_all(sockfd, &response_len, sizeof(response_len))) {
-        std::cerr << "Failed to read response length, closing socket." << std::endl;
-        close_socket();
-        return "ERROR: Failed to read response length";
-    }
+	if (subscription_callback) {
+		schedule_resubscribe(kReconnectDelaySec);
+	}
 
-    if (response_len > 4096) { // Sanity check
-        std::cerr << "Response too long (" << response_len << " bytes), closing socket." << std::endl;
-        close_socket();
-        return "ERROR: Response too long";
-    }
+	// Callbacks may send new requests, so fail a detached copy
+	auto failed = std::move(pending_requests);
+	pending_requests.clear();
+	for (auto &entry : failed) {
+		if (entry.second) {
+			entry.second(error);
+		}
+	}
+}
 
-    std::vector<char> buffer(response_len);
-    if (!read_all(sockfd, buffer.data(), response_len)) {
-        std::cerr << "Failed to read response, closing socket." << std::endl;
-        close_socket();
-        return "ERROR: Failed to read response";
-    }
+GIOCondition VictusSocketClient::wanted_condition() const
+{
+	return static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR | (output.empty() ? 0 : G_IO_OUT));
+}
 
-	return std::string(buffer.begin(), buffer.end());
+void VictusSocketClient::update_watch()
+{
+	if (in_socket_callback || sockfd == -1) {
+		return;
+	}
+	GIOCondition wanted = wanted_condition();
+	if (watch_id && wanted == watched) {
+		return;
+	}
+	if (watch_id) {
+		g_source_remove(watch_id);
+	}
+	watch_id = g_unix_fd_add(sockfd, wanted, &VictusSocketClient::on_socket_ready, this);
+	watched = wanted;
+}
+
+bool VictusSocketClient::flush_output()
+{
+	size_t offset = 0;
+	while (offset < output.size()) {
+		ssize_t sent = send(sockfd, output.data() + offset, output.size() - offset, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			std::cerr << "Failed to send command, closing socket." << std::endl;
+			return false;
+		}
+		offset += static_cast<size_t>(sent);
+	}
+	output.erase(0, offset);
+	return true;
 }
 
-void VictusSocketClient::queue_worker()
+bool VictusSocketClient::read_input()
 {
-	while (!shutdown_queue) {
-		std::unique_lock<std::mutex> lock(queue_mutex);
-		
-		// Wait until we have space for new requests and there are queued commands
-		queue_cv.wait(lock, [this] {
-			return shutdown_queue || (!command_queue.empty() && active_requests < MAX_CONCURRENT_REQUESTS);
-		});
+	char buffer[4096];
+	while (true) {
+		ssize_t bytes_read = recv(sockfd, buffer, sizeof(buffer), 0);
+		if (bytes_read > 0) {
+			input.append(buffer, static_cast<size_t>(bytes_read));
+			continue;
+		}
+		if (bytes_read < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return true;
+		}
+		return false; // closed by the backend or failed
+	}
+}
 
-		if (shutdown_queue && command_queue.empty()) {
+void VictusSocketClient::dispatch_frames()
+{
+	size_t offset = 0;
+	while (sockfd != -1 && input.size() - offset >= sizeof(uint32_t)) {
+		uint32_t header;
+		memcpy(&header, input.data() + offset, sizeof(header));
+		bool tagged = (header & kFrameTagged) != 0;
+		uint32_t response_len = header & ~kFrameTagged;
+		size_t header_len = sizeof(header) + (tagged ? sizeof(uint32_t) : 0);
+		if (response_len > 4096) { // Sanity check
+			std::cerr << "Response too long (" << response_len << " bytes), closing socket." << std::endl;
+			disconnect("ERROR: Response too long");
+			return;
+		}
+		if (input.size() - offset < header_len + response_len) {
 			break;
 		}
 
-		if (!command_queue.empty() && active_requests < MAX_CONCURRENT_REQUESTS) {
-			auto pending = std::move(command_queue.front());
-			command_queue.pop();
-			active_requests++;
-			lock.unlock();
+		uint32_t request_id = 0;
+		if (tagged) {
+			memcpy(&request_id, input.data() + offset + sizeof(header), sizeof(request_id));
+		}
+		std::string payload = input.substr(offset + header_len, response_len);
+		offset += header_len + response_len;
 
-			process_queued_command(std::move(pending));
+		if (!tagged) {
+			// Untagged frames on this connection are subscription pushes
+			if (subscribed && subscription_callback && payload.rfind("PUSH", 0) == 0) {
+				subscription_callback(payload);
+			}
+			continue;
+		}
 
-			lock.lock();
-			active_requests--;
-			queue_cv.notify_all();
+		auto it = pending_requests.find(request_id);
+		if (it == pending_requests.end()) {
+			continue;
+		}
+		ResponseCallback callback = std::move(it->second);
+		pending_requests.erase(it);
+		if (callback) {
+			callback(payload);
 		}
 	}
+	if (sockfd != -1) {
+		input.erase(0, offset);
+	}
 }
 
-void VictusSocketClient::process_queued_command(std::unique_ptr<PendingCommand> pending)
+gboolean VictusSocketClient::on_socket_ready(gint fd, GIOCondition condition, gpointer data)
 {
-	auto it = command_prefix_map.find(pending->type);
-	if (it != command_prefix_map.end()) {
-		std::string full_command = it->second;
-		if (!pending->command.empty()) {
-			if (it->second.back() != ' ') {
-				full_command += " ";
-			}
-			full_command += pending->command;
-		}
-		auto result = send_command(full_command);
-		pending->result.set_value(result);
-	} else {
-		pending->result.set_value("ERROR: Unknown command type");
+	VictusSocketClient *self = static_cast<VictusSocketClient*>(data);
+
+	// Callbacks run from here may send or disconnect; the watch is
+	// reconciled once at the end instead of being replaced under our feet
+	self->in_socket_callback = true;
+	bool ok = true;
+	if (condition & (G_IO_IN | G_IO_HUP | G_IO_ERR)) {
+		ok = self->read_input();
+		// Answer what arrived before a hang-up first
+		self->dispatch_frames();
+	}
+	if (ok && self->sockfd == fd) {
+		ok = self->flush_output();
+	}
+	self->in_socket_callback = false;
+
+	if (self->sockfd == fd && !ok) {
+		std::cerr << "Lost connection to the server." << std::endl;
+		self->disconnect("ERROR: Connection lost");
+	}
+
+	if (self->sockfd == fd && self->wanted_condition() == self->watched) {
+		return G_SOURCE_CONTINUE;
 	}
+	// This source ends here; watch the current socket (if any) afresh
+	self->watch_id = 0;
+	self->watched = static_cast<GIOCondition>(0);
+	if (self->sockfd != -1) {
+		self->update_watch();
+	}
+	return G_SOURCE_REMOVE;
 }
 
-std::future<std::string> VictusSocketClient::send_command_async(ServerCommands type, const std::string &command)
+void VictusSocketClient::queue_request(const std::string &command, ResponseCallback on_response)
 {
-	auto pending = std::make_unique<PendingCommand>();
-	pending->type = type;
-	pending->command = command;
-	auto future = pending->result.get_future();
+	uint32_t request_id = next_request_id++;
+	if (next_request_id == 0) {
+		next_request_id = 1;
+	}
+	pending_requests.emplace(request_id, std::move(on_response));
 
-	{
-		std::lock_guard<std::mutex> lock(queue_mutex);
-		command_queue.push(std::move(pending));
+	uint32_t header = static_cast<uint32_t>(command.length()) | kFrameTagged;
+	output.append(reinterpret_cast<const char *>(&header), sizeof(header));
+	output.append(reinterpret_cast<const char *>(&request_id), sizeof(request_id));
+	output.append(command);
+	update_watch();
+}
+
+void VictusSocketClient::send_command(ServerCommands type, const std::string &command, ResponseCallback on_response)
+{
+	auto it = command_prefix_map.find(type);
+	if (it == command_prefix_map.end()) {
+		if (on_response) on_response("ERROR: Unknown command type");
+		return;
+	}
+	std::string full_command = it->second;
+	if (!command.empty()) {
+		full_command += " " + command;
+	}
+
+	if (!connect_to_server()) {
+		if (on_response) on_response("ERROR: No server connection");
+		return;
+	}
+	queue_request(full_command, std::move(on_response));
+}
+
+void VictusSocketClient::subscribe(const std::string &fields, int min_interval_ms, PushCallback on_push)
+{
+	subscription_fields = fields;
+	subscription_interval_ms = min_interval_ms;
+	subscription_callback = std::move(on_push);
+	if (resubscribe_timer_id) {
+		g_source_remove(resubscribe_timer_id);
+		resubscribe_timer_id = 0;
+	}
+	send_subscribe();
+}
+
+void VictusSocketClient::send_subscribe()
+{
+	if (!connect_to_server()) {
+		schedule_resubscribe(kReconnectDelaySec);
+		return;
 	}
-	queue_cv.notify_all();
 
-	return future;
+	std::string command = "SUBSCRIBE " + subscription_fields + " " + std::to_string(subscription_interval_ms);
+	queue_request(command, [this](const std::string &response) {
+		if (response == "OK") {
+			subscribed = true;
+			return;
+		}
+		subscribed = false;
+		// A lost connection is retried by disconnect(); this is a rejection
+		if (sockfd != -1) {
+			std::cerr << "Backend rejected subscription: " << response << std::endl;
+			schedule_resubscribe(kRejectedDelaySec);
+		}
+	});
+}
+
+void VictusSocketClient::schedule_resubscribe(guint delay_sec)
+{
+	if (resubscribe_timer_id || !subscription_callback) {
+		return;
+	}
+	resubscribe_timer_id = g_timeout_add_seconds(delay_sec, &VictusSocketClient::on_resubscribe, this);
+}
+
+gboolean VictusSocketClient::on_resubscribe(gpointer data)
+{
+	VictusSocketClient *self = static_cast<VictusSocketClient*>(data);
+	self->resubscribe_timer_id = 0;
+	self->send_subscribe();
+	return G_SOURCE_REMOVE;
 }
@@ -2,14 +2,10 @@
 #define VICTUS_SOCKET_HPP
 
 #include <string>
-#include <future>
 #include <unordered_map>
 #include <functional>
-#include <mutex>
-#include <queue>
-#include <condition_variable>
-#include <thread>
-#include <atomic>
+#include <cstdint>
+#include <glib.h>
 
 enum ServerCommands
 {
@@ -20,50 +16,79 @@ enum ServerCommands
 	SET_FAN_PROFILE,
 	GET_CPU_TEMP,
 	GET_ALL_TEMPS,
+	GET_STATUS,
 	GET_KEYBOARD_COLOR,
 	SET_KEYBOARD_COLOR,
 	GET_KBD_BRIGHTNESS,
 	SET_KBD_BRIGHTNESS
 };
 
-struct PendingCommand
-{
-	ServerCommands type;
-	std::string command;
-	std::promise<std::string> result;
-};
+// A frame length with this bit set is followed by a u32 request id; the
+// backend echoes it in the response so requests can be pipelined
+static constexpr uint32_t kFrameTagged = 0x80000000u;
+
+// GET_* responses carry the backend sample time as a trailing "|TS:<ms>";
+// returns the response without it and optionally the timestamp itself
+std::string strip_sample_timestamp(const std::string &response, uint64_t *timestamp_ms = nullptr);
 
+// Called on the GLib main loop with the response, or an "ERROR: ..." string
+// when the backend could not be reached
+using ResponseCallback = std::function<void(const std::string &response)>;
+using PushCallback = std::function<void(const std::string &payload)>;
+
+// Backend connection driven by the GLib main loop: the socket is
+// non-blocking and watched by a GSource, so no threads are involved and all
+// callbacks run on the main thread. Must only be used from that thread.
 class VictusSocketClient
 {
 public:
 	VictusSocketClient(const std::string &socket_path);
 	~VictusSocketClient();
 
-	std::future<std::string> send_command_async(ServerCommands type, const std::string &command = "");
+	// Requests are pipelined on one connection: every frame carries a request
+	// id and responses are matched by id, so a slow SET_* does not hold up
+	// the GETs sent after it
+	void send_command(ServerCommands type, const std::string &command = "", ResponseCallback on_response = nullptr);
+
+	// Subscribes to backend pushes on the same connection. on_push gets each
+	// "PUSH|TS:..|KEY:value..." payload; only changed fields are sent, except
+	// for the first push after every (re)connect. Calling it again replaces
+	// the subscription.
+	void subscribe(const std::string &fields, int min_interval_ms, PushCallback on_push);
+	bool subscription_active() const { return subscribed; }
 
 private:
-	std::string send_command(const std::string &command);
 	std::string socket_path;
-
-	bool connect_to_server();
-	void close_socket();
+	std::unordered_map<ServerCommands, std::string> command_prefix_map;
 
 	int sockfd;
-    std::mutex socket_mutex;
+	guint watch_id;
+	GIOCondition watched;
+	bool in_socket_callback = false;
+	std::string input;  // bytes of not yet complete frames
+	std::string output; // frames not yet written
+	uint32_t next_request_id = 1;
+	std::unordered_map<uint32_t, ResponseCallback> pending_requests;
 
-	std::unordered_map<ServerCommands, std::string> command_prefix_map;
+	std::string subscription_fields;
+	int subscription_interval_ms = 0;
+	PushCallback subscription_callback;
+	bool subscribed = false;
+	guint resubscribe_timer_id = 0;
 
-	// Request queue system (max 3 concurrent requests)
-	static constexpr int MAX_CONCURRENT_REQUESTS = 3;
-	std::queue<std::unique_ptr<PendingCommand>> command_queue;
-	std::mutex queue_mutex;
-	std::condition_variable queue_cv;
-	std::thread queue_worker_thread;
-	std::atomic<bool> shutdown_queue{false};
-	std::atomic<int> active_requests{0};
+	bool connect_to_server();
+	void disconnect(const std::string &error);
+	void queue_request(const std::string &command, ResponseCallback on_response);
+	void send_subscribe();
+	void schedule_resubscribe(guint delay_sec);
+	GIOCondition wanted_condition() const;
+	void update_watch();
+	bool flush_output();
+	bool read_input();
+	void dispatch_frames();
 
-	void queue_worker();
-	void process_queued_command(std::unique_ptr<PendingCommand> pending);
+	static gboolean on_socket_ready(gint fd, GIOCondition condition, gpointer data);
+	static gboolean on_resubscribe(gpointer data);
 };
 
 #endif // VICTUS_SOCKET_HPP
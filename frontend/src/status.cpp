@@ -0,0 +1,64 @@
+#include "status.hpp"
+#include <sstream>
+
+std::optional<FanStatus> parse_status(const std::string &record)
+{
+    std::stringstream ss(record);
+    std::string section;
+    if (!std::getline(ss, section, '|') || (section != "V1" && section != "PUSH")) {
+        return std::nullopt;
+    }
+
+    FanStatus status;
+    while (std::getline(ss, section, '|')) {
+        size_t colon = section.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string key = section.substr(0, colon);
+        std::string value = section.substr(colon + 1);
+
+        if (key == "TS") {
+            try {
+                status.timestamp_ms = std::stoull(value);
+            } catch (...) {
+                status.timestamp_ms = 0;
+            }
+        } else if (key == "MODE") {
+            status.mode = value;
+        } else if (key == "FAN1") {
+            status.fan1_rpm = value;
+        } else if (key == "FAN2") {
+            status.fan2_rpm = value;
+        } else if (key == "CPU") {
+            status.cpu_temp = value;
+        } else if (key == "PKG") {
+            status.pkg_temp = value;
+        } else if (key == "CORES") {
+            status.cores_temps = value;
+        } else if (key == "NVME") {
+            status.nvme_temps = value;
+        }
+    }
+    return status;
+}
+
+void merge_status(FanStatus &status, const FanStatus &update)
+{
+    auto merge = [](std::optional<std::string> &target, const std::optional<std::string> &value) {
+        if (value) {
+            target = value;
+        }
+    };
+
+    if (update.timestamp_ms) {
+        status.timestamp_ms = update.timestamp_ms;
+    }
+    merge(status.mode, update.mode);
+    merge(status.fan1_rpm, update.fan1_rpm);
+    merge(status.fan2_rpm, update.fan2_rpm);
+    merge(status.cpu_temp, update.cpu_temp);
+    merge(status.pkg_temp, update.pkg_temp);
+    merge(status.cores_temps, update.cores_temps);
+    merge(status.nvme_temps, update.nvme_temps);
+}
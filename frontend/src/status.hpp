@@ -0,0 +1,29 @@
+#ifndef VICTUS_STATUS_HPP
+#define VICTUS_STATUS_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Fan page state as reported by GET_STATUS or a subscription PUSH. Pushes
+// only carry changed sections, so every field is optional.
+struct FanStatus
+{
+    uint64_t timestamp_ms = 0;
+    std::optional<std::string> mode;
+    std::optional<std::string> fan1_rpm;
+    std::optional<std::string> fan2_rpm;
+    std::optional<std::string> cpu_temp;
+    std::optional<std::string> pkg_temp;
+    std::optional<std::string> cores_temps; // comma separated
+    std::optional<std::string> nvme_temps;  // comma separated
+};
+
+// Parses "V1|TS:..|MODE:..|FAN1:.." or "PUSH|TS:..|..."; nullopt for errors
+// and unknown record versions. Unknown sections are ignored.
+std::optional<FanStatus> parse_status(const std::string &record);
+
+// Copies the sections present in update into status
+void merge_status(FanStatus &status, const FanStatus &update);
+
+#endif // VICTUS_STATUS_HPP